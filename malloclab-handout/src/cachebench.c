@@ -0,0 +1,307 @@
+/*
+ * cachebench.c - object caches against mm_malloc and initialization
+ *
+ *     unix> cachebench [-v] [-n ops] [-l live] > cache.csv
+ *
+ * Fixed-size churn of the kind in binary2-bal.rep, on two object types
+ * with real constructors:
+ *
+ *   small       a 16-byte list node (8 bytes in the 32-bit build),
+ *               linked to itself
+ *   large       a 112-byte connection: a mutex, a list node and a
+ *               zeroed buffer
+ *
+ * and on a mix of the two. The heap first gets live (1000) objects of
+ * each type in use; then, ops (2^21) times, a random one of them is
+ * freed and replaced by a new object of its type, which is used (its
+ * lock taken and its list read). Three ways:
+ *
+ *   bare        mm_malloc and mm_free alone, with no initialization
+ *               and so no use: the allocator's share of the others
+ *   malloc      mm_malloc and the constructor, the destructor and
+ *               mm_free, as code without a cache does
+ *   cache       mm_cache_alloc and mm_cache_free (mmcache.c), one
+ *               cache per type, constructing objects once per slab
+ *
+ * Every measurement is repeated and the fastest run is kept. The output
+ * is CSV with one row per object type and way: the ns per replacement
+ * and the heap it ended up with. -v prints each cache's statistics to
+ * stderr.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "mm.h"
+#include "mmcache.h"
+#include "memlib.h"
+#include "ftimer.h"
+
+#define RUNS       5          /* runs of each measurement, fastest kept */
+
+/* The small object: a list node */
+typedef struct node {
+    struct node *next;
+    struct node *prev;
+} node_t;
+
+/* The large object: a lock, a list node and a buffer, 112 bytes */
+typedef struct {
+    pthread_mutex_t lock;
+    node_t link;
+    char buf[112 - sizeof(pthread_mutex_t) - sizeof(node_t)];
+} conn_t;
+
+/* An object type */
+typedef struct {
+    char *name;
+    size_t size;
+    void (*ctor)(void *obj);
+    void (*dtor)(void *obj);
+    void (*use)(void *obj);
+    mm_cache_t *cache;
+} type_t;
+
+static void node_ctor(void *obj);
+static void node_use(void *obj);
+static void conn_ctor(void *obj);
+static void conn_dtor(void *obj);
+static void conn_use(void *obj);
+
+static type_t types[] = {
+    {"small", sizeof(node_t), node_ctor, NULL, node_use, NULL},
+    {"large", sizeof(conn_t), conn_ctor, conn_dtor, conn_use, NULL},
+};
+
+enum {BARE, MALLOC, CACHE, NWAYS};
+static char *ways[NWAYS] = {"bare", "malloc", "cache"};
+
+static void **live_objs;      /* live objects, of alternating types */
+static long ops = 1 << 21;    /* replacements per run */
+static int live = 1000;       /* live objects of each type */
+static int verbose = 0;       /* -v: print the caches' statistics */
+static volatile unsigned long sink; /* keeps the uses' reads alive */
+
+/* function prototypes */
+static void usage(void);
+
+static void node_ctor(void *obj)
+{
+    node_t *n = obj;
+
+    n->next = n->prev = n;
+}
+
+static void node_use(void *obj)
+{
+    sink += (unsigned long)((node_t *)obj)->next;
+}
+
+static void conn_ctor(void *obj)
+{
+    conn_t *c = obj;
+
+    pthread_mutex_init(&c->lock, NULL);
+    node_ctor(&c->link);
+    memset(c->buf, 0, sizeof(c->buf));
+}
+
+static void conn_dtor(void *obj)
+{
+    pthread_mutex_destroy(&((conn_t *)obj)->lock);
+}
+
+static void conn_use(void *obj)
+{
+    conn_t *c = obj;
+
+    pthread_mutex_lock(&c->lock);
+    node_use(&c->link);
+    pthread_mutex_unlock(&c->lock);
+}
+
+/*
+ * fail - report a NULL from mm.c and give up
+ */
+static void fail(char *what)
+{
+    fprintf(stderr, "cachebench: %s returned NULL\n", what);
+    exit(1);
+}
+
+/*
+ * get, put - an object of type t, and back, one of three ways
+ */
+static void *get(type_t *t, int way)
+{
+    void *obj;
+
+    if (way == CACHE) {
+	if ((obj = mm_cache_alloc(t->cache)) == NULL)
+	    fail("mm_cache_alloc");
+	return obj;
+    }
+    if ((obj = mm_malloc(t->size)) == NULL)
+	fail("mm_malloc");
+    if (way == MALLOC)
+	t->ctor(obj);
+    return obj;
+}
+
+static void put(type_t *t, int way, void *obj)
+{
+    if (way == CACHE) {
+	mm_cache_free(t->cache, obj);
+	return;
+    }
+    if (way == MALLOC && t->dtor != NULL)
+	t->dtor(obj);
+    mm_free(obj);
+}
+
+/*
+ * run - the churn on an empty heap with the types in [lo, hi];
+ *     returns the seconds it took. With report set the caches'
+ *     statistics are printed.
+ */
+static double run(int lo, int hi, int way, int report)
+{
+    int ntypes = hi - lo + 1, nslots = ntypes * live;
+    unsigned int x = 1;
+    double t;
+    type_t *ty;
+    long i;
+    int k;
+
+    mem_reset_brk();
+    if (mm_init() < 0) {
+	printf("mm_init failed\n");
+	exit(1);
+    }
+    for (k = lo; k <= hi; k++)
+	if (way == CACHE && (types[k].cache = mm_cache_create(types[k].name,
+		types[k].size, 0, types[k].ctor, types[k].dtor)) == NULL)
+	    fail("mm_cache_create");
+    for (k = 0; k < nslots; k++)
+	live_objs[k] = get(&types[lo + k % ntypes], way);
+
+    t = ftimer_now();
+    for (i = 0; i < ops; i++) {
+	/* xorshift: cheaper than rand() inside the timing */
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	k = x % nslots;
+	ty = &types[lo + k % ntypes];
+	put(ty, way, live_objs[k]);
+	live_objs[k] = get(ty, way);
+	if (way != BARE)
+	    ty->use(live_objs[k]);
+    }
+    t = ftimer_now() - t;
+
+    for (k = 0; k < nslots; k++)
+	put(&types[lo + k % ntypes], way, live_objs[k]);
+    if (way == CACHE)
+	for (k = lo; k <= hi; k++) {
+	    if (report) {
+		mm_cache_stats_t st;
+
+		mm_cache_stats(types[k].cache, &st);
+		fprintf(stderr, "%s: %lu bytes, %lu per %lu-byte slab, "
+			"%lu slabs made, %lu freed, %llu allocs, %llu ctors, "
+			"%llu dtors\n", st.name, (unsigned long)st.size,
+			(unsigned long)st.per_slab,
+			(unsigned long)st.slab_bytes,
+			(unsigned long)st.slabs_made,
+			(unsigned long)st.slabs_freed, st.allocs, st.ctors,
+			st.dtors);
+	    }
+	    mm_cache_destroy(types[k].cache);
+	}
+    return t;
+}
+
+/*
+ * measure - time one way RUNS times and print the fastest in ns per
+ *     replacement
+ */
+static void measure(char *name, int lo, int hi, int way)
+{
+    double secs, best = -1;
+    size_t heap = 0;
+    int r;
+
+    for (r = 0; r < RUNS; r++) {
+	secs = run(lo, hi, way, verbose && r == RUNS - 1);
+	if (best < 0 || secs < best) {
+	    best = secs;
+	    heap = mem_heapsize();
+	}
+    }
+    printf("%s,%s,%.1f,%lu\n", name, ways[way], best * 1e9 / ops,
+	   (unsigned long)heap);
+    fflush(stdout);
+}
+
+int main(int argc, char **argv)
+{
+    int c, way;
+
+    while ((c = getopt(argc, argv, "vn:l:h")) != EOF) {
+	switch (c) {
+	case 'v': /* Print the caches' statistics */
+	    verbose = 1;
+	    break;
+	case 'n': /* Replacements per run */
+	    ops = strtol(optarg, NULL, 0);
+	    break;
+	case 'l': /* Live objects of each type */
+	    live = atoi(optarg);
+	    break;
+	case 'h':
+	    usage();
+	    exit(0);
+	default:
+	    usage();
+	    exit(1);
+	}
+    }
+    if (ops < 1 || live < 1) {
+	usage();
+	exit(1);
+    }
+    if ((live_objs = malloc(2 * live * sizeof(void *))) == NULL) {
+	fprintf(stderr, "cachebench: out of memory\n");
+	exit(1);
+    }
+
+    mem_init();
+
+    printf("objects,way,ns,heap\n");
+    for (way = 0; way < NWAYS; way++)
+	measure("small", 0, 0, way);
+    for (way = 0; way < NWAYS; way++)
+	measure("large", 1, 1, way);
+    for (way = 0; way < NWAYS; way++)
+	measure("mixed", 0, 1, way);
+
+    mem_deinit();
+    free(live_objs);
+    exit(0);
+}
+
+/*
+ * usage - Explain the command line arguments
+ */
+static void usage(void)
+{
+    fprintf(stderr, "Usage: cachebench [-hv] [-n <ops>] [-l <live>]\n");
+    fprintf(stderr, "Options\n");
+    fprintf(stderr, "\t-h           Print this message.\n");
+    fprintf(stderr, "\t-l <live>    Live objects of each type (1000).\n");
+    fprintf(stderr, "\t-n <ops>     Objects replaced per run (2097152).\n");
+    fprintf(stderr, "\t-v           Print each cache's statistics to stderr.\n");
+}
@@ -0,0 +1,150 @@
+/*
+ * cachesim.c - set-associative cache model and the metadata access
+ *     recorder that feeds it (see cachesim.h)
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cachesim.h"
+
+#define EMPTY (~0ull)
+
+/* Recorder state */
+static int tracing = 0;               /* between memtrace_start and _stop */
+static cache_t l1, l2;
+static unsigned long long accesses;   /* calls to memtrace_touch */
+static unsigned long long lines;      /* distinct lines touched */
+static unsigned long long outside;    /* line accesses outside [lo, lo+len) */
+static unsigned long long lo_line;    /* first line of the region */
+static unsigned long long nlines;     /* lines in the region */
+static unsigned char *touched;        /* one bit per line of the region */
+
+/*
+ * cache_init - set up an empty cache of size bytes and the given
+ *     associativity. Returns -1 if out of memory.
+ */
+int cache_init(cache_t *c, int size, int ways)
+{
+    int i, n;
+
+    memset(c, 0, sizeof(cache_t));
+    c->ways = ways;
+    c->sets = size / CACHE_LINE / ways;
+    n = c->sets * ways;
+    c->tag = malloc(n * sizeof(unsigned long long));
+    c->stamp = calloc(n, sizeof(unsigned long long));
+    if (c->tag == NULL || c->stamp == NULL)
+	return -1;
+    for (i = 0; i < n; i++)
+	c->tag[i] = EMPTY;
+    return 0;
+}
+
+void cache_free(cache_t *c)
+{
+    free(c->tag);
+    free(c->stamp);
+}
+
+/*
+ * cache_access - look up a line, filling it on a miss by evicting the
+ *     least recently used way of its set. Returns 1 on a hit.
+ */
+int cache_access(cache_t *c, unsigned long long line)
+{
+    int base = (int)(line % c->sets) * c->ways;
+    int i, victim = base;
+
+    c->accesses++;
+    c->clock++;
+    for (i = base; i < base + c->ways; i++) {
+	if (c->tag[i] == line) {
+	    c->stamp[i] = c->clock;
+	    return 1;
+	}
+	if (c->stamp[i] < c->stamp[victim])
+	    victim = i;
+    }
+    c->misses++;
+    c->tag[victim] = line;
+    c->stamp[victim] = c->clock;
+    return 0;
+}
+
+/*
+ * memtrace_start - start recording with cold caches. Distinct lines
+ *     are counted within the len bytes at lo (the heap).
+ */
+void memtrace_start(void *lo, size_t len)
+{
+    if (cache_init(&l1, L1_SIZE, L1_WAYS) < 0 ||
+	cache_init(&l2, L2_SIZE, L2_WAYS) < 0) {
+	printf("memtrace_start: out of memory for the cache model\n");
+	exit(1);
+    }
+    lo_line = (size_t)lo / CACHE_LINE;
+    nlines = len / CACHE_LINE + 2;
+    if ((touched = calloc((nlines + 7) / 8, 1)) == NULL) {
+	printf("memtrace_start: out of memory for the line map\n");
+	exit(1);
+    }
+    accesses = lines = outside = 0;
+    tracing = 1;
+}
+
+void memtrace_stop(void)
+{
+    tracing = 0;
+}
+
+/*
+ * memtrace_report - print what was recorded for a replay of ops ops
+ *     and release the model
+ */
+void memtrace_report(int tracenum, int ops)
+{
+    double n = (ops > 0) ? ops : 1;
+
+    printf("\nmemtrace for trace %d: %llu metadata accesses (%.2f/op), "
+	   "%llu distinct lines\n", tracenum, accesses, accesses / n, lines);
+    printf("  L1 %dK %d-way: %llu misses (%.3f/op, %.2f%%)\n",
+	   L1_SIZE >> 10, L1_WAYS, l1.misses, l1.misses / n,
+	   l1.accesses ? 100.0 * l1.misses / l1.accesses : 0.0);
+    printf("  L2 %dK %d-way: %llu misses (%.3f/op, %.2f%%)\n",
+	   L2_SIZE >> 10, L2_WAYS, l2.misses, l2.misses / n,
+	   l2.accesses ? 100.0 * l2.misses / l2.accesses : 0.0);
+    if (outside > 0)
+	printf("  %llu line accesses outside the heap\n", outside);
+
+    cache_free(&l1);
+    cache_free(&l2);
+    free(touched);
+    touched = NULL;
+}
+
+/*
+ * memtrace_touch - record an n-byte access at p and return p
+ */
+void *memtrace_touch(void *p, int n)
+{
+    unsigned long long line, last, k;
+
+    if (!tracing)
+	return p;
+    accesses++;
+    line = (size_t)p / CACHE_LINE;
+    last = ((size_t)p + n - 1) / CACHE_LINE;
+    for (; line <= last; line++) {
+	if (!cache_access(&l1, line))
+	    cache_access(&l2, line);
+	k = line - lo_line;
+	if (line < lo_line || k >= nlines)
+	    outside++;
+	else if (!(touched[k / 8] & (1 << (k % 8)))) {
+	    touched[k / 8] |= 1 << (k % 8);
+	    lines++;
+	}
+    }
+    return p;
+}
@@ -0,0 +1,290 @@
+/*
+ * callocbench.c - cost of zeroed allocation in mm.c and libc
+ *
+ *     unix> callocbench [-t] [-m maxsize] [-b budget] [-a alloc] > calloc.csv
+ *
+ * At each power of 2 from 16 bytes to maxsize (16 MB) it times, for
+ * each allocator, a batch of up to 1000 zeroed blocks got two ways:
+ *
+ *   calloc      one calloc per block
+ *   memset      a malloc and a memset of the block, as callers do by hand
+ *
+ * on two kinds of heap:
+ *
+ *   fresh       a heap that has never been used, so every block comes
+ *               from memory that is known to be zero
+ *   reused      a heap whose blocks were all just written and freed, so
+ *               blocks come off the free lists; mm.c gives the pages of
+ *               free blocks of 1 MB and more back (mem_release), which
+ *               makes them known-zero again
+ *
+ * Then, for each allocator, it times churn: a block of 64 KB taken,
+ * written with memset and freed again, 1000 times over, in a heap
+ * whose only other block is a free one of 8 MB that was written and
+ * freed before, so each freed block merges with a large free block.
+ *
+ * mm.c gets a fresh heap by remapping memlib's area before each run;
+ * libc has no such reset, so for it fresh only means the blocks of the
+ * run before were freed. Only the calls are timed, unless -t is given:
+ * then one byte in every page of each block is written inside the
+ * timing too, so the page faults a skipped memset defers to the caller
+ * are counted. Batches are cut down so they never hold more than
+ * budget bytes (256 MB). Every measurement is repeated and the fastest
+ * run is kept. The output is CSV with one row per allocator, test,
+ * heap and size, the time in ns per block (per round, for churn).
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+
+#include "mm.h"
+#include "memlib.h"
+#include "ftimer.h"
+
+#define BATCH      1000       /* blocks in a batch */
+#define RUNS       5          /* runs of each measurement, fastest kept */
+#define CHURN_SIZE (64 << 10) /* block taken and freed in churn */
+#define CHURN_FREE (8 << 20)  /* free block it is taken from */
+
+/* An allocator under test */
+typedef struct {
+    char *name;
+    void (*reset)(int fresh);          /* start from an empty heap */
+    void *(*malloc)(size_t size);
+    void *(*calloc)(size_t n, size_t size);
+    void (*free)(void *ptr);
+} alloc_t;
+
+static void mm_reset(int fresh);
+static void libc_reset(int fresh);
+
+static alloc_t allocs[] = {
+    {"mm", mm_reset, mm_malloc, mm_calloc, mm_free},
+    {"libc", libc_reset, malloc, calloc, free},
+};
+#define NALLOCS (int)(sizeof(allocs) / sizeof(alloc_t))
+
+static void *blocks[BATCH];            /* the blocks of a batch */
+static size_t budget = 256 << 20;      /* most bytes live in a batch */
+static size_t maxsize = 16 << 20;      /* largest request */
+static int touch = 0;                  /* -t: write every page in the timing */
+
+/* function prototypes */
+static void usage(void);
+
+/*
+ * mm_reset - an empty mm.c heap; a fresh one is on a new mapping,
+ *     which has never been written
+ */
+static void mm_reset(int fresh)
+{
+    if (fresh) {
+	mem_deinit();
+	mem_init();
+    }
+    else
+	mem_reset_brk();
+    if (mm_init() < 0) {
+	printf("mm_init failed\n");
+	exit(1);
+    }
+}
+
+static void libc_reset(int fresh)
+{
+}
+
+/*
+ * fail - report an allocator that came back with NULL and give up
+ */
+static void fail(alloc_t *a, char *test, size_t size)
+{
+    fprintf(stderr, "callocbench: %s returned NULL in %s at %lu bytes\n",
+	    a->name, test, (unsigned long)size);
+    exit(1);
+}
+
+/*
+ * touch_pages - write one byte in every page of the block at p
+ */
+static void touch_pages(char *p, size_t size)
+{
+    size_t pagesize = getpagesize(), off;
+
+    for (off = 0; off < size; off += pagesize)
+	p[off] = 1;
+}
+
+/*
+ * dirty_heap - leave n blocks' worth of written, freed memory behind
+ */
+static void dirty_heap(alloc_t *a, size_t size, int n)
+{
+    int i;
+
+    for (i = 0; i < n; i++) {
+	if ((blocks[i] = a->malloc(size)) == NULL)
+	    fail(a, "dirty", size);
+	memset(blocks[i], 0xff, size);
+    }
+    for (i = 0; i < n; i++)
+	a->free(blocks[i]);
+}
+
+/*
+ * run_batch - secs for n zeroed blocks of size bytes, by calloc or by
+ *     malloc and memset; the blocks are freed outside the timing
+ */
+static double run_batch(alloc_t *a, size_t size, int n, int by_calloc)
+{
+    double t;
+    int i;
+
+    t = ftimer_now();
+    for (i = 0; i < n; i++) {
+	if (by_calloc)
+	    blocks[i] = a->calloc(1, size);
+	else if ((blocks[i] = a->malloc(size)) != NULL)
+	    memset(blocks[i], 0, size);
+	if (blocks[i] == NULL)
+	    fail(a, by_calloc ? "calloc" : "memset", size);
+	if (touch)
+	    touch_pages(blocks[i], size);
+    }
+    t = ftimer_now() - t;
+    for (i = 0; i < n; i++)
+	a->free(blocks[i]);
+    return t;
+}
+
+/*
+ * measure - time one test RUNS times and print the fastest in ns per
+ *     block
+ */
+static void measure(alloc_t *a, int by_calloc, int fresh, size_t size, int n)
+{
+    double secs, best = -1;
+    int r;
+
+    for (r = 0; r < RUNS; r++) {
+	a->reset(fresh);
+	if (!fresh)
+	    dirty_heap(a, size, n);
+	secs = run_batch(a, size, n, by_calloc);
+	if (best < 0 || secs < best)
+	    best = secs;
+    }
+    printf("%s,%s,%s,%lu,%d,%.1f\n", a->name, by_calloc ? "calloc" : "memset",
+	   fresh ? "fresh" : "reused", (unsigned long)size, n, best * 1e9 / n);
+    fflush(stdout);
+}
+
+/*
+ * measure_churn - time CHURN_SIZE blocks taken, written and freed BATCH
+ *     times next to a free block of CHURN_FREE bytes, RUNS times, and
+ *     print the fastest in ns per round
+ */
+static void measure_churn(alloc_t *a)
+{
+    double t, best = -1;
+    void *p;
+    int r, i;
+
+    for (r = 0; r < RUNS; r++) {
+	a->reset(0);
+	dirty_heap(a, CHURN_FREE, 1);
+	t = ftimer_now();
+	for (i = 0; i < BATCH; i++) {
+	    if ((p = a->malloc(CHURN_SIZE)) == NULL)
+		fail(a, "churn", CHURN_SIZE);
+	    memset(p, 0xff, CHURN_SIZE);
+	    a->free(p);
+	}
+	t = ftimer_now() - t;
+	if (best < 0 || t < best)
+	    best = t;
+    }
+    printf("%s,churn,reused,%lu,%d,%.1f\n", a->name,
+	   (unsigned long)CHURN_SIZE, BATCH, best * 1e9 / BATCH);
+    fflush(stdout);
+}
+
+int main(int argc, char **argv)
+{
+    int which = 3;
+    int c, a, n, by_calloc, fresh;
+    size_t size;
+
+    while ((c = getopt(argc, argv, "tm:b:a:h")) != EOF) {
+	switch (c) {
+	case 't': /* Touch every page inside the timing */
+	    touch = 1;
+	    break;
+	case 'm': /* Largest request */
+	    maxsize = strtoul(optarg, NULL, 0);
+	    break;
+	case 'b': /* Most bytes live in a batch */
+	    budget = strtoul(optarg, NULL, 0);
+	    break;
+	case 'a': /* Which allocators */
+	    if (strcmp(optarg, "mm") == 0)
+		which = 1;
+	    else if (strcmp(optarg, "libc") == 0)
+		which = 2;
+	    else if (strcmp(optarg, "all") == 0)
+		which = 3;
+	    else {
+		usage();
+		exit(1);
+	    }
+	    break;
+	case 'h':
+	    usage();
+	    exit(0);
+	default:
+	    usage();
+	    exit(1);
+	}
+    }
+    if (maxsize < 16 || budget < 1) {
+	usage();
+	exit(1);
+    }
+
+    mem_init();
+
+    printf("alloc,test,heap,size,count,ns\n");
+    for (size = 16; size <= maxsize; size *= 2) {
+	n = BATCH;
+	if ((size_t)n * size > budget)
+	    n = budget / size > 0 ? budget / size : 1;
+	for (a = 0; a < NALLOCS; a++) {
+	    if (!(which & (1 << a)))
+		continue;
+	    for (fresh = 1; fresh >= 0; fresh--)
+		for (by_calloc = 1; by_calloc >= 0; by_calloc--)
+		    measure(&allocs[a], by_calloc, fresh, size, n);
+	}
+    }
+    for (a = 0; a < NALLOCS; a++)
+	if (which & (1 << a))
+	    measure_churn(&allocs[a]);
+
+    mem_deinit();
+    exit(0);
+}
+
+/*
+ * usage - Explain the command line arguments
+ */
+static void usage(void)
+{
+    fprintf(stderr, "Usage: callocbench [-ht] [-m <maxsize>] [-b <budget>] [-a <alloc>]\n");
+    fprintf(stderr, "Options\n");
+    fprintf(stderr, "\t-t           Write every page of each block inside the timing.\n");
+    fprintf(stderr, "\t-m <maxsize> Largest request in bytes (16777216).\n");
+    fprintf(stderr, "\t-b <budget>  Most bytes live in one batch (268435456).\n");
+    fprintf(stderr, "\t-a <alloc>   Allocators to run: mm, libc or all.\n");
+    fprintf(stderr, "\t-h           Print this message.\n");
+}
@@ -0,0 +1,127 @@
+/*
+ * idmap.c - open-addressed hash table from trace ids to live blocks
+ *
+ * Linear probing with backward-shift deletion, so there are no
+ * tombstones and a lookup never scans more than the run it hashes into.
+ * The table doubles whenever it becomes half full.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "idmap.h"
+
+#define IDMAP_MINSLOTS 1024
+
+/* Fibonacci hashing spreads the mostly-sequential ids across the table */
+#define IDMAP_HASH(m, id) (((id) * 2654435769u) & (m)->mask)
+
+static void idmap_alloc(idmap_t *m, size_t nslots)
+{
+    if ((m->slots = malloc(nslots * sizeof(idmap_entry_t))) == NULL) {
+	printf("idmap: malloc failed: %s\n", strerror(errno));
+	exit(1);
+    }
+    memset(m->slots, 0xff, nslots * sizeof(idmap_entry_t));
+    m->mask = nslots - 1;
+    m->count = 0;
+}
+
+/*
+ * idmap_grow - double the table and reinsert every live entry
+ */
+static void idmap_grow(idmap_t *m)
+{
+    idmap_entry_t *old = m->slots;
+    size_t i, n = m->mask + 1;
+    idmap_entry_t *e;
+
+    idmap_alloc(m, 2 * n);
+    for (i = 0; i < n; i++) {
+	if (old[i].id != IDMAP_EMPTY) {
+	    e = idmap_put(m, old[i].id);
+	    e->size = old[i].size;
+	    e->ptr = old[i].ptr;
+	}
+    }
+    free(old);
+}
+
+/*
+ * idmap_init - create an empty table
+ */
+void idmap_init(idmap_t *m)
+{
+    idmap_alloc(m, IDMAP_MINSLOTS);
+}
+
+/*
+ * idmap_destroy - free the table's storage
+ */
+void idmap_destroy(idmap_t *m)
+{
+    free(m->slots);
+    m->slots = NULL;
+}
+
+/*
+ * idmap_put - return the entry for id, inserting it if it's new
+ */
+idmap_entry_t *idmap_put(idmap_t *m, unsigned int id)
+{
+    size_t i;
+
+    if (2 * (m->count + 1) > m->mask + 1)
+	idmap_grow(m);
+
+    for (i = IDMAP_HASH(m, id); ; i = (i + 1) & m->mask) {
+	if (m->slots[i].id == id)
+	    return &m->slots[i];
+	if (m->slots[i].id == IDMAP_EMPTY) {
+	    m->slots[i].id = id;
+	    m->count++;
+	    return &m->slots[i];
+	}
+    }
+}
+
+/*
+ * idmap_get - return the entry for id, or NULL if it isn't live
+ */
+idmap_entry_t *idmap_get(idmap_t *m, unsigned int id)
+{
+    size_t i;
+
+    for (i = IDMAP_HASH(m, id); ; i = (i + 1) & m->mask) {
+	if (m->slots[i].id == id)
+	    return &m->slots[i];
+	if (m->slots[i].id == IDMAP_EMPTY)
+	    return NULL;
+    }
+}
+
+/*
+ * idmap_remove - drop id from the table, shifting later entries of its
+ *     probe run back so that lookups never need tombstones
+ */
+void idmap_remove(idmap_t *m, unsigned int id)
+{
+    size_t i, j, home;
+
+    for (i = IDMAP_HASH(m, id); m->slots[i].id != id; i = (i + 1) & m->mask)
+	if (m->slots[i].id == IDMAP_EMPTY)
+	    return;
+
+    for (j = (i + 1) & m->mask; m->slots[j].id != IDMAP_EMPTY;
+	 j = (j + 1) & m->mask) {
+	home = IDMAP_HASH(m, m->slots[j].id);
+	/* Move j into the hole at i unless its home lies in (i, j] */
+	if (((j - home) & m->mask) >= ((j - i) & m->mask)) {
+	    m->slots[i] = m->slots[j];
+	    i = j;
+	}
+    }
+    m->slots[i].id = IDMAP_EMPTY;
+    m->count--;
+}
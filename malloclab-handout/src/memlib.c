@@ -18,20 +18,29 @@
 static char *mem_start_brk;  /* points to first byte of heap */
 static char *mem_brk;        /* points to last byte of heap */
 static char *mem_max_addr;   /* largest legal heap address */ 
+static char *mem_fresh;      /* lowest address the brk has never passed */
 
 /* 
  * mem_init - initialize the memory system model
+ *
+ * The heap is a private anonymous mapping rather than a malloc'd
+ * array, so that memlib can back an allocator that itself replaces
+ * malloc (see mmshim.c). Pages are only committed as the brk moves
+ * over them, so MAX_HEAP may be far larger than the heap ever gets.
  */
 void mem_init(void)
 {
-    /* allocate the storage we will use to model the available VM */
-    if ((mem_start_brk = (char *)malloc(MAX_HEAP)) == NULL) {
-	fprintf(stderr, "mem_init_vm: malloc error\n");
+    /* reserve the address space we will use to model the available VM */
+    mem_start_brk = mmap(NULL, MAX_HEAP, PROT_READ | PROT_WRITE,
+			 MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (mem_start_brk == MAP_FAILED) {
+	fprintf(stderr, "mem_init_vm: mmap error\n");
 	exit(1);
     }
 
     mem_max_addr = mem_start_brk + MAX_HEAP;  /* max legal heap address */
     mem_brk = mem_start_brk;                  /* heap is empty initially */
+    mem_fresh = mem_start_brk;                /* and all of it is zero */
 }
 
 /* 
@@ -39,7 +48,7 @@ void mem_init(void)
  */
 void mem_deinit(void)
 {
-    free(mem_start_brk);
+    munmap(mem_start_brk, MAX_HEAP);
 }
 
 /*
@@ -55,19 +64,55 @@ void mem_reset_brk()
  *    by incr bytes and returns the start address of the new area. In
  *    this model, the heap cannot be shrunk.
  */
-void *mem_sbrk(int incr) 
+void *mem_sbrk(intptr_t incr) 
 {
     char *old_brk = mem_brk;
 
-    if ( (incr < 0) || ((mem_brk + incr) > mem_max_addr)) {
+    if ( (incr < 0) || (incr > mem_max_addr - mem_brk)) {
 	errno = ENOMEM;
 	fprintf(stderr, "ERROR: mem_sbrk failed. Ran out of memory...\n");
 	return (void *)-1;
     }
     mem_brk += incr;
+    if (mem_brk > mem_fresh)
+	mem_fresh = mem_brk;
     return (void *)old_brk;
 }
 
+/*
+ * mem_fresh_lo - return the lowest address the brk has never passed.
+ *    The mapping has never been written from there on, so it reads as
+ *    zero. mem_reset_brk does not move it back: a heap that is reset
+ *    and grown again gets the old, dirty pages.
+ */
+void *mem_fresh_lo()
+{
+    return (void *)mem_fresh;
+}
+
+/*
+ * mem_release - give the whole pages in [lo, lo+len) back to the
+ *    system and zero the bytes around them, so the range reads as zero
+ *    afterwards. The pages are faulted in again, zeroed, when next
+ *    touched.
+ */
+void mem_release(void *lo, size_t len)
+{
+    size_t pagesize = mem_pagesize();
+    char *start = lo, *end = start + len;
+    char *plo = (char *)(((uintptr_t)start + pagesize - 1) & ~(pagesize - 1));
+    char *phi = (char *)((uintptr_t)end & ~(pagesize - 1));
+
+    if (phi <= plo) {
+	memset(start, 0, len);
+	return;
+    }
+    memset(start, 0, plo - start);
+    if (madvise(plo, phi - plo, MADV_DONTNEED) < 0)
+	memset(plo, 0, phi - plo);
+    memset(phi, 0, end - phi);
+}
+
 /*
  * mem_heap_lo - return address of the first heap byte
  */
@@ -16,6 +16,10 @@
  *   This is described in visual text below.
  * 
  * -For blocks, I used the boundary tag coalescing technique.
+ *
+ * - The pictures below are for the 32-bit build. In the native 64-bit
+ *   build (make BITS=64) every word is 8 bytes and blocks are 16-byte
+ *   aligned.
  */
 
 /* ALLOCATED BLOCK, FREE BLOCK, SEGREGATED FREE LIST, HEAP STRUCTURE
@@ -37,10 +41,11 @@
  
  
  2. Free block 
+    (Z is set when the payload past the links is known to be zero, see mm_calloc)
  
              31 30 29 28 27 26 25 24 23 22 21 20 19 18 17 16 15 14 13 12 11 10  9  8  7  6  5  4  3  2  1  0
             +--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+
- Header :   |                              size of the block                                       |  |  | 0|
+ Header :   |                              size of the block                                       |  | Z| 0|
       bp--> +--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+
             |                        pointer to pred block in free list                                     |
     bp+4--> +--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+
@@ -50,7 +55,7 @@
             .                                                                                               .
             .                                                                                               .
             +--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+
- Footer :   |                              size of the block                                       |     | 0|
+ Footer :   |                              size of the block                                       |  | Z| 0|
             +--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+
 
  3. Segregated Free Lists 
@@ -96,28 +101,32 @@
 #include <assert.h>
 #include <unistd.h>
 #include <string.h>
+#include <stdint.h>
 
 
 #include "mm.h"
 #include "memlib.h"
+#include "mmstats.h"
+#include "cachesim.h"
 
 /*********************************************************
  * NOTE TO STUDENTS: Before you do anything else, please
  * provide your team information in the following struct.
  ********************************************************/
 
-/* single word (4) or double word (8) alignment */
-#define ALIGNMENT 8
+/* Basic constants and macros*/
+#define WSIZE ((int)sizeof(void *)) /*Word and header/footer size: 4 bytes, 8 in 64-bit */
+#define DSIZE (2 * WSIZE) /*Double word size (bytes) */
+
+/* double word alignment: 8 bytes, 16 in 64-bit */
+#define ALIGNMENT DSIZE
 
 /* rounds up to the nearest multiple of ALIGNMENT */
-#define ALIGN(size) (((size) + (ALIGNMENT-1)) & ~0x7)
+#define ALIGN(size) (((size) + (ALIGNMENT-1)) & ~(ALIGNMENT-1))
 #define SIZE_T_SIZE (ALIGN(sizeof(size_t)))
-
-/* Basic constants and macros*/
-#define WSIZE 4 /*Word and header/footer size (bytes) */
-#define DSIZE 8 /*Double word size (bytes) */
 #define INITCHUNKSIZE (1<<6)
 #define CHUNKSIZE (1<<12) /*Extend heap by this amount(bytes)*/
+#define RELEASESIZE (1<<20) /*With MM_RELEASE, free blocks this big give their pages back*/
 
 #define MAXNUMBER 16
 
@@ -128,16 +137,30 @@
 /*Pack a size and allocated bit into a word*/
 #define PACK(size, alloc) ((size) | (alloc))
 
-/*Read and write a word at address p*/
-#define GET(p) (*(unsigned int *)(p))
-#define PUT(p, val) (*(unsigned int *)(p) = (val))
+/*Free blocks only: the payload past the links is zero*/
+#define ZERO 0x2
 
-//put pointer ptr in p (just simple address)
-#define SET_PTR(p, ptr) (*(unsigned int *)(p) = (unsigned int)(ptr))
+/*Read and write a word at address p*/
+/*(all metadata accesses go through MM_TOUCH, see cachesim.h)*/
+#define GET(p) (*(uintptr_t *)MM_TOUCH(p, WSIZE))
+#define PUT(p, val) (*(uintptr_t *)MM_TOUCH(p, WSIZE) = (val))
+
+//free list links are pointers. -DMM_OFFSET_LINKS makes them 32-bit
+//offsets in words from the start of the heap, 0 for NULL: both then fit
+//in 8 bytes even in the 64-bit build, and heaps up to 32 GB can be linked.
+#ifdef MM_OFFSET_LINKS
+typedef uint32_t link_t;
+#else
+typedef char *link_t;
+#endif
+
+//put the link to ptr in p
+#define SET_PTR(p, ptr) (*(link_t *)MM_TOUCH(p, sizeof(link_t)) = to_link(ptr))
 
 /*Read the size and allocated fields from address p*/
 #define GET_SIZE(p) (GET(p) & ~0x7)
 #define GET_ALLOC(p) (GET(p) & 0x1)
+#define GET_ZERO(p) (GET(p) & ZERO)
 
 /*Given block ptr bp, compute address of its header and footer*/
 #define HDRP(bp) ((char *)(bp)-WSIZE)
@@ -149,27 +172,64 @@
 
 // Address of free block's predecessor and successor entries
 #define PRED_PTR(bp) ((char *)(bp))
-#define SUCC_PTR(bp) ((char *)(bp) + WSIZE)
+#define SUCC_PTR(bp) ((char *)(bp) + sizeof(link_t))
 
 // Address of free block's predecessor and successor on the segregated list
-#define PRED(bp) (*(char **)(bp))
-#define SUCC(bp) (*(char **)(SUCC_PTR(bp)))
+#define PRED(bp) from_link(*(link_t *)MM_TOUCH(PRED_PTR(bp), sizeof(link_t)))
+#define SUCC(bp) from_link(*(link_t *)MM_TOUCH(SUCC_PTR(bp), sizeof(link_t)))
 
 //since we cannot use such thing as Array[i] = k,
 //these trivial pointer calculators are used to get and set
 //values from/tp free lists
-#define GET_FREE_LIST_PTR(i) (*(free_lists+i))
-#define SET_FREE_LIST_PTR(i, bp) (*(free_lists+i) = bp)
+#define GET_FREE_LIST_PTR(i) (*(char **)MM_TOUCH(free_lists+i, sizeof(char *)))
+#define SET_FREE_LIST_PTR(i, bp) (*(char **)MM_TOUCH(free_lists+i, sizeof(char *)) = bp)
 
 /*Global variables*/
 static char *heap_listp = 0; 
 static char **free_lists;
+static char *heap_base; //mem_heap_lo(), what offset links count from
+
+#ifdef MM_STATS
+__thread mm_counters_t mm_counters;
+#endif
+
+//convert a block pointer to a free list link and back
+static inline link_t to_link(void *bp)
+{
+#ifdef MM_OFFSET_LINKS
+    if (bp == NULL)
+        return 0;
+    return (link_t)(((char *)bp - heap_base) / WSIZE);
+#else
+    return (link_t)bp;
+#endif
+}
+
+static inline char *from_link(link_t link)
+{
+#ifdef MM_OFFSET_LINKS
+    if (link == 0)
+        return NULL;
+    return heap_base + (size_t)link * WSIZE;
+#else
+    return link;
+#endif
+}
 
 /*helper functions*/
 static void *extend_heap(size_t size);
+static void *find_fit(size_t asize);
 static void *coalesce(void *bp);
+static void zero_seam(void *bp);
+#ifdef MM_RELEASE
+static void release(void *bp);
+#endif
+static void free_block(void *bp);
+static void absorb_next(void *bp);
+static void sort_ptrs(void **a, size_t n);
 static void *place(void *bp, size_t asize);
 static void add(void *bp, size_t size);
+static void add_to_class(void *bp, size_t size, int i);
 static void delete(void *bp);
 
 void mm_check(int verbose);
@@ -182,6 +242,8 @@ int mm_init(void)
 {
     int i;
 
+    heap_base = mem_heap_lo();
+
     //create space for keeping free lists 
     if ((long)(free_lists = mem_sbrk(MAXNUMBER*sizeof(char *))) == -1){
         return -1;
@@ -205,7 +267,9 @@ int mm_init(void)
     if (extend_heap(INITCHUNKSIZE) == NULL)
         return -1;
 
+#ifdef MM_DEBUG
     mm_check(1);
+#endif
     
     return 0;
 }
@@ -223,6 +287,7 @@ void *mm_malloc(size_t size)
     size_t extendsize; //incase we need to extend heap 
     void *bp = NULL;  
     
+    MM_STAT(mallocs);
    
     if (size == 0) {
         return NULL;
@@ -236,37 +301,9 @@ void *mm_malloc(size_t size)
     }
     //textbook-add overhead bytes and then round up to nearest multiple of 8
     
-    int i = 0;
-    size_t searchsize = asize;
-
-    // search free lists for suitable free block
-    while (i < MAXNUMBER) {
-        if ((i == MAXNUMBER - 1) || ((searchsize <= 1) && 
-        (GET_FREE_LIST_PTR(i)!= NULL))) {
-            bp = GET_FREE_LIST_PTR(i);
-            
-            //in each size class
-            while ((bp != NULL) && (asize > GET_SIZE(HDRP(bp))))
-            {
-                bp = PRED(bp);
-            }
-            //found it!
-            if (bp != NULL){
-                //place requested block 
-                //(if there is an access, it will split in place())
-                bp = place(bp, asize);
-                //return the pointer of the newly allocated block
-                return bp;
-            }
-        }
-        
-        searchsize = searchsize >> 1;
-        i++;
-    }
-    
     // if allocator cannot find a fit, extend the heap with 
     //new free block
-    if (bp == NULL) {
+    if ((bp = find_fit(asize)) == NULL) {
         extendsize = MAX(asize, CHUNKSIZE);
         //place requested block in the new free block
         if ((bp = extend_heap(extendsize)) == NULL)
@@ -276,33 +313,232 @@ void *mm_malloc(size_t size)
     //(place() will optionally split the block)
     bp = place(bp, asize);
     
+#ifdef MM_DEBUG
     mm_check(1);
+#endif
     
     // return pointer to newly allocated block
     return bp;
 }
 
 
+/*
+ * mm_calloc - Allocate a block of n * size bytes, all zero. The
+ * memset is cut down to the links when the block comes from a free
+ * block known to be zero: wilderness the heap had never reached, or,
+ * with MM_RELEASE, pages given back by release().
+ */
+void *mm_calloc(size_t n, size_t size)
+{
+    size_t bytes, asize;
+    size_t zero;
+    void *bp;
+
+    MM_STAT(callocs);
+
+    if (size != 0 && n > (size_t)-1 / size)
+        return NULL;
+    if ((bytes = n * size) == 0)
+        return NULL;
+
+    //same adjustment as mm_malloc
+    if (bytes <= DSIZE) {
+        asize = 2 * DSIZE;
+    } else {
+        asize = ALIGN(bytes+DSIZE);
+    }
+
+    if ((bp = find_fit(asize)) == NULL &&
+        (bp = extend_heap(MAX(asize, CHUNKSIZE))) == NULL)
+        return NULL;
+
+    zero = GET_ZERO(HDRP(bp));
+    bp = place(bp, asize);
+
+    if (zero) {
+        MM_STAT(calloc_zero);
+        memset(bp, 0, MIN(bytes, DSIZE));
+    } else {
+        memset(bp, 0, bytes);
+    }
+
+#ifdef MM_DEBUG
+    mm_check(1);
+#endif
+
+    return bp;
+}
+
+
+/*
+ * mm_malloc_batch - Allocate n blocks of at least size bytes of payload
+ * into out, and return how many we got: n unless the heap ran out. All
+ * n blocks are taken as one span with a single fit search and place(),
+ * then cut up in address order. If no free block can hold the span,
+ * they are allocated one at a time, which fills holes the span is too
+ * big for instead of growing the heap.
+ */
+size_t mm_malloc_batch(size_t size, size_t n, void **out)
+{
+    size_t asize, bsize, i;
+    char *bp = NULL;
+
+    MM_STAT(batch_mallocs);
+
+    if (size == 0 || n == 0)
+        return 0;
+
+    //same adjustment as mm_malloc
+    if (size <= DSIZE) {
+        asize = 2 * DSIZE;
+    } else {
+        asize = ALIGN(size+DSIZE);
+    }
+
+    if (n <= (size_t)-1 / asize)
+        bp = find_fit(n * asize);
+    if (bp == NULL) {
+        for (i = 0; i < n && (out[i] = mm_malloc(size)) != NULL; i++)
+            ;
+        return i;
+    }
+
+    bp = place(bp, n * asize);
+
+    //the last block keeps whatever place() did not split off
+    bsize = GET_SIZE(HDRP(bp));
+    for (i = 0; i < n - 1; i++) {
+        PUT(HDRP(bp), PACK(asize, 1));
+        PUT(FTRP(bp), PACK(asize, 1));
+        out[i] = bp;
+        bp = NEXT_BLKP(bp);
+        bsize -= asize;
+    }
+    PUT(HDRP(bp), PACK(bsize, 1));
+    PUT(FTRP(bp), PACK(bsize, 1));
+    out[n - 1] = bp;
+
+#ifdef MM_DEBUG
+    mm_check(1);
+#endif
+
+    return n;
+}
+
 /*
  * mm_free - Freeing a block
  */
 void mm_free(void *bp)
 {
    size_t size = GET_SIZE(HDRP(bp));
+
+    MM_STAT(frees);
     
     //change header and footer to free 
     PUT(HDRP(bp), PACK(size, 0));
     PUT(FTRP(bp), PACK(size, 0));
     
-    //add it to free lists
-    add(bp, size);
-
-    //incase there is free block in prev or next block 
-    coalesce(bp);
+    free_block(bp);
     
     return;
 }
 
+/*
+ * mm_free_sized - Free a block, given the size it was last asked for
+ * with (by mm_malloc, mm_calloc, mm_memalign or mm_realloc). The size
+ * is adjusted as mm_malloc adjusts it; if that is the block size, as
+ * it is unless place() left the block whole, and neither neighbour is
+ * free, the block goes onto its free list with the class taken from
+ * the size (no class loop, no coalesce). Anything else is freed as
+ * mm_free frees it, so a wrong size is never trusted; under MM_DEBUG
+ * an adjusted size bigger than the block is reported.
+ */
+void mm_free_sized(void *bp, size_t size)
+{
+    size_t asize, bsize = GET_SIZE(HDRP(bp));
+    int i;
+
+    MM_STAT(frees);
+    MM_STAT(sized_frees);
+
+    //same adjustment as mm_malloc
+    if (size <= DSIZE)
+        asize = 2 * DSIZE;
+    else
+        asize = ALIGN(size+DSIZE);
+
+#ifdef MM_DEBUG
+    if (asize > bsize)
+        printf("Error: mm_free_sized of %lu bytes, block %p is %lu\n",
+               (unsigned long)asize, bp, (unsigned long)bsize);
+#endif
+
+    PUT(HDRP(bp), PACK(bsize, 0));
+    PUT(FTRP(bp), PACK(bsize, 0));
+
+    if (asize != bsize || asize >= RELEASESIZE ||
+        !GET_ALLOC(HDRP(PREV_BLKP(bp))) || !GET_ALLOC(HDRP(NEXT_BLKP(bp)))) {
+        free_block(bp);
+        return;
+    }
+
+    //the class add would pick: the top bit of the size, at most the last
+    i = 63 - __builtin_clzll(asize);
+    if (i > MAXNUMBER - 1)
+        i = MAXNUMBER - 1;
+
+    MM_STAT(sized_hits);
+    MM_STAT(coalesce[MM_COALESCE_NONE]);
+    add_to_class(bp, asize >> i, i);
+}
+
+/*
+ * mm_free_batch - Free the n blocks in ptrs, skipping NULLs. ptrs is
+ * sorted by address in place, and blocks next to each other in the
+ * heap (with or without a free block between them) are merged into one
+ * run before it goes on a free list, so each run is added and coalesced
+ * once rather than every block being added and then deleted again by
+ * its neighbour's coalesce.
+ */
+void mm_free_batch(void **ptrs, size_t n)
+{
+    char *run = NULL; //free run being built, on no free list
+    char *bp;
+    size_t i;
+
+    MM_STAT(batch_frees);
+
+    //blocks freed in the order mm_malloc_batch gave them are sorted already
+    for (i = 1; i < n && (char *)ptrs[i - 1] <= (char *)ptrs[i]; i++)
+        ;
+    if (i < n)
+        sort_ptrs(ptrs, n);
+
+    for (i = 0; i < n; i++) {
+        if ((bp = ptrs[i]) == NULL)
+            continue;
+
+        //take in a free block after the run, as coalesce would
+        if (run != NULL && !GET_ALLOC(HDRP(NEXT_BLKP(run)))) {
+            delete(NEXT_BLKP(run));
+            absorb_next(run);
+        }
+
+        if (run != NULL && NEXT_BLKP(run) == bp) {
+            absorb_next(run);
+        } else {
+            if (run != NULL)
+                free_block(run);
+            run = bp;
+            PUT(HDRP(run), PACK(GET_SIZE(HDRP(run)), 0));
+            PUT(FTRP(run), PACK(GET_SIZE(HDRP(run)), 0));
+        }
+    }
+
+    if (run != NULL)
+        free_block(run);
+}
+
 /*
  * mm_realloc : returns a pointer to an allocated region of 
  * at least size bytes
@@ -311,12 +547,15 @@ void mm_free(void *bp)
 void *mm_realloc(void *bp, size_t size)
 {   
     void *new_block = bp;
-    int remainder;
+    long remainder;
 
+    MM_STAT(reallocs);
     if (bp == NULL) { //the call is equivalent to mm_malloc(size)
+        MM_STAT(realloc_path[MM_REALLOC_MALLOC]);
         return mm_malloc(size);
     }
     if (size == 0) { //the call is equivalent to mm_free(ptr)
+        MM_STAT(realloc_path[MM_REALLOC_FREE]);
         mm_free(bp);
         return NULL;
     }
@@ -332,14 +571,20 @@ void *mm_realloc(void *bp, size_t size)
     //old block size is bigger
     //I think just return the original block
     if ((remainder = GET_SIZE(HDRP(bp)) - size) >= 0){
+        MM_STAT(realloc_path[MM_REALLOC_INPLACE]);
         //PUT(HDRP(bp), PACK(size, 1));
         //PUT(FTRP(bp), PACK(size, 1));
         //mm_free(NEXT_BLKP(bp));
         return bp;
     }
     //new block size is bigger and next block is not allocated
-    //use adjacent block to minimize external fragmentation
-    else if (!GET_ALLOC(HDRP(NEXT_BLKP(bp))) || !GET_SIZE(HDRP(NEXT_BLKP(bp)))){
+    //use adjacent block to minimize external fragmentation, growing
+    //the heap only when bp is the last block or the last but a free one
+    else if ((!GET_ALLOC(HDRP(NEXT_BLKP(bp))) || !GET_SIZE(HDRP(NEXT_BLKP(bp)))) &&
+             (GET_SIZE(HDRP(bp)) + GET_SIZE(HDRP(NEXT_BLKP(bp))) >= size ||
+              !GET_SIZE(HDRP(NEXT_BLKP(bp))) ||
+              !GET_SIZE(HDRP(NEXT_BLKP(NEXT_BLKP(bp)))))){
+        MM_STAT(realloc_path[MM_REALLOC_NEXT]);
         if ((remainder = GET_SIZE(HDRP(bp)) + GET_SIZE(HDRP(NEXT_BLKP(bp))) - size) < 0){
             if (extend_heap(MAX(-remainder, CHUNKSIZE)) == NULL){
                 return NULL;
@@ -353,8 +598,10 @@ void *mm_realloc(void *bp, size_t size)
     //in this case where new block's size is bigger
     //but we cannot use adjacent block, address will be different 
     else{
-        new_block = mm_malloc(size);
-        memcpy(new_block, bp, GET_SIZE(HDRP(bp)));
+        MM_STAT(realloc_path[MM_REALLOC_MOVE]);
+        if ((new_block = mm_malloc(size)) == NULL)
+            return NULL;
+        memcpy(new_block, bp, GET_SIZE(HDRP(bp)) - DSIZE);
         mm_free(bp);
     }
 
@@ -362,20 +609,121 @@ void *mm_realloc(void *bp, size_t size)
     
 }
 
+/*
+ * mm_memalign - Allocate a block with at least size bytes of payload
+ * at a multiple of align, which must be a power of 2. A block with
+ * room for the alignment is taken with mm_malloc; the bytes in front
+ * of the aligned payload (at least a minimum block) and whatever is
+ * left past the request are split off and freed again, rather than
+ * kept as padding.
+ */
+void *mm_memalign(size_t align, size_t size)
+{
+    size_t asize, bsize, lead;
+    char *bp, *abp, *rest;
+
+    if (align == 0 || (align & (align - 1)) != 0)
+        return NULL;
+    if (align <= ALIGNMENT)
+        return mm_malloc(size);
+    if (size == 0 || size > (size_t)-1 - align - 4 * DSIZE)
+        return NULL;
+
+    //same adjustment as mm_malloc
+    if (size <= DSIZE) {
+        asize = 2 * DSIZE;
+    } else {
+        asize = ALIGN(size+DSIZE);
+    }
+
+    if ((bp = mm_malloc(asize + align + 2 * DSIZE)) == NULL)
+        return NULL;
+
+    //first aligned payload with no room or a minimum block before it
+    abp = (char *)(((uintptr_t)bp + align - 1) & ~(uintptr_t)(align - 1));
+    while (abp != bp && abp - bp < 2 * DSIZE)
+        abp += align;
+
+    if ((lead = abp - bp) > 0) {
+        bsize = GET_SIZE(HDRP(bp));
+        PUT(HDRP(abp), PACK(bsize - lead, 1));
+        PUT(FTRP(abp), PACK(bsize - lead, 1));
+        PUT(HDRP(bp), PACK(lead, 0));
+        PUT(FTRP(bp), PACK(lead, 0));
+        add(bp, lead);
+        coalesce(bp);
+    }
+
+    //split off the tail if it can be a block of its own
+    bsize = GET_SIZE(HDRP(abp));
+    if (bsize - asize >= 2 * DSIZE) {
+        PUT(HDRP(abp), PACK(asize, 1));
+        PUT(FTRP(abp), PACK(asize, 1));
+        rest = NEXT_BLKP(abp);
+        PUT(HDRP(rest), PACK(bsize - asize, 0));
+        PUT(FTRP(rest), PACK(bsize - asize, 0));
+        add(rest, bsize - asize);
+        coalesce(rest);
+    }
+
+#ifdef MM_DEBUG
+    mm_check(1);
+#endif
+
+    return abp;
+}
+
+/*
+ * mm_aligned_alloc - the C11 name for mm_memalign
+ */
+void *mm_aligned_alloc(size_t align, size_t size)
+{
+    return mm_memalign(align, size);
+}
+
+/*
+ * mm_usable_size - number of payload bytes in the allocated block bp,
+ * which is at least the size it was allocated or reallocated with
+ */
+size_t mm_usable_size(void *bp)
+{
+    return GET_SIZE(HDRP(bp)) - DSIZE;
+}
+
+/*
+ * mm_heap_walk - call fn on every block after the prologue, in address
+ * order, up to the epilogue
+ */
+void mm_heap_walk(mm_walker_t fn, void *arg)
+{
+    char *bp;
+
+    for (bp = NEXT_BLKP(heap_listp); GET_SIZE(HDRP(bp)) > 0; bp = NEXT_BLKP(bp))
+        fn(bp, GET_SIZE(HDRP(bp)), GET_SIZE(HDRP(bp)) - DSIZE,
+           GET_ALLOC(HDRP(bp)), arg);
+}
+
 /*helper function*/
 static void *extend_heap(size_t size)
 {
     void *bp;
     size_t asize; //adjusted size to maintain alignment               
+    char *fresh = mem_fresh_lo();
+    size_t zero;
     
     asize = ALIGN(size);
     
     if ((bp = mem_sbrk(asize)) == (void *)-1)
         return NULL;
+    MM_STAT(extends);
+    MM_STAT_ADD(extend_bytes, asize);
+    
+    //known-zero if the heap never reached this far before
+    zero = (char *)bp >= fresh ? ZERO : 0;
     
     /*Initialize free block header/footer and the epilogue header*/
-    PUT(HDRP(bp), PACK(asize, 0)); //Free block header
-    PUT(FTRP(bp), PACK(asize, 0)); //Free block footer 
+    PUT(HDRP(bp), PACK(asize, zero)); //Free block header
+    PUT(FTRP(bp), PACK(asize, zero)); //Free block footer 
     PUT(HDRP(NEXT_BLKP(bp)), PACK(0, 1)); //New epilouge header
     add(bp, asize);
     
@@ -383,11 +731,41 @@ static void *extend_heap(size_t size)
     return coalesce(bp);
 }
 
+//search the free lists for a block of at least asize bytes
+static void *find_fit(size_t asize)
+{
+    int i = 0;
+    size_t searchsize = asize;
+    void *bp = NULL;
+
+    // search free lists for suitable free block
+    while (i < MAXNUMBER) {
+        if ((i == MAXNUMBER - 1) || ((searchsize <= 1) && 
+        (GET_FREE_LIST_PTR(i)!= NULL))) {
+            bp = GET_FREE_LIST_PTR(i);
+            MM_STAT(find_lists);
+            
+            //in each size class
+            while ((bp != NULL) && (asize > GET_SIZE(HDRP(bp))))
+            {
+                MM_STAT(find_visits);
+                bp = PRED(bp);
+            }
+            //found it!
+            if (bp != NULL)
+                return bp;
+        }
+        
+        searchsize = searchsize >> 1;
+        i++;
+    }
+    
+    return NULL;
+}
+
 //add to free lists
 static void add(void *bp, size_t size) {
     int i = 0;
-    void *curr = bp;
-    void *succ = NULL;
     
     // Select size class 
     while ((i < MAXNUMBER - 1) && (size > 1)) {
@@ -395,10 +773,20 @@ static void add(void *bp, size_t size) {
         i++;
     }
     
+    add_to_class(bp, size, i);
+}
+
+//add to free list i; size is what the class loop in add leaves of the
+//block size, which is the size shifted right i times
+static void add_to_class(void *bp, size_t size, int i) {
+    void *curr = bp;
+    void *succ = NULL;
+    
     //now we are in particular size class
     //pred <- curr <- succ (we move that way)
     curr = GET_FREE_LIST_PTR(i);
     while ((curr != NULL) && (size > GET_SIZE(HDRP(curr)))) {
+        MM_STAT(insert_visits);
         succ = curr;
         curr = PRED(curr);
     }
@@ -466,37 +854,57 @@ static void delete(void *bp) {
 * this is done in physical heap memory
 * returns pointer to new free block
 * coalesce is called before it goes in the free list
+* the new block is known-zero only if every block merged was, and then
+* the tags and links between them are zeroed
 */
 static void *coalesce(void *bp)
 {
-    size_t prev_alloc = GET_ALLOC(HDRP(PREV_BLKP(bp)));
-    size_t next_alloc = GET_ALLOC(HDRP(NEXT_BLKP(bp)));
+    char *prev = PREV_BLKP(bp);
+    char *next = NEXT_BLKP(bp);
+    size_t prev_alloc = GET_ALLOC(HDRP(prev));
+    size_t next_alloc = GET_ALLOC(HDRP(next));
     size_t size = GET_SIZE(HDRP(bp));
+    size_t zero = GET_ZERO(HDRP(bp));
     
     if (prev_alloc && next_alloc) { //both allocated                    
+        MM_STAT(coalesce[MM_COALESCE_NONE]);
         return bp;
     }
     else if (prev_alloc && !next_alloc) { //merge next block
+        MM_STAT(coalesce[MM_COALESCE_NEXT]);
         delete(bp);
-        delete(NEXT_BLKP(bp));
-        size += GET_SIZE(HDRP(NEXT_BLKP(bp)));
-        PUT(HDRP(bp), PACK(size, 0));
-        PUT(FTRP(bp), PACK(size, 0));
+        delete(next);
+        size += GET_SIZE(HDRP(next));
+        zero &= GET_ZERO(HDRP(next));
+        PUT(HDRP(bp), PACK(size, zero));
+        PUT(FTRP(bp), PACK(size, zero));
+        if (zero)
+            zero_seam(next);
     } else if (!prev_alloc && next_alloc) { //merge with prev block            
+        MM_STAT(coalesce[MM_COALESCE_PREV]);
         delete(bp);
-        delete(PREV_BLKP(bp));
-        size += GET_SIZE(HDRP(PREV_BLKP(bp)));
-        PUT(FTRP(bp), PACK(size, 0));
-        PUT(HDRP(PREV_BLKP(bp)), PACK(size, 0));
-        bp = PREV_BLKP(bp);
+        delete(prev);
+        size += GET_SIZE(HDRP(prev));
+        zero &= GET_ZERO(HDRP(prev));
+        PUT(FTRP(bp), PACK(size, zero));
+        PUT(HDRP(prev), PACK(size, zero));
+        if (zero)
+            zero_seam(bp);
+        bp = prev;
     } else {                      // merge with both
+        MM_STAT(coalesce[MM_COALESCE_BOTH]);
         delete(bp);
-        delete(PREV_BLKP(bp));
-        delete(NEXT_BLKP(bp));
-        size += GET_SIZE(HDRP(PREV_BLKP(bp))) + GET_SIZE(HDRP(NEXT_BLKP(bp)));
-        PUT(HDRP(PREV_BLKP(bp)), PACK(size, 0));
-        PUT(FTRP(NEXT_BLKP(bp)), PACK(size, 0));
-        bp = PREV_BLKP(bp);
+        delete(prev);
+        delete(next);
+        size += GET_SIZE(HDRP(prev)) + GET_SIZE(HDRP(next));
+        zero &= GET_ZERO(HDRP(prev)) & GET_ZERO(HDRP(next));
+        PUT(HDRP(prev), PACK(size, zero));
+        PUT(FTRP(next), PACK(size, zero));
+        if (zero) {
+            zero_seam(bp);
+            zero_seam(next);
+        }
+        bp = prev;
     }
     
     add(bp, size);
@@ -504,18 +912,136 @@ static void *coalesce(void *bp)
     return bp;
 }
 
+//zero the footer before bp, bp's header and its links, which become
+//payload when bp is merged into the known-zero block before it
+static void zero_seam(void *bp)
+{
+    PUT((char *)bp - DSIZE, 0);
+    PUT(HDRP(bp), 0);
+    PUT(bp, 0);
+    PUT((char *)bp + WSIZE, 0);
+}
+
+#ifdef MM_RELEASE
+//give the pages of free block bp back to the system, leaving all of its
+//payload past the links zero, and mark it known-zero
+static void release(void *bp)
+{
+    size_t size = GET_SIZE(HDRP(bp));
+
+    MM_STAT(releases);
+    MM_STAT_ADD(release_bytes, size);
+    mem_release((char *)bp + DSIZE, size - 2 * DSIZE);
+    PUT(HDRP(bp), PACK(size, ZERO));
+    PUT(FTRP(bp), PACK(size, ZERO));
+}
+#endif
+
+//put free block bp, which is on no free list, on one and coalesce it.
+//Built with -DMM_RELEASE (libmmshim.so, callocbench) it also gives the
+//pages back if the merged block is RELEASESIZE or more, for mm_calloc;
+//when the merged block would be that big and its free neighbours are
+//known-zero, a smaller bp is zeroed instead, so it stays known-zero and
+//a block taken from a large free block and freed again does not release
+//all of it every time. The graded mm_free pays for neither
+static void free_block(void *bp)
+{
+#ifdef MM_RELEASE
+    size_t size = GET_SIZE(HDRP(bp)), merged = size;
+    size_t zero = ZERO; //are the free neighbours known-zero?
+
+    if (!GET_ALLOC(HDRP(PREV_BLKP(bp)))) {
+        merged += GET_SIZE(HDRP(PREV_BLKP(bp)));
+        zero &= GET_ZERO(HDRP(PREV_BLKP(bp)));
+    }
+    if (!GET_ALLOC(HDRP(NEXT_BLKP(bp)))) {
+        merged += GET_SIZE(HDRP(NEXT_BLKP(bp)));
+        zero &= GET_ZERO(HDRP(NEXT_BLKP(bp)));
+    }
+    if (merged >= RELEASESIZE && zero && size < RELEASESIZE) {
+        memset((char *)bp + DSIZE, 0, size - 2 * DSIZE);
+        PUT(HDRP(bp), PACK(size, ZERO));
+        PUT(FTRP(bp), PACK(size, ZERO));
+    }
+#endif
+
+    //add it to free lists
+    add(bp, GET_SIZE(HDRP(bp)));
+
+    //incase there is free block in prev or next block 
+    bp = coalesce(bp);
+
+#ifdef MM_RELEASE
+    //give the pages of large free blocks back
+    if (GET_SIZE(HDRP(bp)) >= RELEASESIZE && !GET_ZERO(HDRP(bp)))
+        release(bp);
+#endif
+}
+
+//merge the block after bp into bp; both must be free and on no free list
+static void absorb_next(void *bp)
+{
+    size_t size = GET_SIZE(HDRP(bp)) + GET_SIZE(HDRP(NEXT_BLKP(bp)));
+
+    MM_STAT(batch_merges);
+    PUT(HDRP(bp), PACK(size, 0));
+    PUT(FTRP(bp), PACK(size, 0));
+}
+
+//sort the n block pointers in a by address: quicksort (recursing into
+//the smaller side) down to 16, then insertion sort. The comparisons
+//are inline, which beats qsort calling back for every one of them.
+static void sort_ptrs(void **a, size_t n)
+{
+    char *pivot, *t;
+    long i, j;
+
+    while (n > 16) {
+        pivot = a[n / 2];
+        i = -1;
+        j = n;
+        for (;;) {
+            do i++; while ((char *)a[i] < pivot);
+            do j--; while ((char *)a[j] > pivot);
+            if (i >= j)
+                break;
+            t = a[i];
+            a[i] = a[j];
+            a[j] = t;
+        }
+        //a[0..j] and a[j+1..n-1] are left to sort
+        if (j + 1 < n - (j + 1)) {
+            sort_ptrs(a, j + 1);
+            a += j + 1;
+            n -= j + 1;
+        } else {
+            sort_ptrs(a + j + 1, n - (j + 1));
+            n = j + 1;
+        }
+    }
+
+    for (i = 1; i < n; i++) {
+        t = a[i];
+        for (j = i; j > 0 && (char *)a[j - 1] > t; j--)
+            a[j] = a[j - 1];
+        a[j] = t;
+    }
+}
+
 /*place - place block of asize bytes at free block bp
           split if remainder would be at least minimum block size*/
 static void *place(void *bp, size_t asize)
 {
     size_t bp_size = GET_SIZE(HDRP(bp));
     size_t remainder = bp_size - asize;
+    size_t zero = GET_ZERO(HDRP(bp)); //the remainder stays known-zero
     
     delete(bp);
     
     
     if (remainder <= DSIZE * 2) {
         // Do not split block
+        MM_STAT(nosplits);
         PUT(HDRP(bp), PACK(bp_size, 1));
         PUT(FTRP(bp), PACK(bp_size, 1));
     }
@@ -548,8 +1074,9 @@ static void *place(void *bp, size_t asize)
      and binary2-bal.rep
      */
      else if (asize >= 96) {
-        PUT(HDRP(bp), PACK(remainder, 0));
-        PUT(FTRP(bp), PACK(remainder, 0));
+        MM_STAT(splits);
+        PUT(HDRP(bp), PACK(remainder, zero));
+        PUT(FTRP(bp), PACK(remainder, zero));
         PUT(HDRP(NEXT_BLKP(bp)), PACK(asize, 1));
         PUT(FTRP(NEXT_BLKP(bp)), PACK(asize, 1));
         add(bp, remainder);
@@ -558,10 +1085,11 @@ static void *place(void *bp, size_t asize)
     }
     
     else {
+        MM_STAT(splits);
         PUT(HDRP(bp), PACK(asize, 1));
         PUT(FTRP(bp), PACK(asize, 1));
-        PUT(HDRP(NEXT_BLKP(bp)), PACK(remainder, 0));
-        PUT(FTRP(NEXT_BLKP(bp)), PACK(remainder, 0));
+        PUT(HDRP(NEXT_BLKP(bp)), PACK(remainder, zero));
+        PUT(FTRP(NEXT_BLKP(bp)), PACK(remainder, zero));
         add(NEXT_BLKP(bp), remainder);
     }
     return bp;
@@ -591,7 +1119,7 @@ static void printblock(void *bp)
 //check if block is doubleword aligned and header match the footer
 static void checkblock(void *bp) 
 {
-    if ((size_t)bp % 8)
+    if ((size_t)bp % ALIGNMENT)
 	printf("Error: %p is not doubleword aligned\n", bp);
     if (GET(HDRP(bp)) != GET(FTRP(bp)))
 	printf("Error: header does not match footer\n");
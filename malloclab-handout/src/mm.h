@@ -4,6 +4,38 @@ extern int mm_init (void);
 extern void *mm_malloc (size_t size);
 extern void mm_free (void *ptr);
 extern void *mm_realloc(void *ptr, size_t size);
+extern void *mm_calloc(size_t n, size_t size);
+extern void *mm_memalign(size_t align, size_t size);
+extern void *mm_aligned_alloc(size_t align, size_t size);
+extern size_t mm_usable_size(void *ptr);
+
+/*
+ * mm_free_sized frees ptr like mm_free, given the size in bytes it was
+ * allocated with by mm_malloc, mm_calloc or mm_malloc_batch, which lets
+ * the common case skip working out the block's size class. Blocks from
+ * mm_realloc or mm_memalign must be freed with mm_free.
+ */
+extern void mm_free_sized(void *ptr, size_t size);
+
+/*
+ * mm_malloc_batch puts n blocks of size bytes in out[0..n-1], carved
+ * from one free block where it can, and returns how many it got: n
+ * unless the heap ran out. mm_free_batch frees the n blocks in ptrs,
+ * which it sorts by address so neighbours are coalesced as one run;
+ * NULL entries are skipped.
+ */
+extern size_t mm_malloc_batch(size_t size, size_t n, void **out);
+extern void mm_free_batch(void **ptrs, size_t n);
+
+/*
+ * mm_heap_walk calls fn once for every block in the heap, in address
+ * order, with the block's payload address, its total size in bytes
+ * (tags included), the payload bytes it can hold, and whether it is
+ * allocated. fn must not call into the package.
+ */
+typedef void (*mm_walker_t)(void *bp, size_t blocksize, size_t usable,
+			    int alloc, void *arg);
+extern void mm_heap_walk(mm_walker_t fn, void *arg);
 
 
 /* 
@@ -0,0 +1,30 @@
+#ifndef __MMARENA_H_
+#define __MMARENA_H_
+
+/*
+ * mmarena.h - arenas (regions) on top of mm.c
+ *
+ * An arena hands out blocks by bumping a pointer through chunks it
+ * gets from mm_malloc, and never frees them one at a time. Instead
+ * mm_arena_reset frees every block in it at once, with one mm_free per
+ * chunk rather than one per block, keeping a chunk for the blocks that
+ * come next; mm_arena_destroy frees the arena itself too. This suits
+ * data that all dies at the same moment, such as what a request
+ * allocates while it is being served.
+ *
+ * Arena blocks are aligned as mm_malloc's are but have no headers, so
+ * they must not be passed to mm_free, mm_realloc or mm_usable_size.
+ * chunk is the size in bytes of the chunks to take (0 for 64 KB);
+ * requests over a quarter of it get a chunk of their own. Returns NULL
+ * when mm.c does.
+ */
+#include <stddef.h>
+
+typedef struct mm_arena mm_arena_t;
+
+mm_arena_t *mm_arena_create(size_t chunk);
+void *mm_arena_alloc(mm_arena_t *a, size_t size);
+void mm_arena_reset(mm_arena_t *a);
+void mm_arena_destroy(mm_arena_t *a);
+
+#endif /* __MMARENA_H_ */
@@ -0,0 +1,286 @@
+/*
+ * mmbench.c - time the primitives of mm.c one at a time
+ *
+ *     unix> mmbench [-r rounds] [-l maxlen] [-k class]
+ *
+ * mm.c is included whole so that its static helpers can be called
+ * directly. For each list length L = 1, 2, 4, ..., maxlen a synthetic
+ * heap is built whose free list for size class k (2^k to 2^(k+1)-1
+ * bytes) holds exactly L blocks, each between two allocated blocks so
+ * nothing coalesces by accident, and add, delete, place and coalesce
+ * are timed against it in batches of BATCH calls between reads of the
+ * clock. Each call is set up so that the block it ends up adding has
+ * the target size for the list. Blocks the primitives work on are
+ * carved next to the list, and any bookkeeping needed to repeat a
+ * batch is done outside the timed region.
+ *
+ * Two size mixes are run. In "same" every block on the list has 2^k
+ * bytes, and so does the target. In "spread" the sizes are spread
+ * evenly over the class and the target is the largest, which a list
+ * sorted by size would put last. A row that stays flat as L doubles
+ * is O(1); one that doubles with it is O(L).
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "mm.c"
+#include "ftimer.h"
+
+#define BATCH     64     /* calls between reads of the clock */
+#define SEP_SIZE  16     /* size of the allocated blocks between others */
+
+/* Results for one heap, in ns per call */
+typedef struct {
+    double add;          /* add of a block of the target size */
+    double delete;       /* delete of the same */
+    double place;        /* place, splitting off the target size */
+    double coalesce;     /* coalesce of three blocks into the target size */
+} result_t;
+
+static int rounds = 2000;           /* batches timed per primitive */
+static int cls = 9;                 /* size class of the list */
+static size_t target;               /* size the timed calls add */
+static char *spare[BATCH];          /* target-sized blocks for add/delete */
+static char *triple[BATCH];         /* first of three blocks for coalesce */
+static char *big[BATCH];            /* blocks for place */
+
+/* function prototypes */
+static void usage(void);
+
+/*
+ * set_block - write the header and footer of the block at bp
+ */
+static void set_block(char *bp, size_t size, int alloc)
+{
+    PUT(HDRP(bp), PACK(size, alloc));
+    PUT(FTRP(bp), PACK(size, alloc));
+}
+
+/*
+ * carve - take a new allocated block of size bytes (a multiple of DSIZE)
+ *     from the top of the heap
+ */
+static char *carve(size_t size)
+{
+    char *bp;
+
+    if ((bp = mem_sbrk(size)) == (void *)-1) {
+	printf("mmbench: out of heap, use a smaller -l\n");
+	exit(1);
+    }
+    set_block(bp, size, 1);
+    PUT(HDRP(NEXT_BLKP(bp)), PACK(0, 1));
+    return bp;
+}
+
+/*
+ * list_size - size in bytes of the i'th of n blocks on the list
+ */
+static size_t list_size(int i, int n, int spread)
+{
+    size_t lo = (size_t)1 << cls;
+
+    if (!spread || n == 1)
+	return lo;
+    return lo + DSIZE * ((lo / DSIZE - 1) * i / (n - 1));
+}
+
+/*
+ * third - size of the first two of the three blocks that coalesce
+ *     into the target (the third takes what is left)
+ */
+static size_t third(void)
+{
+    return ALIGN(target / 3);
+}
+
+/*
+ * build - reset the heap and lay out the list of n blocks, followed by
+ *     the blocks the primitives will be run on
+ */
+static void build(int n, int spread)
+{
+    char *bp;
+    int i;
+
+    mem_reset_brk();
+    if (mm_init() < 0) {
+	printf("mmbench: mm_init failed\n");
+	exit(1);
+    }
+
+    /* Take the first chunk off its list so the only free blocks are ours */
+    bp = NEXT_BLKP(heap_listp);
+    delete(bp);
+    set_block(bp, GET_SIZE(HDRP(bp)), 1);
+
+    target = list_size(n - 1, n, spread);
+    for (i = 0; i < n; i++) {
+	bp = carve(list_size(i, n, spread));
+	carve(SEP_SIZE);
+	set_block(bp, GET_SIZE(HDRP(bp)), 0);
+	add(bp, GET_SIZE(HDRP(bp)));
+    }
+
+    /* Free blocks of the target size, kept off the list */
+    for (i = 0; i < BATCH; i++) {
+	spare[i] = carve(target);
+	set_block(spare[i], target, 0);
+	carve(SEP_SIZE);
+    }
+
+    /* Three blocks in a row, all a class below the target */
+    for (i = 0; i < BATCH; i++) {
+	triple[i] = carve(third());
+	carve(third());
+	carve(target - 2 * third());
+	carve(SEP_SIZE);
+    }
+
+    /* Blocks a class above, that place splits down to the target */
+    for (i = 0; i < BATCH; i++) {
+	big[i] = carve(target + (2 << cls));
+	carve(SEP_SIZE);
+    }
+}
+
+/*
+ * ns - convert secs spent on rounds batches into ns per call
+ */
+static double ns(double secs)
+{
+    return secs * 1e9 / ((double)rounds * BATCH);
+}
+
+/*
+ * run - time each primitive against the heap left by build()
+ */
+static void run(result_t *res)
+{
+    double t, s_add = 0, s_delete = 0, s_place = 0, s_coalesce = 0;
+    char *bp;
+    int r, i, j;
+
+    for (r = 0; r < rounds; r++) {
+	t = ftimer_now();
+	for (i = 0; i < BATCH; i++)
+	    add(spare[i], target);
+	s_add += ftimer_now() - t;
+
+	t = ftimer_now();
+	for (i = 0; i < BATCH; i++)
+	    delete(spare[i]);
+	s_delete += ftimer_now() - t;
+
+	/* Free all three blocks of each triple, as mm_free would */
+	for (i = 0; i < BATCH; i++)
+	    for (j = 0, bp = triple[i]; j < 3; j++, bp = NEXT_BLKP(bp)) {
+		set_block(bp, GET_SIZE(HDRP(bp)), 0);
+		add(bp, GET_SIZE(HDRP(bp)));
+	    }
+	t = ftimer_now();
+	for (i = 0; i < BATCH; i++)
+	    coalesce(NEXT_BLKP(triple[i]));
+	s_coalesce += ftimer_now() - t;
+	for (i = 0; i < BATCH; i++) {
+	    delete(triple[i]);
+	    bp = triple[i];
+	    set_block(bp, third(), 1);
+	    set_block(NEXT_BLKP(bp), third(), 1);
+	    set_block(NEXT_BLKP(NEXT_BLKP(bp)), target - 2 * third(), 1);
+	}
+
+	for (i = 0; i < BATCH; i++) {
+	    set_block(big[i], target + (2 << cls), 0);
+	    add(big[i], target + (2 << cls));
+	}
+	t = ftimer_now();
+	for (i = 0; i < BATCH; i++)
+	    place(big[i], 2 << cls);
+	s_place += ftimer_now() - t;
+	for (i = 0; i < BATCH; i++) {
+	    delete(big[i]);
+	    set_block(big[i], target + (2 << cls), 1);
+	}
+    }
+
+    res->add = ns(s_add);
+    res->delete = ns(s_delete);
+    res->place = ns(s_place);
+    res->coalesce = ns(s_coalesce);
+}
+
+static void print_row(char *label, result_t *r)
+{
+    printf("%8s %8.1f %8.1f %8.1f %8.1f\n", label,
+	   r->add, r->delete, r->place, r->coalesce);
+}
+
+int main(int argc, char **argv)
+{
+    static char *mixes[2] = {"same", "spread"};
+    result_t first = {0}, res;
+    int c, n, spread, maxlen = 4096;
+    char label[16];
+
+    while ((c = getopt(argc, argv, "r:l:k:h")) != EOF) {
+	switch (c) {
+	case 'r': /* Batches per primitive */
+	    rounds = atoi(optarg);
+	    break;
+	case 'l': /* Longest list */
+	    maxlen = atoi(optarg);
+	    break;
+	case 'k': /* Size class of the list */
+	    cls = atoi(optarg);
+	    break;
+	case 'h':
+	    usage();
+	    exit(0);
+	default:
+	    usage();
+	    exit(1);
+	}
+    }
+    if (rounds < 1 || maxlen < 1 || cls < 7 || cls > MAXNUMBER - 3) {
+	usage();
+	exit(1);
+    }
+
+    mem_init();
+    for (spread = 0; spread < 2; spread++) {
+	printf("\n%s sizes, class %d (%d-%d bytes), ns per call\n",
+	       mixes[spread], cls, 1 << cls, (1 << (cls + 1)) - 1);
+	printf("%8s %8s %8s %8s %8s\n", "L", "add", "delete", "place",
+	       "coalesce");
+	for (n = 1; n <= maxlen; n *= 2) {
+	    build(n, spread);
+	    run(&res);
+	    if (n == 1)
+		first = res;
+	    sprintf(label, "%d", n);
+	    print_row(label, &res);
+	}
+	res.add /= first.add;
+	res.delete /= first.delete;
+	res.place /= first.place;
+	res.coalesce /= first.coalesce;
+	print_row("growth", &res);
+    }
+    mem_deinit();
+    exit(0);
+}
+
+/*
+ * usage - Explain the command line arguments
+ */
+static void usage(void)
+{
+    fprintf(stderr, "Usage: mmbench [-h] [-r <rounds>] [-l <maxlen>] [-k <class>]\n");
+    fprintf(stderr, "Options\n");
+    fprintf(stderr, "\t-r <rounds> Batches of %d calls timed per primitive (2000).\n", BATCH);
+    fprintf(stderr, "\t-l <maxlen> Longest free list, in blocks (4096).\n");
+    fprintf(stderr, "\t-k <class>  Size class of the list, 7 to %d (9).\n", MAXNUMBER - 3);
+    fprintf(stderr, "\t-h          Print this message.\n");
+}
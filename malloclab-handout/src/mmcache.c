@@ -0,0 +1,252 @@
+/*
+ * mmcache.c - slab caches of constructed objects
+ *
+ * A slab is one mm_malloc block of at least 4 KB and 8 objects; it
+ * starts with a slab_t and the objects follow. Each object has a word
+ * after it, so that the cache's bookkeeping never overwrites what ctor
+ * set up: while the object is free the word links it to the next free
+ * object in the slab, and while it is allocated it points to the slab,
+ * which is how mm_cache_free finds the slab. Slabs come from mm_malloc
+ * rather than mem_sbrk because mm.c owns the top of the heap, and from
+ * mm_memalign only for alignments beyond mm_malloc's; aligning them to
+ * their size to find them from the object's address would cost
+ * mm_memalign's slack on every slab.
+ *
+ * Slabs with both free and allocated objects are on the cache's
+ * partial list and objects are taken from the first of them. Full
+ * slabs are on no list. A slab whose objects are all free is kept
+ * aside as the cache's empty slab, to be used when the partial list
+ * runs out, so churn across a slab boundary does not make and destroy
+ * a slab every time; a second empty slab is given back at once.
+ */
+#include <stdlib.h>
+
+#include "mm.h"
+#include "mmcache.h"
+
+#define SLAB_MIN     4096                  /* fewest bytes in a slab */
+#define SLAB_OBJS    8                     /* fewest objects in a slab */
+#define CACHE_ALIGN  (2 * sizeof(void *))  /* as mm_malloc aligns */
+
+/* rounds x up to a multiple of a, a power of 2 */
+#define ROUND(x, a) (((x) + ((a) - 1)) & ~((a) - 1))
+
+/* The word after an object: the next free object, or the object's slab */
+#define LINK(c, obj) (*(void **)((char *)(obj) + (c)->size))
+
+typedef struct slab {
+    struct slab *next;   /* on the partial list */
+    struct slab *prev;
+    void *free;          /* first free object, NULL if full */
+    size_t in_use;       /* objects allocated */
+} slab_t;
+
+struct mm_cache {
+    size_t size;         /* object bytes, rounded to the alignment */
+    size_t align;        /* alignment of the objects */
+    size_t stride;       /* bytes from one object to the next */
+    size_t offset;       /* bytes from a slab to its first object */
+    size_t slab_bytes;   /* bytes in a slab */
+    void (*ctor)(void *obj);
+    void (*dtor)(void *obj);
+    slab_t *partial;     /* slabs with free and allocated objects */
+    slab_t *empty;       /* a slab with no objects allocated, or NULL */
+    mm_cache_stats_t st;
+};
+
+/*
+ * slab_make - a new slab of constructed free objects, or NULL
+ */
+static slab_t *slab_make(mm_cache_t *c)
+{
+    slab_t *s;
+    char *obj;
+    size_t i;
+
+    if (c->align > CACHE_ALIGN)
+	s = mm_memalign(c->align, c->slab_bytes);
+    else
+	s = mm_malloc(c->slab_bytes);
+    if (s == NULL)
+	return NULL;
+    s->next = s->prev = NULL;
+    s->free = NULL;
+    s->in_use = 0;
+
+    /* Last object first, so the free list runs in address order */
+    obj = (char *)s + c->offset + (c->st.per_slab - 1) * c->stride;
+    for (i = 0; i < c->st.per_slab; i++, obj -= c->stride) {
+	if (c->ctor != NULL)
+	    c->ctor(obj);
+	LINK(c, obj) = s->free;
+	s->free = obj;
+    }
+
+    c->st.slabs_made++;
+    c->st.slabs++;
+    if (c->ctor != NULL)
+	c->st.ctors += c->st.per_slab;
+    return s;
+}
+
+/*
+ * slab_free - destroy the objects of a slab with none in use and give
+ *     the slab back
+ */
+static void slab_free(mm_cache_t *c, slab_t *s)
+{
+    void *obj;
+
+    if (c->dtor != NULL)
+	for (obj = s->free; obj != NULL; obj = LINK(c, obj)) {
+	    c->dtor(obj);
+	    c->st.dtors++;
+	}
+    c->st.slabs_freed++;
+    c->st.slabs--;
+    mm_free(s);
+}
+
+static void partial_push(mm_cache_t *c, slab_t *s)
+{
+    s->prev = NULL;
+    s->next = c->partial;
+    if (c->partial != NULL)
+	c->partial->prev = s;
+    c->partial = s;
+}
+
+static void partial_remove(mm_cache_t *c, slab_t *s)
+{
+    if (s->prev != NULL)
+	s->prev->next = s->next;
+    else
+	c->partial = s->next;
+    if (s->next != NULL)
+	s->next->prev = s->prev;
+}
+
+/*
+ * mm_cache_create - an empty cache of objects of size bytes
+ */
+mm_cache_t *mm_cache_create(const char *name, size_t size, size_t align,
+			    void (*ctor)(void *obj), void (*dtor)(void *obj))
+{
+    mm_cache_t *c;
+    size_t slab_bytes;
+
+    if (align == 0)
+	align = CACHE_ALIGN;
+    if (align < sizeof(void *))
+	align = sizeof(void *);
+    if ((align & (align - 1)) != 0 || size == 0 || size > (size_t)-1 / 64)
+	return NULL;
+
+    if ((c = mm_malloc(sizeof(mm_cache_t))) == NULL)
+	return NULL;
+    c->size = ROUND(size, align);
+    c->align = align;
+    c->stride = ROUND(c->size + sizeof(void *), align);
+    c->offset = ROUND(sizeof(slab_t), align);
+    for (slab_bytes = SLAB_MIN;
+	 slab_bytes < c->offset + SLAB_OBJS * c->stride; slab_bytes *= 2)
+	;
+    c->slab_bytes = slab_bytes;
+    c->ctor = ctor;
+    c->dtor = dtor;
+    c->partial = c->empty = NULL;
+
+    c->st = (mm_cache_stats_t){0};
+    c->st.name = name;
+    c->st.size = size;
+    c->st.per_slab = (slab_bytes - c->offset) / c->stride;
+    c->st.slab_bytes = slab_bytes;
+    return c;
+}
+
+/*
+ * mm_cache_alloc - a constructed object, or NULL
+ */
+void *mm_cache_alloc(mm_cache_t *c)
+{
+    slab_t *s = c->partial;
+    void *obj;
+
+    if (s == NULL) {
+	if (c->empty != NULL) {
+	    s = c->empty;
+	    c->empty = NULL;
+	}
+	else if ((s = slab_make(c)) == NULL)
+	    return NULL;
+	partial_push(c, s);
+    }
+
+    obj = s->free;
+    s->free = LINK(c, obj);
+    LINK(c, obj) = s;
+    s->in_use++;
+    if (s->free == NULL)
+	partial_remove(c, s);
+
+    c->st.allocs++;
+    c->st.in_use++;
+    return obj;
+}
+
+/*
+ * mm_cache_free - give back an object, in its constructed state
+ */
+void mm_cache_free(mm_cache_t *c, void *obj)
+{
+    slab_t *s = LINK(c, obj);
+
+    if (s->free == NULL)
+	partial_push(c, s);
+    LINK(c, obj) = s->free;
+    s->free = obj;
+    c->st.frees++;
+    c->st.in_use--;
+
+    if (--s->in_use > 0)
+	return;
+    partial_remove(c, s);
+    if (c->empty == NULL)
+	c->empty = s;
+    else
+	slab_free(c, s);
+}
+
+/*
+ * mm_cache_reap - give back the slabs with no objects in use
+ */
+void mm_cache_reap(mm_cache_t *c)
+{
+    if (c->empty != NULL) {
+	slab_free(c, c->empty);
+	c->empty = NULL;
+    }
+}
+
+/*
+ * mm_cache_destroy - give back every slab and the cache
+ */
+void mm_cache_destroy(mm_cache_t *c)
+{
+    mm_cache_reap(c);
+    while (c->partial != NULL) {
+	slab_t *s = c->partial;
+
+	partial_remove(c, s);
+	slab_free(c, s);
+    }
+    mm_free(c);
+}
+
+/*
+ * mm_cache_stats - copy out what the cache has done so far
+ */
+void mm_cache_stats(mm_cache_t *c, mm_cache_stats_t *st)
+{
+    *st = c->st;
+}
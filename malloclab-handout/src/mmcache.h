@@ -0,0 +1,50 @@
+#ifndef __MMCACHE_H_
+#define __MMCACHE_H_
+
+/*
+ * mmcache.h - object caches on top of mm.c, after Bonwick's slab
+ * allocator
+ *
+ * A cache hands out objects of one size from slabs it gets from mm.c,
+ * and keeps them constructed while they are free: ctor runs once on
+ * each object when its slab is made, and dtor once when the slab is
+ * given back, not on every alloc and free. Objects must therefore be
+ * freed in their constructed state (locks unlocked, lists empty, ...).
+ * ctor and dtor may be NULL.
+ *
+ * align is a power of 2 (0 for mm_malloc's alignment). Objects are
+ * freed with mm_cache_free to the cache they came from, never with
+ * mm_free. mm_cache_reap gives back the slabs with no objects in use;
+ * mm_cache_destroy gives back all of them and the cache, and every
+ * object must have been freed first. Creating a cache or a slab
+ * returns NULL when mm.c does.
+ */
+#include <stddef.h>
+
+typedef struct mm_cache mm_cache_t;
+
+/* What a cache has done so far, from mm_cache_stats */
+typedef struct {
+    const char *name;
+    size_t size;                      /* object bytes */
+    size_t per_slab;                  /* objects in a slab */
+    size_t slab_bytes;                /* bytes in a slab */
+    size_t slabs;                     /* slabs now */
+    size_t in_use;                    /* objects now allocated */
+    unsigned long long allocs;        /* calls to mm_cache_alloc */
+    unsigned long long frees;         /* calls to mm_cache_free */
+    unsigned long long slabs_made;    /* slabs taken from mm.c */
+    unsigned long long slabs_freed;   /* slabs given back */
+    unsigned long long ctors;         /* objects constructed */
+    unsigned long long dtors;         /* objects destroyed */
+} mm_cache_stats_t;
+
+mm_cache_t *mm_cache_create(const char *name, size_t size, size_t align,
+			    void (*ctor)(void *obj), void (*dtor)(void *obj));
+void *mm_cache_alloc(mm_cache_t *c);
+void mm_cache_free(mm_cache_t *c, void *obj);
+void mm_cache_reap(mm_cache_t *c);
+void mm_cache_destroy(mm_cache_t *c);
+void mm_cache_stats(mm_cache_t *c, mm_cache_stats_t *st);
+
+#endif /* __MMCACHE_H_ */
@@ -0,0 +1,548 @@
+/*
+ * mmmag.c - magazines and depots in front of mm.c
+ *
+ * A magazine is an mm_malloc block holding up to MAG_ROUNDS pointers
+ * to free blocks of one class. Class c holds blocks with between
+ * (c+1) and (c+2) MAG_ALIGN-byte units of usable space, so mm_mag_free
+ * finds the class of a block from mm_usable_size alone; which class a
+ * request is served from is worked out once, in mm_mag_init, by asking
+ * mm.c what usable size it gives each request size. A thread's two
+ * magazines of a class are always one of them full or empty when it
+ * goes to the depot (the previous one is only ever one the thread
+ * swapped out because it was full or empty), so the depot only keeps
+ * full and empty magazines, on two lists.
+ *
+ * With MM_MAG_REMOTE, each thread that fills magazines from mm.c also
+ * gets an owner slot, with a queue per class of blocks freed by other
+ * threads, and a byte map over the heap records which slot last filled
+ * a magazine from each page. mm_mag_free pushes a block on a page
+ * owned by another live slot onto that slot's queue with a CAS,
+ * linking it through its first word. When the owner's magazines of
+ * the class run dry, it swaps the whole queue out in one atomic
+ * exchange and allocates from the list it got (its stash) before it
+ * goes to the depot, so blocks that go round a producer/consumer
+ * pipeline never pass through a depot. Since there is only one taker
+ * and it always takes everything, the queue needs no ABA protection.
+ * The map is only a hint: any thread may keep any block, so a page
+ * shared by two threads' fills costs nothing but a trip through a
+ * queue. A thread's slot is given up when it flushes its magazines;
+ * a block pushed onto it after that waits for the next thread to take
+ * the slot, or for mm_mag_reap.
+ *
+ * The depot lock of a class and the heap lock are taken one at a
+ * time, except in mm_mag_reap, which takes the heap lock under a depot
+ * lock or the owners lock; nothing takes either under the heap lock.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "mm.h"
+#include "mmmag.h"
+#include "memlib.h"
+#include "config.h"
+
+#define MAG_ROUNDS   32                    /* blocks in a full magazine */
+#define MAG_CLASSES  32                    /* size classes with magazines */
+#define MAG_ALIGN    (2 * sizeof(void *))  /* as mm_malloc aligns */
+#define MAG_NONE     0xff                  /* no class: straight to mm.c */
+#define MAG_OWNERS   256                   /* owner slots, 0 meaning none */
+#define MAG_PAGE_SHIFT 12                  /* pages of the owner map */
+
+typedef struct mag {
+    struct mag *next;    /* on a depot list */
+    size_t rounds;       /* blocks in objs[0..rounds-1] */
+    void *objs[MAG_ROUNDS];
+} mag_t;
+
+/* A thread's magazines of one class; NULL until it first needs them */
+typedef struct {
+    mag_t *loaded;
+    mag_t *prev;         /* full or empty */
+    void *stash;         /* blocks taken off our queue, linked */
+} mag_pair_t;
+
+typedef struct {
+    pthread_mutex_t lock;
+    mag_t *full;
+    mag_t *empty;
+    mm_mag_stats_t st;   /* magazines is kept in mags_made instead */
+} depot_t;
+
+/* An owner slot, aligned so that no two share a cache line */
+typedef struct {
+    void *remote[MAG_CLASSES];    /* blocks other threads freed, per class */
+    int used;                     /* a thread has the slot */
+    unsigned long long drained;   /* blocks allocated off the queues */
+} __attribute__((aligned(64))) owner_t;
+
+static depot_t depots[MAG_CLASSES];
+static int depots_made;                        /* their locks set up */
+static size_t class_size[MAG_CLASSES];         /* bytes to fill with, or 0 */
+static unsigned char class_of[MAG_CLASSES];    /* by request units */
+static pthread_mutex_t heap_lock = PTHREAD_MUTEX_INITIALIZER;
+static unsigned long long mags_made;           /* under heap_lock */
+static int remote;                             /* MM_MAG_REMOTE */
+static owner_t owners[MAG_OWNERS];
+static pthread_mutex_t owners_lock = PTHREAD_MUTEX_INITIALIZER;
+static unsigned char *owner_map;               /* per heap page: a slot */
+static char *heap_lo;
+
+/* the owner map entry of the page ptr is on */
+#define OWNER(ptr) owner_map[((char *)(ptr) - heap_lo) >> MAG_PAGE_SHIFT]
+
+static __thread mag_pair_t mags[MAG_CLASSES];
+static __thread int registered;                /* mag_key set for us */
+static __thread int self;                      /* our owner slot, or 0 */
+static __thread int ownerless;                 /* no slot was free */
+static pthread_key_t mag_key;
+static pthread_once_t mag_once = PTHREAD_ONCE_INIT;
+
+static void mag_exit(void *arg)
+{
+    mm_mag_flush();
+}
+
+static void mag_key_make(void)
+{
+    pthread_key_create(&mag_key, mag_exit);
+}
+
+/*
+ * mag_register - make sure this thread flushes its magazines when it
+ *     exits, and with remote frees that it has an owner slot; called
+ *     before it first takes a magazine
+ */
+static void mag_register(void)
+{
+    int i;
+
+    if (!registered) {
+	pthread_once(&mag_once, mag_key_make);
+	pthread_setspecific(mag_key, &registered);
+	registered = 1;
+    }
+    if (!remote || self != 0 || ownerless)
+	return;
+    pthread_mutex_lock(&owners_lock);
+    for (i = 1; i < MAG_OWNERS && owners[i].used; i++)
+	;
+    if (i < MAG_OWNERS) {
+	__atomic_store_n(&owners[i].used, 1, __ATOMIC_RELAXED);
+	self = i;
+    }
+    else
+	ownerless = 1;
+    pthread_mutex_unlock(&owners_lock);
+}
+
+/* heap_free - give a block straight back to mm.c */
+static void heap_free(void *ptr)
+{
+    pthread_mutex_lock(&heap_lock);
+    mm_free(ptr);
+    pthread_mutex_unlock(&heap_lock);
+}
+
+/* mag_make - an empty magazine, or NULL */
+static mag_t *mag_make(void)
+{
+    mag_t *m;
+
+    pthread_mutex_lock(&heap_lock);
+    if ((m = mm_malloc(sizeof(mag_t))) != NULL) {
+	m->rounds = 0;
+	mags_made++;
+    }
+    pthread_mutex_unlock(&heap_lock);
+    return m;
+}
+
+/*
+ * mm_mag_init - an empty heap with empty depots; returns -1 if
+ *     mm_init fails
+ */
+int mm_mag_init(int flags)
+{
+    size_t r, c, u;
+    void *p;
+
+    if (mm_init() < 0)
+	return -1;
+
+    remote = (flags & MM_MAG_REMOTE) != 0;
+    if (remote) {
+	if (owner_map == NULL &&
+	    (owner_map = malloc(MAX_HEAP >> MAG_PAGE_SHIFT)) == NULL)
+	    return -1;
+	memset(owner_map, 0, MAX_HEAP >> MAG_PAGE_SHIFT);
+	heap_lo = mem_heap_lo();
+    }
+    for (c = 0; c < MAG_OWNERS; c++) {
+	memset(owners[c].remote, 0, sizeof(owners[c].remote));
+	owners[c].used = 0;
+	owners[c].drained = 0;
+    }
+
+    /* Serve request r from the class of the block mm.c would give it */
+    memset(class_size, 0, sizeof(class_size));
+    for (r = 0; r < MAG_CLASSES; r++) {
+	if ((p = mm_malloc((r + 1) * MAG_ALIGN)) == NULL)
+	    return -1;
+	u = mm_usable_size(p);
+	mm_free(p);
+	c = u / MAG_ALIGN - 1;
+	if (c >= MAG_CLASSES) {
+	    class_of[r] = MAG_NONE;
+	    continue;
+	}
+	class_of[r] = c;
+	class_size[c] = (r + 1) * MAG_ALIGN;
+    }
+
+    /* The old heap, and any magazines in it, are gone */
+    for (c = 0; c < MAG_CLASSES; c++) {
+	if (!depots_made)
+	    pthread_mutex_init(&depots[c].lock, NULL);
+	depots[c].full = depots[c].empty = NULL;
+	memset(&depots[c].st, 0, sizeof(mm_mag_stats_t));
+    }
+    depots_made = 1;
+    mags_made = 0;
+    return 0;
+}
+
+/*
+ * free_list - give a list of blocks linked through their first words
+ *     back to mm.c; called under heap_lock
+ */
+static void free_list(void *ptr)
+{
+    void *next;
+
+    for (; ptr != NULL; ptr = next) {
+	next = *(void **)ptr;
+	mm_free(ptr);
+    }
+}
+
+/* remote_push - put ptr on a queue */
+static void remote_push(void **queue, void *ptr)
+{
+    void *head = __atomic_load_n(queue, __ATOMIC_RELAXED);
+
+    do
+	*(void **)ptr = head;
+    while (!__atomic_compare_exchange_n(queue, &head, ptr, 1,
+					__ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+/*
+ * mag_alloc - a block of class c once the loaded magazine is empty
+ */
+static void *mag_alloc(size_t c)
+{
+    mag_pair_t *t = &mags[c];
+    depot_t *d = &depots[c];
+    owner_t *o = &owners[self];
+    mag_t *m;
+    void *p;
+    size_t i;
+
+    /* Blocks other threads gave back to us come first */
+    if (self != 0) {
+	if (t->stash == NULL &&
+	    __atomic_load_n(&o->remote[c], __ATOMIC_RELAXED) != NULL)
+	    t->stash = __atomic_exchange_n(&o->remote[c], NULL,
+					   __ATOMIC_ACQUIRE);
+	if ((p = t->stash) != NULL) {
+	    t->stash = *(void **)p;
+	    __atomic_store_n(&o->drained, o->drained + 1, __ATOMIC_RELAXED);
+	    return p;
+	}
+    }
+    if (t->prev != NULL && t->prev->rounds == MAG_ROUNDS) {
+	m = t->prev;
+	t->prev = t->loaded;
+	t->loaded = m;
+	return m->objs[--m->rounds];
+    }
+
+    /* Trade the empty previous magazine for a full one */
+    mag_register();
+    pthread_mutex_lock(&d->lock);
+    if ((m = d->full) != NULL) {
+	d->full = m->next;
+	if (t->prev != NULL) {
+	    t->prev->next = d->empty;
+	    d->empty = t->prev;
+	}
+	d->st.full_out++;
+	pthread_mutex_unlock(&d->lock);
+	t->prev = t->loaded;
+	t->loaded = m;
+	return m->objs[--m->rounds];
+    }
+
+    /* None in the depot: fill the loaded one from mm.c */
+    if ((m = t->loaded) == NULL && (m = d->empty) != NULL)
+	d->empty = m->next;
+    d->st.fills++;
+    pthread_mutex_unlock(&d->lock);
+    if (m == NULL && (m = mag_make()) == NULL)
+	return NULL;
+    t->loaded = m;
+    pthread_mutex_lock(&heap_lock);
+    m->rounds = mm_malloc_batch(class_size[c], MAG_ROUNDS, m->objs);
+    pthread_mutex_unlock(&heap_lock);
+    if (self != 0)
+	for (i = 0; i < m->rounds; i++)
+	    __atomic_store_n(&OWNER(m->objs[i]), self, __ATOMIC_RELAXED);
+    if (m->rounds == 0)
+	return NULL;
+    return m->objs[--m->rounds];
+}
+
+/*
+ * mag_free - free a block of class c once the loaded magazine is full
+ */
+static void mag_free(size_t c, void *ptr)
+{
+    mag_pair_t *t = &mags[c];
+    depot_t *d = &depots[c];
+    mag_t *m;
+
+    if (t->prev != NULL && t->prev->rounds == 0) {
+	m = t->prev;
+	t->prev = t->loaded;
+	t->loaded = m;
+	m->objs[m->rounds++] = ptr;
+	return;
+    }
+
+    /* Trade the full previous magazine for an empty one */
+    mag_register();
+    pthread_mutex_lock(&d->lock);
+    if (t->prev != NULL) {
+	t->prev->next = d->full;
+	d->full = t->prev;
+	d->st.full_in++;
+    }
+    if ((m = d->empty) != NULL)
+	d->empty = m->next;
+    pthread_mutex_unlock(&d->lock);
+    t->prev = t->loaded;
+    if (m == NULL && (m = mag_make()) == NULL) {
+	t->loaded = NULL;
+	heap_free(ptr);
+	return;
+    }
+    t->loaded = m;
+    m->objs[m->rounds++] = ptr;
+}
+
+/*
+ * mm_mag_malloc - a block of size bytes, from a magazine if it is small
+ */
+void *mm_mag_malloc(size_t size)
+{
+    size_t r = (size - 1) / MAG_ALIGN, c;
+    mag_t *m;
+    void *p;
+
+    if (size == 0 || r >= MAG_CLASSES || (c = class_of[r]) == MAG_NONE) {
+	pthread_mutex_lock(&heap_lock);
+	p = mm_malloc(size);
+	pthread_mutex_unlock(&heap_lock);
+	return p;
+    }
+    m = mags[c].loaded;
+    if (m != NULL && m->rounds > 0)
+	return m->objs[--m->rounds];
+    return mag_alloc(c);
+}
+
+/*
+ * mm_mag_free - free a block, to a magazine if it is small
+ */
+void mm_mag_free(void *ptr)
+{
+    size_t c;
+    mag_t *m;
+    int o;
+
+    if (ptr == NULL)
+	return;
+    /* Only this thread can be using the block, so its header is ours */
+    c = mm_usable_size(ptr) / MAG_ALIGN - 1;
+    if (c >= MAG_CLASSES || class_size[c] == 0) {
+	heap_free(ptr);
+	return;
+    }
+    if (remote) {
+	o = __atomic_load_n(&OWNER(ptr), __ATOMIC_RELAXED);
+	if (o != self && o != 0 &&
+	    __atomic_load_n(&owners[o].used, __ATOMIC_RELAXED)) {
+	    remote_push(&owners[o].remote[c], ptr);
+	    return;
+	}
+    }
+    m = mags[c].loaded;
+    if (m != NULL && m->rounds < MAG_ROUNDS) {
+	m->objs[m->rounds++] = ptr;
+	return;
+    }
+    mag_free(c, ptr);
+}
+
+void *mm_mag_calloc(size_t n, size_t size)
+{
+    void *p;
+
+    if (size != 0 && n > (size_t)-1 / size)
+	return NULL;
+    if ((p = mm_mag_malloc(n * size)) != NULL)
+	memset(p, 0, n * size);
+    return p;
+}
+
+void *mm_mag_realloc(void *ptr, size_t size)
+{
+    void *p;
+
+    pthread_mutex_lock(&heap_lock);
+    p = mm_realloc(ptr, size);
+    pthread_mutex_unlock(&heap_lock);
+    return p;
+}
+
+void *mm_mag_aligned_alloc(size_t align, size_t size)
+{
+    void *p;
+
+    pthread_mutex_lock(&heap_lock);
+    p = mm_aligned_alloc(align, size);
+    pthread_mutex_unlock(&heap_lock);
+    return p;
+}
+
+/*
+ * mag_return - put a magazine of this thread's in the depot, giving
+ *     its blocks back to mm.c first unless it is full
+ */
+static void mag_return(depot_t *d, mag_t *m)
+{
+    if (m == NULL)
+	return;
+    if (m->rounds > 0 && m->rounds < MAG_ROUNDS) {
+	pthread_mutex_lock(&heap_lock);
+	mm_free_batch(m->objs, m->rounds);
+	pthread_mutex_unlock(&heap_lock);
+	m->rounds = 0;
+    }
+    pthread_mutex_lock(&d->lock);
+    if (m->rounds == MAG_ROUNDS) {
+	m->next = d->full;
+	d->full = m;
+	d->st.full_in++;
+    }
+    else {
+	m->next = d->empty;
+	d->empty = m;
+    }
+    pthread_mutex_unlock(&d->lock);
+}
+
+/*
+ * mm_mag_flush - give up this thread's owner slot and put all of its
+ *     magazines in the depots
+ */
+void mm_mag_flush(void)
+{
+    size_t c;
+
+    if (self != 0) {
+	pthread_mutex_lock(&owners_lock);
+	__atomic_store_n(&owners[self].used, 0, __ATOMIC_RELAXED);
+	pthread_mutex_unlock(&owners_lock);
+	pthread_mutex_lock(&heap_lock);
+	for (c = 0; c < MAG_CLASSES; c++) {
+	    free_list(__atomic_exchange_n(&owners[self].remote[c], NULL,
+					  __ATOMIC_ACQUIRE));
+	    free_list(mags[c].stash);
+	    mags[c].stash = NULL;
+	}
+	pthread_mutex_unlock(&heap_lock);
+	self = 0;
+    }
+    ownerless = 0;
+    for (c = 0; c < MAG_CLASSES; c++) {
+	mag_return(&depots[c], mags[c].loaded);
+	mag_return(&depots[c], mags[c].prev);
+	mags[c].loaded = mags[c].prev = NULL;
+    }
+}
+
+/*
+ * mm_mag_reap - give the blocks and magazines in the depots, and the
+ *     blocks left on the queues of unused owner slots, back to mm.c
+ */
+void mm_mag_reap(void)
+{
+    depot_t *d;
+    mag_t *m, *next;
+    size_t c, i;
+
+    pthread_mutex_lock(&owners_lock);
+    pthread_mutex_lock(&heap_lock);
+    for (i = 1; i < MAG_OWNERS; i++)
+	if (!owners[i].used)
+	    for (c = 0; c < MAG_CLASSES; c++)
+		free_list(__atomic_exchange_n(&owners[i].remote[c], NULL,
+					      __ATOMIC_ACQUIRE));
+    pthread_mutex_unlock(&heap_lock);
+    pthread_mutex_unlock(&owners_lock);
+
+    for (c = 0; c < MAG_CLASSES; c++) {
+	d = &depots[c];
+	pthread_mutex_lock(&d->lock);
+	pthread_mutex_lock(&heap_lock);
+	for (m = d->full; m != NULL; m = next) {
+	    next = m->next;
+	    mm_free_batch(m->objs, m->rounds);
+	    mm_free(m);
+	}
+	for (m = d->empty; m != NULL; m = next) {
+	    next = m->next;
+	    mm_free(m);
+	}
+	pthread_mutex_unlock(&heap_lock);
+	d->full = d->empty = NULL;
+	pthread_mutex_unlock(&d->lock);
+    }
+}
+
+/*
+ * mm_mag_stats - add up what the depots have done so far
+ */
+void mm_mag_stats(mm_mag_stats_t *st)
+{
+    depot_t *d;
+    size_t c;
+
+    memset(st, 0, sizeof(mm_mag_stats_t));
+    for (c = 0; c < MAG_CLASSES; c++) {
+	d = &depots[c];
+	pthread_mutex_lock(&d->lock);
+	st->fills += d->st.fills;
+	st->full_out += d->st.full_out;
+	st->full_in += d->st.full_in;
+	pthread_mutex_unlock(&d->lock);
+    }
+    pthread_mutex_lock(&heap_lock);
+    st->magazines = mags_made;
+    pthread_mutex_unlock(&heap_lock);
+    for (c = 1; c < MAG_OWNERS; c++)
+	st->remote_frees += __atomic_load_n(&owners[c].drained,
+					    __ATOMIC_RELAXED);
+}
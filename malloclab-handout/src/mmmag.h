@@ -0,0 +1,58 @@
+#ifndef __MMMAG_H_
+#define __MMMAG_H_
+
+/*
+ * mmmag.h - a thread-safe malloc on top of mm.c, with magazines in
+ * front of its small size classes, after Bonwick and Adams
+ *
+ * mm.c is not thread safe, so every call into it is made under one
+ * heap lock. Small blocks mostly never get that far: each thread keeps
+ * two magazines (stacks of free blocks) per size class, a loaded one
+ * and the previous one, and allocates from and frees to them without
+ * any lock. Only when both are empty (or both full) does it go to the
+ * class's depot, a lock-protected store of full and empty magazines,
+ * and swap a magazine it has for one it needs; when the depot has no
+ * full magazine to give, it fills one from mm.c's free lists with
+ * mm_malloc_batch. Blocks larger than the biggest class go to mm.c,
+ * under the heap lock, at every call.
+ *
+ * With MM_MAG_REMOTE in mm_mag_init's flags, a block freed by another
+ * thread than the one that took it from mm.c goes back to that thread
+ * instead, through a lock-free queue the owner takes in one go, and
+ * allocates from, the next time its magazines run out, so that in a
+ * producer/consumer pipeline the producer gets its blocks back without
+ * going through the depot.
+ *
+ * mm_mag_init runs mm_init and sets up the classes, and must be
+ * called before any other thread uses the package, and again only
+ * once every thread has flushed its magazines. A thread's magazines
+ * go back to the depots when it exits, or when it calls mm_mag_flush
+ * (so the thread that calls mm_mag_init must flush itself first).
+ * mm_mag_reap gives the blocks and magazines in the depots back to
+ * mm.c. Blocks from mm_mag_* must be freed with mm_mag_free, never
+ * with mm_free.
+ */
+#include <stddef.h>
+
+/* What the depots have done since mm_mag_init, from mm_mag_stats */
+typedef struct {
+    unsigned long long fills;         /* magazines filled from mm.c */
+    unsigned long long full_out;      /* full magazines given to threads */
+    unsigned long long full_in;       /* full magazines taken back */
+    unsigned long long magazines;     /* magazines taken from mm.c */
+    unsigned long long remote_frees;  /* blocks reused off the queues */
+} mm_mag_stats_t;
+
+#define MM_MAG_REMOTE 1   /* mm_mag_init: return blocks to their owners */
+
+int mm_mag_init(int flags);
+void *mm_mag_malloc(size_t size);
+void *mm_mag_calloc(size_t n, size_t size);
+void *mm_mag_realloc(void *ptr, size_t size);
+void *mm_mag_aligned_alloc(size_t align, size_t size);
+void mm_mag_free(void *ptr);
+void mm_mag_flush(void);
+void mm_mag_reap(void);
+void mm_mag_stats(mm_mag_stats_t *st);
+
+#endif /* __MMMAG_H_ */
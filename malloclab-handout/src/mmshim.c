@@ -0,0 +1,262 @@
+/*
+ * mmshim.c - LD_PRELOAD library that runs a program on mm.c
+ *
+ *     unix> LD_PRELOAD=./libmmshim.so app ...
+ *
+ * malloc, free, calloc, realloc, the memalign family and
+ * malloc_usable_size are replaced by wrappers around mm_malloc,
+ * mm_free, mm_calloc, mm_realloc, mm_memalign and mm_usable_size, so
+ * real programs can be timed and measured on the same allocator the
+ * driver tests. The heap comes from memlib, built here with a MAX_HEAP
+ * of a gigabyte or more; since memlib only maps its heap, untouched
+ * address space costs nothing.
+ *
+ * mm.c is not thread safe, so every call runs under one lock. The lock
+ * is held across fork() and released in both processes afterwards, so
+ * a child never inherits it held by a thread that no longer exists.
+ * The package is initialized by the first call that needs it. Blocks
+ * from the C library's malloc (the loader's, from before the shim was
+ * in place) are never freed, and are moved into mm.c's heap when they
+ * are realloc'ed.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <string.h>
+#include <pthread.h>
+#include <dlfcn.h>
+
+#include "mm.h"
+#include "memlib.h"
+
+#define EXPORT __attribute__((visibility("default")))
+
+static pthread_mutex_t shim_lock = PTHREAD_MUTEX_INITIALIZER;
+static int shim_ready;                 /* mem_init and mm_init have run */
+static int shim_failed;                /* ... and mm_init failed */
+
+/***************************************************
+ * Locking and initialization
+ ***************************************************/
+
+static void shim_prepare(void)
+{
+    pthread_mutex_lock(&shim_lock);
+}
+
+static void shim_parent(void)
+{
+    pthread_mutex_unlock(&shim_lock);
+}
+
+static void shim_child(void)
+{
+    pthread_mutex_init(&shim_lock, NULL);
+}
+
+/*
+ * shim_enter - take the lock, initializing the package on first use.
+ *     Returns -1 (with the lock released) if there is no heap.
+ */
+static int shim_enter(void)
+{
+    int first = 0;
+
+    pthread_mutex_lock(&shim_lock);
+    if (!shim_ready) {
+	mem_init();
+	shim_failed = (mm_init() < 0);
+	shim_ready = 1;
+	first = 1;
+    }
+    if (first) {
+	/* pthread_atfork may itself allocate, so register it unlocked */
+	pthread_mutex_unlock(&shim_lock);
+	pthread_atfork(shim_prepare, shim_parent, shim_child);
+	pthread_mutex_lock(&shim_lock);
+    }
+    if (shim_failed) {
+	pthread_mutex_unlock(&shim_lock);
+	errno = ENOMEM;
+	return -1;
+    }
+    return 0;
+}
+
+static void shim_leave(void)
+{
+    pthread_mutex_unlock(&shim_lock);
+}
+
+/* in_heap - was p handed out by mm.c? */
+static int in_heap(void *p)
+{
+    return shim_ready && (char *)p >= (char *)mem_heap_lo() &&
+	(char *)p <= (char *)mem_heap_hi();
+}
+
+/***************************************************
+ * Helpers (called with the lock held)
+ ***************************************************/
+
+static void *shim_malloc(size_t size)
+{
+    void *p;
+
+    /* mm_malloc(0) returns NULL, which callers would take as failure */
+    if ((p = mm_malloc(size ? size : 1)) == NULL)
+	errno = ENOMEM;
+    return p;
+}
+
+static void *shim_memalign(size_t align, size_t size)
+{
+    void *p;
+
+    if ((p = mm_memalign(align, size ? size : 1)) == NULL)
+	errno = ENOMEM;
+    return p;
+}
+
+/*
+ * foreign_realloc - realloc of a block from the C library's malloc:
+ *     copy it into a new block from mm.c and leave the old one alone
+ */
+static void *foreign_realloc(void *ptr, size_t size)
+{
+    static size_t (*real_usable_size)(void *);
+    size_t old;
+    void *p;
+
+    if (real_usable_size == NULL &&
+	(real_usable_size = dlsym(RTLD_NEXT, "malloc_usable_size")) == NULL) {
+	errno = ENOMEM;
+	return NULL;
+    }
+    if ((p = malloc(size)) == NULL)
+	return NULL;
+    old = real_usable_size(ptr);
+    memcpy(p, ptr, old < size ? old : size);
+    return p;
+}
+
+/***************************************************
+ * The interposed allocator entry points
+ ***************************************************/
+
+EXPORT void *malloc(size_t size)
+{
+    void *p;
+
+    if (shim_enter() < 0)
+	return NULL;
+    p = shim_malloc(size);
+    shim_leave();
+    return p;
+}
+
+EXPORT void free(void *ptr)
+{
+    if (ptr == NULL || !in_heap(ptr))
+	return;   /* not ours (e.g. from the loader before we ran) */
+    pthread_mutex_lock(&shim_lock);
+    mm_free(ptr);
+    shim_leave();
+}
+
+EXPORT void *calloc(size_t n, size_t m)
+{
+    void *p;
+
+    if (shim_enter() < 0)
+	return NULL;
+    /* mm_calloc checks n * m for overflow; an empty block is 1 byte */
+    if (n == 0 || m == 0)
+	n = m = 1;
+    if ((p = mm_calloc(n, m)) == NULL)
+	errno = ENOMEM;
+    shim_leave();
+    return p;
+}
+
+EXPORT void *realloc(void *ptr, size_t size)
+{
+    void *p;
+
+    if (ptr == NULL)
+	return malloc(size);
+    if (!in_heap(ptr))
+	return foreign_realloc(ptr, size);
+    if (size == 0) {
+	free(ptr);
+	return NULL;
+    }
+    if (shim_enter() < 0)
+	return NULL;
+    if ((p = mm_realloc(ptr, size)) == NULL)
+	errno = ENOMEM;
+    shim_leave();
+    return p;
+}
+
+EXPORT int posix_memalign(void **memptr, size_t align, size_t size)
+{
+    void *p;
+
+    if (align == 0 || (align & (align - 1)) != 0 || align % sizeof(void *))
+	return EINVAL;
+    if (shim_enter() < 0)
+	return ENOMEM;
+    p = shim_memalign(align, size);
+    shim_leave();
+    if (p == NULL)
+	return ENOMEM;
+    *memptr = p;
+    return 0;
+}
+
+EXPORT void *memalign(size_t align, size_t size)
+{
+    void *p;
+
+    if (align == 0 || (align & (align - 1)) != 0) {
+	errno = EINVAL;
+	return NULL;
+    }
+    if (shim_enter() < 0)
+	return NULL;
+    p = shim_memalign(align, size);
+    shim_leave();
+    return p;
+}
+
+EXPORT void *aligned_alloc(size_t align, size_t size)
+{
+    return memalign(align, size);
+}
+
+EXPORT void *valloc(size_t size)
+{
+    return memalign(getpagesize(), size);
+}
+
+EXPORT void *pvalloc(size_t size)
+{
+    size_t page = getpagesize();
+
+    return memalign(page, (size + page - 1) & ~(page - 1));
+}
+
+EXPORT size_t malloc_usable_size(void *ptr)
+{
+    size_t n;
+
+    if (ptr == NULL || !in_heap(ptr))
+	return 0;
+    pthread_mutex_lock(&shim_lock);
+    n = mm_usable_size(ptr);
+    shim_leave();
+    return n;
+}
@@ -0,0 +1,687 @@
+/*
+ * mtreplay.c - replay a trace on several threads at once
+ *
+ *     unix> mtreplay [-t maxthreads] [-x frac | -p] [-a alloc] [-qv] trace
+ *
+ * Three ways of spreading a trace over T threads:
+ *
+ *   copies (default)  every thread replays the whole trace on blocks
+ *                     of its own, so T times the work is done
+ *   split (-x frac)   the ops are divided among the threads: the
+ *                     allocs and reallocs of id i go to thread i % T,
+ *                     and a share frac of the frees go to the next
+ *                     thread instead, so those blocks are freed on a
+ *                     different thread from the one that allocated
+ *                     them (producer/consumer)
+ *   pipeline (-p)     the threads are paired off into producers and
+ *                     consumers: producer k allocates the blocks of
+ *                     every (T/2)th alloc op of the trace, from the
+ *                     kth on, writes their first bytes and passes them
+ *                     through a ring to consumer k, which reads the
+ *                     byte and frees them, so every free is made on
+ *                     another thread; reallocs and frees in the trace
+ *                     are skipped
+ *
+ * In split mode the ops on any one id still happen in trace order: a
+ * thread waits, untimed, until the previous op on the id is done. Every
+ * op waits only for an earlier one, so the replay cannot deadlock.
+ * A split spreads the blocks of a batch over the threads, so batch ops
+ * are replayed as plain mallocs and frees, one call each, in both modes.
+ *
+ * The run is repeated with 1, 2, 4, ... threads up to maxthreads (the
+ * number of online CPUs by default; pipelines start at 2 threads and
+ * run even counts only) and reports the aggregate
+ * throughput, the scaling efficiency (throughput over T times the one
+ * thread throughput) and the latency of single calls: the median and
+ * the worst p99, p99.9 and maximum over the threads, or every thread's
+ * figures with -v. Latencies include the cost of reading the clock;
+ * -q skips the per-call timing to measure throughput alone.
+ *
+ * mm.c is not thread safe, so it runs behind one global lock, or
+ * (-a mag) behind the magazines and depots of mmmag.c, which take the
+ * lock only to swap magazines and for large blocks; -a mag-remote
+ * adds mmmag.c's remote-free queues, which send a block freed on one
+ * thread back to the thread that took it from mm.c. libc can run as
+ * it is, or behind the same lock (-a libc-locked) as the baseline a
+ * single-threaded allocator would give.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <sched.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "mm.h"
+#include "mmmag.h"
+#include "memlib.h"
+#include "trace.h"
+
+int verbose = 0;  /* read by the trace module */
+
+#define MAXTHREADS 256
+#define SUBBUCKETS 8                    /* per power of 2 in a histogram */
+#define NBUCKETS   (64 * SUBBUCKETS)
+#define RUNS       3                    /* runs per thread count, best kept */
+#define RING       1024                 /* blocks in a pipeline's ring */
+
+enum {HEAP_LIBC, HEAP_MM, HEAP_MAG, HEAP_MAG_REMOTE};
+
+/* An allocator under test */
+typedef struct {
+    char *name;
+    void *(*malloc)(size_t size);
+    void (*free)(void *ptr);
+    void *(*realloc)(void *ptr, size_t size);
+    void *(*aligned_alloc)(size_t align, size_t size);
+    void *(*calloc)(size_t n, size_t size);
+    int locked;                         /* call it under heap_lock */
+    int heap;                           /* HEAP_*: how to set it up */
+} alloc_t;
+
+static alloc_t allocs[] = {
+    {"mm", mm_malloc, mm_free, mm_realloc, mm_aligned_alloc, mm_calloc, 1,
+     HEAP_MM},
+    {"mag", mm_mag_malloc, mm_mag_free, mm_mag_realloc, mm_mag_aligned_alloc,
+     mm_mag_calloc, 0, HEAP_MAG},
+    {"mag-remote", mm_mag_malloc, mm_mag_free, mm_mag_realloc,
+     mm_mag_aligned_alloc, mm_mag_calloc, 0, HEAP_MAG_REMOTE},
+    {"libc", malloc, free, realloc, aligned_alloc, calloc, 0, HEAP_LIBC},
+    {"libc-locked", malloc, free, realloc, aligned_alloc, calloc, 1,
+     HEAP_LIBC},
+};
+#define NALLOCS (int)(sizeof(allocs) / sizeof(alloc_t))
+
+/* A pipeline's ring of blocks from its producer to its consumer */
+typedef struct {
+    void *slots[RING];
+    unsigned long head __attribute__((aligned(64))); /* pushed, by producer */
+    unsigned long tail __attribute__((aligned(64))); /* popped, by consumer */
+} ring_t;
+
+/* One replay thread */
+typedef struct {
+    pthread_t tid;
+    int *ops;                           /* its ops (split, pipeline) */
+    int nops;
+    ring_t *ring;                       /* pipeline: ring it is on */
+    int producer;                       /* pipeline: pushes to the ring */
+    char **blocks;                      /* live blocks by id (shared if split) */
+    unsigned long long hist[NBUCKETS];  /* call latencies in ns */
+    unsigned long long began, ended;    /* its first and last op, in ns */
+} thread_t;
+
+static trace_t *trace;
+static alloc_t *alloc;
+static int split = 0;                   /* split the trace, don't copy it */
+static int pipeline = 0;                /* producers and consumers */
+static int *alloc_ops;                  /* pipeline: the trace's alloc ops */
+static int nalloc_ops;
+static ring_t *rings;                   /* pipeline: one per pair */
+static double cross = 0;                /* share of frees on another thread */
+static int timing = 1;                  /* time every call */
+static int *seq;                        /* split: op's place among its id's */
+static int *done;                       /* split: ops done so far per id */
+static thread_t threads[MAXTHREADS];
+static pthread_barrier_t start;
+static pthread_mutex_t heap_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* function prototypes */
+static void usage(void);
+static void app_error(char *msg);
+
+static unsigned long long now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/*
+ * bucket - histogram bucket of a latency of v ns: exact below
+ *     SUBBUCKETS, then SUBBUCKETS buckets per power of 2
+ */
+static int bucket(unsigned long long v)
+{
+    int k;
+
+    if (v < SUBBUCKETS)
+	return v;
+    k = 63 - __builtin_clzll(v);
+    return (k - 2) * SUBBUCKETS + ((v >> (k - 3)) & (SUBBUCKETS - 1));
+}
+
+/* bucket_low - smallest latency that falls in bucket b */
+static unsigned long long bucket_low(int b)
+{
+    int k = b / SUBBUCKETS + 2;
+
+    if (b < SUBBUCKETS)
+	return b;
+    return (unsigned long long)(SUBBUCKETS + b % SUBBUCKETS) << (k - 3);
+}
+
+/*
+ * percentile - latency below which a share q of the calls in h fall
+ */
+static unsigned long long percentile(unsigned long long *h, double q)
+{
+    unsigned long long total = 0, cum = 0;
+    int b;
+
+    for (b = 0; b < NBUCKETS; b++)
+	total += h[b];
+    for (b = 0; b < NBUCKETS; b++) {
+	cum += h[b];
+	if (cum > 0 && cum >= q * total)
+	    return bucket_low(b);
+    }
+    return 0;
+}
+
+/*
+ * The allocator calls, under heap_lock if the allocator needs it
+ */
+static void *do_malloc(size_t size)
+{
+    void *p;
+
+    if (!alloc->locked)
+	return alloc->malloc(size);
+    pthread_mutex_lock(&heap_lock);
+    p = alloc->malloc(size);
+    pthread_mutex_unlock(&heap_lock);
+    return p;
+}
+
+static void *do_aligned_alloc(size_t align, size_t size)
+{
+    void *p;
+
+    if (!alloc->locked)
+	return alloc->aligned_alloc(align, size);
+    pthread_mutex_lock(&heap_lock);
+    p = alloc->aligned_alloc(align, size);
+    pthread_mutex_unlock(&heap_lock);
+    return p;
+}
+
+static void *do_calloc(size_t n, size_t size)
+{
+    void *p;
+
+    if (!alloc->locked)
+	return alloc->calloc(n, size);
+    pthread_mutex_lock(&heap_lock);
+    p = alloc->calloc(n, size);
+    pthread_mutex_unlock(&heap_lock);
+    return p;
+}
+
+static void *do_realloc(void *ptr, size_t size)
+{
+    void *p;
+
+    if (!alloc->locked)
+	return alloc->realloc(ptr, size);
+    pthread_mutex_lock(&heap_lock);
+    p = alloc->realloc(ptr, size);
+    pthread_mutex_unlock(&heap_lock);
+    return p;
+}
+
+static void do_free(void *ptr)
+{
+    if (!alloc->locked) {
+	alloc->free(ptr);
+	return;
+    }
+    pthread_mutex_lock(&heap_lock);
+    alloc->free(ptr);
+    pthread_mutex_unlock(&heap_lock);
+}
+
+/*
+ * replay - body of a replay thread
+ */
+static void *replay(void *arg)
+{
+    thread_t *th = (thread_t *)arg;
+    traceop_t *op;
+    unsigned long long t = 0;
+    int k, i, spins;
+    char *p;
+
+    pthread_barrier_wait(&start);
+    th->began = now_ns();
+    for (k = 0; k < th->nops; k++) {
+	i = th->ops ? th->ops[k] : k;
+	op = &trace->ops[i];
+
+	/* Wait for the op before this one on the same id */
+	if (split)
+	    for (spins = 0;
+		 __atomic_load_n(&done[op->index], __ATOMIC_ACQUIRE) != seq[i];
+		 spins++)
+		if (spins % 64 == 63)
+		    sched_yield();
+
+	if (timing)
+	    t = now_ns();
+	switch (op->type) {
+	case ALLOC:
+	case BALLOC:
+	    if ((p = do_malloc(op->size)) == NULL)
+		app_error("malloc failed in replay");
+	    th->blocks[op->index] = p;
+	    break;
+	case MEMALIGN:
+	    if ((p = do_aligned_alloc((size_t)1 << op->lgalign,
+				      op->size)) == NULL)
+		app_error("aligned_alloc failed in replay");
+	    th->blocks[op->index] = p;
+	    break;
+	case CALLOC:
+	    if ((p = do_calloc(1, op->size)) == NULL)
+		app_error("calloc failed in replay");
+	    th->blocks[op->index] = p;
+	    break;
+	case REALLOC:
+	    if ((p = do_realloc(th->blocks[op->index], op->size)) == NULL)
+		app_error("realloc failed in replay");
+	    th->blocks[op->index] = p;
+	    break;
+	default: /* FREE, BFREE */
+	    do_free(th->blocks[op->index]);
+	    th->blocks[op->index] = NULL;
+	    break;
+	}
+	if (timing)
+	    th->hist[bucket(now_ns() - t)]++;
+
+	if (split)
+	    __atomic_store_n(&done[op->index], seq[i] + 1, __ATOMIC_RELEASE);
+    }
+    th->ended = now_ns();
+    return NULL;
+}
+
+/*
+ * pipe_stage - body of a pipeline thread: a producer allocates the
+ *     blocks of its ops and pushes them on its ring, a consumer pops
+ *     as many and frees them
+ */
+static void *pipe_stage(void *arg)
+{
+    thread_t *th = (thread_t *)arg;
+    ring_t *ring = th->ring;
+    traceop_t *op;
+    unsigned long long t = 0;
+    int k, spins;
+    char *p;
+
+    pthread_barrier_wait(&start);
+    th->began = now_ns();
+    for (k = 0; k < th->nops; k++) {
+	if (th->producer) {
+	    op = &trace->ops[th->ops[k]];
+	    if (timing)
+		t = now_ns();
+	    if (op->type == MEMALIGN)
+		p = do_aligned_alloc((size_t)1 << op->lgalign, op->size);
+	    else if (op->type == CALLOC)
+		p = do_calloc(1, op->size);
+	    else
+		p = do_malloc(op->size);
+	    if (timing)
+		th->hist[bucket(now_ns() - t)]++;
+	    if (p == NULL)
+		app_error("allocation failed in pipeline");
+	    *p = 1;
+
+	    /* Wait for room in the ring */
+	    for (spins = 0; ring->head -
+		     __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) == RING;
+		 spins++)
+		if (spins % 64 == 63)
+		    sched_yield();
+	    ring->slots[ring->head % RING] = p;
+	    __atomic_store_n(&ring->head, ring->head + 1, __ATOMIC_RELEASE);
+	}
+	else {
+	    /* Wait for a block in the ring */
+	    for (spins = 0;
+		 __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == ring->tail;
+		 spins++)
+		if (spins % 64 == 63)
+		    sched_yield();
+	    p = ring->slots[ring->tail % RING];
+	    __atomic_store_n(&ring->tail, ring->tail + 1, __ATOMIC_RELEASE);
+	    if (*p != 1)
+		app_error("block changed in pipeline");
+
+	    if (timing)
+		t = now_ns();
+	    do_free(p);
+	    if (timing)
+		th->hist[bucket(now_ns() - t)]++;
+	}
+    }
+    th->ended = now_ns();
+    return NULL;
+}
+
+/*
+ * assign_pipeline - give producer k of n/2 every (n/2)th alloc op from
+ *     the kth on, and consumer k as many blocks to free
+ */
+static void assign_pipeline(int n)
+{
+    int pairs = n / 2, j, k;
+
+    for (k = 0; k < pairs; k++) {
+	threads[k].nops = 0;
+	threads[k].producer = 1;
+	threads[k].ring = &rings[k];
+	rings[k].head = rings[k].tail = 0;
+    }
+    for (j = 0; j < nalloc_ops; j++) {
+	k = j % pairs;
+	threads[k].ops[threads[k].nops++] = alloc_ops[j];
+    }
+    for (k = 0; k < pairs; k++) {
+	threads[pairs + k].nops = threads[k].nops;
+	threads[pairs + k].producer = 0;
+	threads[pairs + k].ring = &rings[k];
+    }
+}
+
+/*
+ * assign - divide the ops among n threads for a split replay
+ */
+static void assign(int n)
+{
+    unsigned long long h;
+    int i, t, index;
+
+    for (t = 0; t < n; t++)
+	threads[t].nops = 0;
+    for (i = 0; i < trace->num_ops; i++) {
+	index = trace->ops[i].index;
+	t = index % n;
+	if (IS_FREE(trace->ops[i].type)) {
+	    /* a fixed pseudo-random share of the frees move on */
+	    h = (i + 1) * 0x9E3779B97F4A7C15ull;
+	    if ((h >> 11) * (1.0 / 9007199254740992.0) < cross)
+		t = (t + 1) % n;
+	}
+	threads[t].ops[threads[t].nops++] = i;
+    }
+}
+
+/*
+ * run - replay with n threads once; returns the wall time in seconds
+ *     from the first thread's first op to the last thread's last op
+ *     (the threads stamp them, since this thread need not be running
+ *     when the others start)
+ */
+static double run(int n)
+{
+    unsigned long long began, ended;
+    int i, k;
+
+    if (alloc->heap != HEAP_LIBC) {
+	mem_reset_brk();
+	if (alloc->heap == HEAP_MM ? mm_init() < 0 :
+	    mm_mag_init(alloc->heap == HEAP_MAG_REMOTE ? MM_MAG_REMOTE : 0) < 0)
+	    app_error("mm_init failed");
+    }
+    if (split) {
+	memset(done, 0, trace->num_ids * sizeof(int));
+	assign(n);
+    }
+    else if (pipeline)
+	assign_pipeline(n);
+    for (k = 0; k < n; k++) {
+	memset(threads[k].hist, 0, sizeof(threads[k].hist));
+	if (!split && !pipeline)
+	    threads[k].nops = trace->num_ops;
+    }
+
+    pthread_barrier_init(&start, NULL, n + 1);
+    for (k = 0; k < n; k++)
+	if (pthread_create(&threads[k].tid, NULL,
+			   pipeline ? pipe_stage : replay, &threads[k]) != 0)
+	    app_error("pthread_create failed");
+    pthread_barrier_wait(&start);
+    for (k = 0; k < n; k++)
+	pthread_join(threads[k].tid, NULL);
+    pthread_barrier_destroy(&start);
+    began = threads[0].began;
+    ended = threads[0].ended;
+    for (k = 1; k < n; k++) {
+	if (threads[k].began < began)
+	    began = threads[k].began;
+	if (threads[k].ended > ended)
+	    ended = threads[k].ended;
+    }
+
+    /* Blocks the trace leaves live are freed outside the timing */
+    for (k = 0; k < (split ? 1 : pipeline ? 0 : n); k++)
+	for (i = 0; i < trace->num_ids; i++)
+	    if (threads[k].blocks[i] != NULL) {
+		do_free(threads[k].blocks[i]);
+		threads[k].blocks[i] = NULL;
+	    }
+    if (alloc->heap == HEAP_MAG || alloc->heap == HEAP_MAG_REMOTE)
+	mm_mag_flush();
+    return (ended - began) / 1e9;
+}
+
+/*
+ * next_count - thread count to run after n: the next power of 2, or
+ *     max if that is beyond it
+ */
+static int next_count(int n, int max)
+{
+    return (n < max && n * 2 > max) ? max : n * 2;
+}
+
+/*
+ * run_ops - calls made by a run with n threads
+ */
+static double run_ops(int n)
+{
+    if (split)
+	return trace->num_ops;
+    if (pipeline)
+	return 2.0 * nalloc_ops;
+    return (double)trace->num_ops * n;
+}
+
+/*
+ * report - print the line for n threads, and with -v each thread's
+ *     latencies
+ */
+static void report(int n, double secs, double base)
+{
+    unsigned long long all[NBUCKETS], p99 = 0, p999 = 0, max = 0, v;
+    double ops = run_ops(n);
+    int k, b;
+
+    printf("%7d %10.3f %10.2f", n, ops / secs / 1e6,
+	   (ops / secs) / (n * base));
+    if (!timing) {
+	printf("\n");
+	return;
+    }
+    memset(all, 0, sizeof(all));
+    for (k = 0; k < n; k++) {
+	for (b = 0; b < NBUCKETS; b++)
+	    all[b] += threads[k].hist[b];
+	if ((v = percentile(threads[k].hist, 0.99)) > p99)
+	    p99 = v;
+	if ((v = percentile(threads[k].hist, 0.999)) > p999)
+	    p999 = v;
+	if ((v = percentile(threads[k].hist, 1.0)) > max)
+	    max = v;
+    }
+    printf(" %8llu %8llu %8llu %10llu\n", percentile(all, 0.5), p99, p999,
+	   max);
+    if (verbose)
+	for (k = 0; k < n; k++)
+	    printf("        thread %-3d p50 %llu  p99 %llu  p99.9 %llu  max %llu\n",
+		   k, percentile(threads[k].hist, 0.5),
+		   percentile(threads[k].hist, 0.99),
+		   percentile(threads[k].hist, 0.999),
+		   percentile(threads[k].hist, 1.0));
+}
+
+int main(int argc, char **argv)
+{
+    int c, i, k, n, r, first, maxthreads, *count;
+    double secs, best, base = 0;
+    mm_mag_stats_t st;
+
+    maxthreads = sysconf(_SC_NPROCESSORS_ONLN);
+    alloc = &allocs[0];
+    while ((c = getopt(argc, argv, "t:x:pa:qvh")) != EOF) {
+	switch (c) {
+	case 't': /* Most threads */
+	    maxthreads = atoi(optarg);
+	    break;
+	case 'x': /* Split the trace, moving this share of the frees */
+	    split = 1;
+	    cross = atof(optarg);
+	    break;
+	case 'p': /* Pipelines of producers and consumers */
+	    pipeline = 1;
+	    break;
+	case 'a': /* Allocator */
+	    for (i = 0; i < NALLOCS && strcmp(optarg, allocs[i].name); i++)
+		;
+	    if (i == NALLOCS) {
+		usage();
+		exit(1);
+	    }
+	    alloc = &allocs[i];
+	    break;
+	case 'q': /* Throughput only */
+	    timing = 0;
+	    break;
+	case 'v':
+	    verbose = 1;
+	    break;
+	case 'h':
+	    usage();
+	    exit(0);
+	default:
+	    usage();
+	    exit(1);
+	}
+    }
+    if (pipeline && maxthreads < 2)
+	maxthreads = 2;
+    if (argc - optind != 1 || maxthreads < 1 || maxthreads > MAXTHREADS ||
+	cross < 0 || cross > 1 || (split && pipeline)) {
+	usage();
+	exit(1);
+    }
+
+    trace = read_trace("", argv[optind]);
+    for (k = 0; k < maxthreads; k++) {
+	if (k == 0 || !split)
+	    threads[k].blocks = calloc(trace->num_ids, sizeof(char *));
+	else
+	    threads[k].blocks = threads[0].blocks;
+	if (split || pipeline)
+	    threads[k].ops = malloc(trace->num_ops * sizeof(int));
+	if (threads[k].blocks == NULL ||
+	    ((split || pipeline) && threads[k].ops == NULL))
+	    app_error("Out of memory for the threads");
+    }
+    if (pipeline) {
+	alloc_ops = malloc(trace->num_ops * sizeof(int));
+	rings = aligned_alloc(64, maxthreads / 2 * sizeof(ring_t));
+	if (alloc_ops == NULL || rings == NULL)
+	    app_error("Out of memory for the pipelines");
+	for (i = 0; i < trace->num_ops; i++)
+	    if (!IS_FREE(trace->ops[i].type) && trace->ops[i].type != REALLOC)
+		alloc_ops[nalloc_ops++] = i;
+    }
+    if (split) {
+	/* Number each op among the ops on its id */
+	seq = malloc(trace->num_ops * sizeof(int));
+	done = malloc(trace->num_ids * sizeof(int));
+	count = calloc(trace->num_ids, sizeof(int));
+	if (seq == NULL || done == NULL || count == NULL)
+	    app_error("Out of memory for the split");
+	for (i = 0; i < trace->num_ops; i++)
+	    seq[i] = count[trace->ops[i].index]++;
+	free(count);
+    }
+    if (alloc->heap != HEAP_LIBC)
+	mem_init();
+
+    printf("%s: %d ops, %s", argv[optind], trace->num_ops,
+	   split ? "split" : pipeline ? "pipelines" : "copies");
+    if (split)
+	printf(", %.0f%% of frees on another thread", cross * 100);
+    printf(", %s%s\n\n", alloc->name,
+	   alloc->locked ? " (global lock)" : "");
+    printf("%7s %10s %10s", "threads", "Mops/s", "efficiency");
+    if (timing)
+	printf(" %8s %8s %8s %10s", "p50 ns", "p99", "p99.9", "max");
+    printf("\n");
+
+    for (n = first = pipeline ? 2 : 1; n <= maxthreads;
+	 n = next_count(n, maxthreads)) {
+	if (pipeline && n % 2 != 0)
+	    continue;
+	best = -1;
+	for (r = 0; r < RUNS; r++)
+	    if ((secs = run(n)) < best || best < 0)
+		best = secs;
+	if (n == first)
+	    base = run_ops(n) / best / n;
+	report(n, best, base);
+	if (verbose &&
+	    (alloc->heap == HEAP_MAG || alloc->heap == HEAP_MAG_REMOTE)) {
+	    mm_mag_stats(&st);
+	    printf("        %llu fills, %llu full magazines out, %llu in, "
+		   "%llu remote frees\n", st.fills, st.full_out, st.full_in,
+		   st.remote_frees);
+	}
+    }
+    exit(0);
+}
+
+/*
+ * app_error - Report an arbitrary application error
+ */
+static void app_error(char *msg)
+{
+    printf("%s\n", msg);
+    exit(1);
+}
+
+/*
+ * usage - Explain the command line arguments
+ */
+static void usage(void)
+{
+    fprintf(stderr, "Usage: mtreplay [-hpqv] [-t <threads>] [-x <frac>] [-a <alloc>] <tracefile>\n");
+    fprintf(stderr, "Options\n");
+    fprintf(stderr, "\t-a <alloc>   mm, mag, mag-remote, libc or libc-locked (mm).\n");
+    fprintf(stderr, "\t-h           Print this message.\n");
+    fprintf(stderr, "\t-p           Pair the threads off into producers and\n");
+    fprintf(stderr, "\t             consumers that free what the producers allocate.\n");
+    fprintf(stderr, "\t-q           Don't time single calls, throughput only.\n");
+    fprintf(stderr, "\t-t <threads> Most threads to run (online CPUs).\n");
+    fprintf(stderr, "\t-v           Print latencies for every thread, and mag's\n");
+    fprintf(stderr, "\t             depot statistics.\n");
+    fprintf(stderr, "\t-x <frac>    Split the trace over the threads, with <frac> of\n");
+    fprintf(stderr, "\t             the frees on another thread than the alloc.\n");
+}
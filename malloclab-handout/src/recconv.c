@@ -0,0 +1,69 @@
+/*
+ * recconv.c - convert a raw libmmrecord.so log into a trace file
+ *
+ * libmmrecord.so does this itself when the recorded program exits.
+ * This tool is for logs left behind by a program that was killed, or
+ * kept with MMRECORD_KEEP.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+
+#include "record.h"
+#include "trace.h"
+
+int verbose = 0;  /* read by the trace module */
+
+static void usage(void);
+
+int main(int argc, char **argv)
+{
+    int c;
+    int format = TRACE_TEXT;
+
+    while ((c = getopt(argc, argv, "bpth")) != EOF) {
+	switch (c) {
+	case 'b': /* Write plain binary */
+	    format = TRACE_BINARY;
+	    break;
+	case 'p': /* Write packed (varint/delta) binary */
+	    format = TRACE_PACKED;
+	    break;
+	case 't': /* Write text */
+	    format = TRACE_TEXT;
+	    break;
+	case 'h':
+	    usage();
+	    exit(0);
+	default:
+	    usage();
+	    exit(1);
+	}
+    }
+    if (argc - optind != 2) {
+	usage();
+	exit(1);
+    }
+
+    if (rec_convert(argv[optind], argv[optind+1], format) < 0) {
+	printf("Could not convert %s to %s: %s\n",
+	       argv[optind], argv[optind+1], strerror(errno));
+	exit(1);
+    }
+    exit(0);
+}
+
+/*
+ * usage - Explain the command line arguments
+ */
+static void usage(void)
+{
+    fprintf(stderr, "Usage: recconv [-hbpt] <rawlog> <outfile>\n");
+    fprintf(stderr, "Options\n");
+    fprintf(stderr, "\t-b         Write a plain binary trace.\n");
+    fprintf(stderr, "\t-p         Write a packed (varint/delta) binary trace.\n");
+    fprintf(stderr, "\t-t         Write a text (.rep) trace (default).\n");
+    fprintf(stderr, "\t-h         Print this message.\n");
+}
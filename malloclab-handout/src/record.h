@@ -0,0 +1,41 @@
+#ifndef __RECORD_H_
+#define __RECORD_H_
+
+/*
+ * record.h - raw event log written by the libmmrecord.so preload library
+ *
+ * Each thread appends allocator events to its own buffer. Full buffers
+ * are written to the raw log as blocks by a background thread, in
+ * whatever order they fill up, so the log is only ordered within a
+ * block. rec_convert() merges the blocks back into global order by
+ * sequence number, renames pointers to the dense ids that trace files
+ * use, and writes the result with the trace writer.
+ */
+
+/* Raw event types */
+#define REC_MALLOC   0  /* ptr = malloc(size) */
+#define REC_FREE     1  /* free(ptr) */
+#define REC_REALLOC  2  /* ptr = realloc(old, size) */
+#define REC_CALLOC   3  /* ptr = calloc(n, m), size = n*m */
+#define REC_MEMALIGN 4  /* ptr = memalign(align, size) and friends,
+			   old = align (0 in logs from before it was kept) */
+
+#define REC_TYPE_BITS 8
+
+/* One allocator event */
+typedef struct {
+    unsigned long long seq;   /* position in the global order of events */
+    unsigned long long ptr;   /* block returned, or freed */
+    unsigned long long old;   /* block passed to realloc */
+    unsigned long long info;  /* size << REC_TYPE_BITS | type */
+} recevent_t;
+
+/* Each block in the raw log is a header followed by n events */
+typedef struct {
+    unsigned int n;           /* events in this block */
+    unsigned int tid;         /* recorder slot of the thread that wrote it */
+} recblock_t;
+
+int rec_convert(char *rawpath, char *tracepath, int format);
+
+#endif /* __RECORD_H_ */
@@ -0,0 +1,52 @@
+#ifndef __STREAM_H_
+#define __STREAM_H_
+
+/*
+ * stream.h - read a trace in chunks with double-buffered readahead
+ *
+ * A background thread fills one chunk buffer from the trace file while
+ * the caller consumes the other, so traces far larger than memory can
+ * be replayed in constant space. Any trace format read_trace()
+ * understands can be streamed.
+ */
+#include <stdio.h>
+#include <pthread.h>
+
+#include "trace.h"
+
+#define STREAM_CHUNK (1<<16)  /* ops per chunk buffer */
+
+typedef struct {
+    /* header of the trace being streamed */
+    int sugg_heapsize;
+    int num_ids;
+    int num_ops;
+    int weight;
+    int format;                 /* TRACE_TEXT, TRACE_BINARY or TRACE_PACKED */
+    int version;                /* binary: TRACE_VERSION or older */
+
+    /* state owned by the reader thread */
+    FILE *fp;                   /* trace file */
+    int ops_read;               /* ops handed to the buffers so far */
+    int last[NTYPES];           /* packed decoding state */
+    unsigned char *raw;         /* packed bytes not yet decoded */
+    size_t rawlen;
+    int error;                  /* set if the trace turned out malformed */
+
+    /* the two chunk buffers and their hand-off */
+    traceop_t *buf[2];
+    int len[2];                 /* ops in each buffer */
+    int full[2];                /* buffer is ready for the consumer */
+    int cur;                    /* buffer the consumer reads next */
+    int held;                   /* buffer the consumer holds (-1 if none) */
+    int done;                   /* consumer asked the reader to stop */
+    pthread_t reader;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+} stream_t;
+
+int stream_open(stream_t *s, char *path);
+traceop_t *stream_next(stream_t *s, int *n);
+int stream_close(stream_t *s);
+
+#endif /* __STREAM_H_ */
@@ -0,0 +1,128 @@
+#ifndef __TRACE_H_
+#define __TRACE_H_
+
+/*
+ * trace.h - reading and writing malloc lab trace files
+ *
+ * A trace comes in one of two formats:
+ *
+ *   text (.rep)  - four header numbers followed by one request per line
+ *                  ("a id size", "r id size", "f id", "c id size"
+ *                  for a zeroed allocation, "m id align size" for
+ *                  an aligned one, and "ba id size" and "bf id" for
+ *                  the members of a batch).
+ *   binary       - a fixed tracehdr_t followed either by the traceop_t
+ *                  array itself, which read_trace() maps into memory and
+ *                  the driver replays in place, or by a varint/delta
+ *                  encoding of that array (TRACE_VARINT), which is
+ *                  decoded in one pass without any parsing.
+ *
+ * Binary traces are stored in the byte order of the host that wrote
+ * them.
+ */
+#include <stdio.h>
+#include <stddef.h>
+
+/*
+ * Request types; NTYPES counts them. A run of consecutive BALLOC ops of
+ * one size is a single mm_malloc_batch call, and a run of consecutive
+ * BFREE ops a single mm_free_batch call.
+ */
+enum {ALLOC, FREE, REALLOC, MEMALIGN, CALLOC, BALLOC, BFREE, NTYPES};
+
+/* True for the request types that take no size */
+#define IS_FREE(type) ((type) == FREE || (type) == BFREE)
+
+/* True for the request types whose blocks mm_free_sized may free */
+#define IS_SIZED(type) ((type) == ALLOC || (type) == CALLOC || (type) == BALLOC)
+
+/* Trace file formats */
+#define TRACE_TEXT    0
+#define TRACE_BINARY  1
+#define TRACE_PACKED  2  /* binary with TRACE_VARINT */
+
+/*
+ * Characterizes a single trace operation (allocator request). Sizes
+ * are 64 bits even in the 32-bit build, so that traces of big heaps
+ * can be read anywhere; the layout (16 bytes) is the same in both.
+ */
+typedef struct {
+    unsigned short type;     /* type of request */
+    unsigned short lgalign;  /* memalign: log2 of the alignment, else 0 */
+    int index;               /* index for free() to use later */
+    unsigned long long size; /* byte size of alloc/realloc request */
+} traceop_t;
+
+/* Holds the information for one trace file*/
+typedef struct {
+    int sugg_heapsize;   /* suggested heap size (unused) */
+    int num_ids;         /* number of alloc/realloc ids */
+    int num_ops;         /* number of distinct requests */
+    int weight;          /* weight for this trace (unused) */
+    traceop_t *ops;      /* array of requests */
+    char **blocks;       /* array of ptrs returned by malloc/realloc... */
+    size_t *block_sizes; /* ... and a corresponding array of payload sizes */
+    char *block_sized;   /* ... and whether mm_free_sized may free them */
+    int format;          /* format the trace was read from (TRACE_xxx) */
+    void *map;           /* mapping that ops points into (NULL if malloc'd) */
+    size_t maplen;       /* length of that mapping in bytes */
+} trace_t;
+
+/* On-disk header of a binary trace */
+#define TRACE_MAGIC   "MMTRACE"  /* 8 bytes including the NUL */
+#define TRACE_VERSION 3          /* older versions are still read */
+#define TRACE_VARINT  0x1        /* flag: ops are varint/delta encoded */
+
+/*
+ * Version 1 had 32-bit sizes. Version 2 had an int type in place of
+ * type and lgalign, which is the same layout on a little-endian host,
+ * and packed ops with two type bits rather than three.
+ */
+
+/* An op of a plain version 1 trace; packed ops did not change */
+typedef struct {
+    int type;
+    int index;
+    int size;
+} traceop_v1_t;
+
+typedef struct {
+    char magic[8];            /* TRACE_MAGIC */
+    unsigned int version;     /* TRACE_VERSION */
+    unsigned int flags;       /* TRACE_VARINT or 0 */
+    int sugg_heapsize;        /* same four fields as the text header */
+    int num_ids;
+    int num_ops;
+    int weight;
+    unsigned long long oplen; /* bytes of op data following the header */
+} tracehdr_t;
+
+/*
+ * Writes a trace one op at a time. The header fields may be filled in
+ * before trace_wopen() or left negative, in which case they are patched
+ * by trace_wclose() once the whole trace has been seen.
+ */
+typedef struct {
+    FILE *fp;            /* output stream */
+    int format;          /* TRACE_TEXT, TRACE_BINARY or TRACE_PACKED */
+    tracehdr_t hdr;      /* header as it will be written */
+    int patch;           /* header must be rewritten on close */
+    int num_ops;         /* ops written so far */
+    int max_index;       /* largest id seen so far */
+    unsigned long long oplen; /* bytes of op data written so far */
+    int last[NTYPES];    /* previous index per request type (packed only) */
+} tracewriter_t;
+
+trace_t *read_trace(char *tracedir, char *filename);
+void free_trace(trace_t *trace);
+
+int trace_unpack(const unsigned char **pp, const unsigned char *end,
+		 int version, int last[NTYPES], int num_ids, traceop_t *ops,
+		 int max);
+
+int trace_wopen(tracewriter_t *w, char *path, int format,
+		int sugg_heapsize, int num_ids, int num_ops, int weight);
+void trace_wop(tracewriter_t *w, traceop_t *op);
+int trace_wclose(tracewriter_t *w);
+
+#endif /* __TRACE_H_ */
@@ -0,0 +1,88 @@
+/*
+ * traceconv.c - convert malloc lab traces between the text (.rep)
+ *     format and the binary formats described in trace.h
+ *
+ * By default a text trace is converted to plain binary and a binary
+ * trace (plain or packed) is converted back to text.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+
+#include "trace.h"
+
+int verbose = 0;  /* read by read_trace */
+
+static void usage(void);
+
+int main(int argc, char **argv)
+{
+    int c, i;
+    int format = -1;
+    trace_t *trace;
+    tracewriter_t w;
+
+    while ((c = getopt(argc, argv, "bpthv")) != EOF) {
+	switch (c) {
+	case 'b': /* Write plain binary */
+	    format = TRACE_BINARY;
+	    break;
+	case 'p': /* Write packed (varint/delta) binary */
+	    format = TRACE_PACKED;
+	    break;
+	case 't': /* Write text */
+	    format = TRACE_TEXT;
+	    break;
+	case 'v':
+	    verbose = 2;
+	    break;
+	case 'h':
+	    usage();
+	    exit(0);
+	default:
+	    usage();
+	    exit(1);
+	}
+    }
+    if (argc - optind != 2) {
+	usage();
+	exit(1);
+    }
+
+    trace = read_trace("", argv[optind]);
+
+    /* Pick the opposite of the input format unless told otherwise */
+    if (format < 0)
+	format = (trace->format == TRACE_TEXT) ? TRACE_BINARY : TRACE_TEXT;
+
+    if (trace_wopen(&w, argv[optind+1], format, trace->sugg_heapsize,
+		    trace->num_ids, trace->num_ops, trace->weight) < 0) {
+	printf("Could not create %s: %s\n", argv[optind+1], strerror(errno));
+	exit(1);
+    }
+    for (i = 0; i < trace->num_ops; i++)
+	trace_wop(&w, &trace->ops[i]);
+    if (trace_wclose(&w) < 0) {
+	printf("Error writing %s: %s\n", argv[optind+1], strerror(errno));
+	exit(1);
+    }
+
+    free_trace(trace);
+    exit(0);
+}
+
+/*
+ * usage - Explain the command line arguments
+ */
+static void usage(void)
+{
+    fprintf(stderr, "Usage: traceconv [-hbptv] <infile> <outfile>\n");
+    fprintf(stderr, "Options\n");
+    fprintf(stderr, "\t-b         Write a plain binary trace (mmap'd by mdriver).\n");
+    fprintf(stderr, "\t-p         Write a packed (varint/delta) binary trace.\n");
+    fprintf(stderr, "\t-t         Write a text (.rep) trace.\n");
+    fprintf(stderr, "\t-h         Print this message.\n");
+    fprintf(stderr, "\t-v         Print additional debug info.\n");
+}
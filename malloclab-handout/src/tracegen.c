@@ -0,0 +1,656 @@
+/*
+ * tracegen.c - generate synthetic malloc lab traces from workload models
+ *
+ * A trace is made of one or more phases. In each phase, requests are
+ * drawn from a size model, every block lives for a number of ops drawn
+ * from a lifetime model, and some blocks grow through a chain of
+ * reallocs before they die; a share of allocations can ask for an
+ * alignment (memalign) or for zeroed memory (calloc), and a share can
+ * come as batches of blocks of one size that are allocated and freed
+ * together (mm_malloc_batch and mm_free_batch). Models are
+ * mixtures of simple distributions, so workloads like "mostly small,
+ * short-lived blocks plus a few large, long-lived ones" are one
+ * command line:
+ *
+ *     unix> tracegen -s 7 -n 10000000 -S 9*power:8:512:1.5 \
+ *               -S bimodal:4096:65536:0.5 -L exp:2000 big.rep
+ *
+ * Blocks that die are freed at the op their lifetime says, so the live
+ * set follows the models, and ids are reused once their block is freed,
+ * which keeps num_ids close to the peak number of live blocks. Blocks
+ * still live at the end of the last phase are freed in death order, so
+ * every trace is balanced. The generator keeps only the live blocks in
+ * memory and writes ops as it goes, so traces of hundreds of millions of
+ * ops take no more memory than their peak live set. The same seed and
+ * models always produce the same trace.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <limits.h>
+
+#include "trace.h"
+
+int verbose = 0;  /* read by the trace module */
+
+#define MAXDIST    16         /* components in one mixture */
+#define MAXCLASSES 64         /* sizes in one fixed:... list */
+#define MAXPHASES  64
+#define MAX_SIZE   (1LL<<40)  /* largest request we will emit */
+
+/* Distributions a model component can draw from */
+enum {DIST_FIXED, DIST_UNIFORM, DIST_POWER, DIST_BIMODAL, DIST_EXP};
+
+typedef struct {
+    int kind;                 /* DIST_xxx */
+    double weight;            /* relative weight within the mixture */
+    double a, b, c;           /* parameters, see usage() */
+    int n;                    /* fixed: number of classes */
+    long long vals[MAXCLASSES]; /* fixed: the classes */
+} dist_t;
+
+/* A weighted mixture of distributions */
+typedef struct {
+    int n;
+    double total;             /* sum of the weights */
+    dist_t d[MAXDIST];
+} mix_t;
+
+typedef struct {
+    long long ops;            /* ops to emit in this phase */
+    mix_t size;               /* request sizes in bytes */
+    mix_t life;               /* lifetimes in ops */
+    double realloc_p;         /* chance a block starts a realloc chain */
+    double growth;            /* size factor per realloc */
+    int chain;                /* reallocs per chain */
+    double gap;               /* mean ops between reallocs in a chain */
+    double align_p;           /* chance an allocation is a memalign */
+    int nalign;               /* alignments to pick from ... */
+    int lgalign[MAXCLASSES];  /* ... as log2 of the byte alignment */
+    double calloc_p;          /* chance an allocation is a calloc */
+    double batch_p;           /* chance an allocation starts a batch ... */
+    int batch_n;              /* ... of this many blocks */
+} phase_t;
+
+/* A pending realloc or free, keyed by the op at which it is due */
+typedef struct {
+    unsigned long long when;
+    int id;
+} event_t;
+
+/* What we know about each id */
+typedef struct {
+    long long size;           /* current size */
+    int grows;                /* reallocs left in its chain */
+    unsigned long long death; /* op at which it is freed */
+    int batch;                /* allocated and freed in a batch */
+    int next;                 /* batch: the next block in it, -1 after the last */
+} block_t;
+
+/* Generator state */
+static unsigned long long rng_state;
+static event_t *events;       /* min-heap of pending events */
+static int nevents, maxevents;
+static block_t *blocks;       /* indexed by id */
+static int *free_ids;         /* stack of ids whose blocks were freed */
+static int nfree, next_id, maxids;
+static long long live_bytes, peak_bytes;
+
+/* function prototypes */
+static void usage(void);
+static void gen_error(char *msg, char *arg);
+
+/***************************************************
+ * Random numbers
+ ***************************************************/
+
+/* rng_next - xorshift64* step */
+static unsigned long long rng_next(void)
+{
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return rng_state * 0x2545F4914F6CDD1Dull;
+}
+
+/* rng_seed - spread a small seed over the state with a splitmix64 step */
+static void rng_seed(unsigned long long seed)
+{
+    unsigned long long z = seed + 0x9E3779B97F4A7C15ull;
+
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    rng_state = (z ^ (z >> 31)) | 1;
+}
+
+/* rng_unit - uniform double in [0, 1) */
+static double rng_unit(void)
+{
+    return (rng_next() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/* rng_range - uniform integer in [lo, hi] */
+static long long rng_range(long long lo, long long hi)
+{
+    if (hi <= lo)
+	return lo;
+    return lo + (long long)(rng_unit() * (double)(hi - lo + 1));
+}
+
+/***************************************************
+ * Models
+ ***************************************************/
+
+/*
+ * dist_parse - parse one mixture component, "[w*]kind:params"
+ */
+static void dist_parse(dist_t *d, char *spec)
+{
+    char *s = spec, *end;
+    int n;
+
+    memset(d, 0, sizeof(dist_t));
+    d->weight = 1;
+    if ((end = strchr(s, '*')) != NULL) {
+	d->weight = strtod(s, NULL);
+	s = end + 1;
+	if (d->weight <= 0)
+	    gen_error("Bad weight in", spec);
+    }
+
+    if (strncmp(s, "fixed:", 6) == 0) {
+	d->kind = DIST_FIXED;
+	for (s += 6; d->n < MAXCLASSES; s = end + 1) {
+	    d->vals[d->n++] = strtoll(s, &end, 0);
+	    if (end == s || d->vals[d->n-1] <= 0)
+		gen_error("Bad size class in", spec);
+	    if (*end != ',')
+		break;
+	}
+	return;
+    }
+
+    if (strncmp(s, "uniform:", 8) == 0) {
+	d->kind = DIST_UNIFORM;
+	n = sscanf(s + 8, "%lf:%lf", &d->a, &d->b);
+	if (n != 2 || d->a < 1 || d->b < d->a)
+	    gen_error("Bad uniform model", spec);
+    }
+    else if (strncmp(s, "power:", 6) == 0) {
+	d->kind = DIST_POWER;
+	n = sscanf(s + 6, "%lf:%lf:%lf", &d->a, &d->b, &d->c);
+	if (n != 3 || d->a < 1 || d->b < d->a || d->c <= 0)
+	    gen_error("Bad power model", spec);
+    }
+    else if (strncmp(s, "bimodal:", 8) == 0) {
+	d->kind = DIST_BIMODAL;
+	n = sscanf(s + 8, "%lf:%lf:%lf", &d->a, &d->b, &d->c);
+	if (n != 3 || d->a < 1 || d->b < 1 || d->c < 0 || d->c > 1)
+	    gen_error("Bad bimodal model", spec);
+    }
+    else if (strncmp(s, "exp:", 4) == 0) {
+	d->kind = DIST_EXP;
+	if (sscanf(s + 4, "%lf", &d->a) != 1 || d->a <= 0)
+	    gen_error("Bad exp model", spec);
+    }
+    else
+	gen_error("Unknown model", spec);
+}
+
+/* dist_sample - draw one value (at least 1) from d */
+static long long dist_sample(dist_t *d)
+{
+    double u, r;
+    long long x;
+
+    switch (d->kind) {
+    case DIST_FIXED:
+	return d->vals[rng_range(0, d->n - 1)];
+    case DIST_UNIFORM:
+	return rng_range((long long)d->a, (long long)d->b);
+    case DIST_POWER:
+	/* Pareto with shape c, truncated to [a, b], by inverting its CDF */
+	u = rng_unit();
+	r = 1 - u * (1 - pow(d->a / d->b, d->c));
+	x = (long long)(d->a * pow(r, -1 / d->c));
+	return (x > (long long)d->b) ? (long long)d->b : x;
+    case DIST_BIMODAL:
+	/* Near a with probability c, otherwise near b */
+	if (rng_unit() < d->c)
+	    return rng_range((long long)d->a / 2 + 1, (long long)d->a);
+	return rng_range((long long)d->b / 2 + 1, (long long)d->b);
+    default: /* DIST_EXP */
+	x = (long long)(-d->a * log(1 - rng_unit()));
+	return (x < 1) ? 1 : x;
+    }
+}
+
+/* mix_add - add a component to a mixture */
+static void mix_add(mix_t *m, char *spec)
+{
+    if (m->n == MAXDIST)
+	gen_error("Too many components in a mixture at", spec);
+    dist_parse(&m->d[m->n], spec);
+    m->total += m->d[m->n].weight;
+    m->n++;
+}
+
+/* mix_sample - pick a component by weight and draw from it */
+static long long mix_sample(mix_t *m)
+{
+    double u = rng_unit() * m->total;
+    int i;
+
+    for (i = 0; i < m->n - 1; i++) {
+	if (u < m->d[i].weight)
+	    break;
+	u -= m->d[i].weight;
+    }
+    return dist_sample(&m->d[i]);
+}
+
+/***************************************************
+ * The event heap and the id pool
+ ***************************************************/
+
+static void event_push(unsigned long long when, int id)
+{
+    int i, parent;
+
+    if (nevents == maxevents) {
+	maxevents = maxevents ? 2 * maxevents : 4096;
+	if ((events = realloc(events, maxevents * sizeof(event_t))) == NULL)
+	    gen_error("Out of memory for", "the event heap");
+    }
+    for (i = nevents++; i > 0; i = parent) {
+	parent = (i - 1) / 2;
+	if (events[parent].when <= when)
+	    break;
+	events[i] = events[parent];
+    }
+    events[i].when = when;
+    events[i].id = id;
+}
+
+static event_t event_pop(void)
+{
+    event_t top = events[0], last = events[--nevents];
+    int i = 0, c;
+
+    for (;;) {
+	c = 2 * i + 1;
+	if (c >= nevents)
+	    break;
+	if (c + 1 < nevents && events[c + 1].when < events[c].when)
+	    c++;
+	if (last.when <= events[c].when)
+	    break;
+	events[i] = events[c];
+	i = c;
+    }
+    if (nevents > 0)
+	events[i] = last;
+    return top;
+}
+
+static int id_get(void)
+{
+    if (nfree > 0)
+	return free_ids[--nfree];
+    if (next_id == INT_MAX)
+	gen_error("Too many live blocks in", "the trace");
+    if (next_id == maxids) {
+	maxids = maxids ? 2 * maxids : 4096;
+	blocks = realloc(blocks, maxids * sizeof(block_t));
+	free_ids = realloc(free_ids, maxids * sizeof(int));
+	if (blocks == NULL || free_ids == NULL)
+	    gen_error("Out of memory for", "the live blocks");
+    }
+    return next_id++;
+}
+
+/***************************************************
+ * Emitting ops
+ ***************************************************/
+
+static void emit(tracewriter_t *w, int type, int lgalign, int id,
+		 long long size)
+{
+    traceop_t op;
+
+    op.type = type;
+    op.lgalign = lgalign;
+    op.index = id;
+    op.size = size;
+    trace_wop(w, &op);
+}
+
+/*
+ * gen_batch - start a batch of p->batch_n blocks of one size and one
+ *     lifetime at op t. Only the first block of the batch has an event;
+ *     the others hang off it through next. Returns the ops emitted.
+ */
+static int gen_batch(tracewriter_t *w, phase_t *p, unsigned long long t)
+{
+    long long size = mix_sample(&p->size);
+    unsigned long long death = t + mix_sample(&p->life);
+    int i, id, first = -1, prev = -1;
+
+    if (size > MAX_SIZE)
+	size = MAX_SIZE;
+    for (i = 0; i < p->batch_n; i++) {
+	id = id_get();
+	blocks[id].size = size;
+	blocks[id].death = death;
+	blocks[id].grows = 0;
+	blocks[id].batch = 1;
+	blocks[id].next = -1;
+	if (prev >= 0)
+	    blocks[prev].next = id;
+	else
+	    first = id;
+	prev = id;
+	emit(w, BALLOC, 0, id, size);
+
+	live_bytes += size;
+	if (live_bytes > peak_bytes)
+	    peak_bytes = live_bytes;
+    }
+    event_push(death, first);
+    return p->batch_n;
+}
+
+/* gen_alloc - start a new block at op t; returns the ops emitted */
+static int gen_alloc(tracewriter_t *w, phase_t *p, unsigned long long t)
+{
+    long long size;
+    int id;
+    block_t *b;
+
+    if (p->batch_p > 0 && rng_unit() < p->batch_p)
+	return gen_batch(w, p, t);
+
+    size = mix_sample(&p->size);
+    id = id_get();
+    b = &blocks[id];
+    b->size = (size > MAX_SIZE) ? MAX_SIZE : size;
+    b->death = t + mix_sample(&p->life);
+    b->grows = 0;
+    b->batch = 0;
+    if (p->align_p > 0 && rng_unit() < p->align_p)
+	emit(w, MEMALIGN, p->lgalign[rng_range(0, p->nalign - 1)], id,
+	     b->size);
+    else if (p->calloc_p > 0 && rng_unit() < p->calloc_p)
+	emit(w, CALLOC, 0, id, b->size);
+    else
+	emit(w, ALLOC, 0, id, b->size);
+
+    live_bytes += b->size;
+    if (live_bytes > peak_bytes)
+	peak_bytes = live_bytes;
+
+    if (p->chain > 0 && rng_unit() < p->realloc_p) {
+	b->grows = p->chain;
+	event_push(t + (long long)(-p->gap * log(1 - rng_unit())) + 1, id);
+    }
+    else
+	event_push(b->death, id);
+    return 1;
+}
+
+/*
+ * gen_free - free block id, or the whole batch it starts; returns the
+ *     ops emitted
+ */
+static int gen_free(tracewriter_t *w, int id)
+{
+    int n = 0;
+
+    if (!blocks[id].batch) {
+	emit(w, FREE, 0, id, 0);
+	live_bytes -= blocks[id].size;
+	free_ids[nfree++] = id;
+	return 1;
+    }
+    for (; id >= 0; id = blocks[id].next, n++) {
+	emit(w, BFREE, 0, id, 0);
+	live_bytes -= blocks[id].size;
+	free_ids[nfree++] = id;
+    }
+    return n;
+}
+
+/*
+ * gen_event - carry out the next step in a block's life at op t;
+ *     returns the ops emitted
+ */
+static int gen_event(tracewriter_t *w, phase_t *p, int id,
+		     unsigned long long t)
+{
+    block_t *b = &blocks[id];
+    unsigned long long next;
+    double size;
+
+    if (b->grows > 0 && t < b->death) {
+	size = b->size * p->growth;
+	if (size < b->size + 1)
+	    size = b->size + 1;
+	if (size > MAX_SIZE)
+	    size = MAX_SIZE;
+	live_bytes += (long long)size - b->size;
+	if (live_bytes > peak_bytes)
+	    peak_bytes = live_bytes;
+	b->size = (long long)size;
+	emit(w, REALLOC, 0, id, b->size);
+
+	next = t + (long long)(-p->gap * log(1 - rng_unit())) + 1;
+	if (--b->grows == 0 || next >= b->death || b->size == MAX_SIZE) {
+	    b->grows = 0;
+	    next = b->death;
+	}
+	event_push(next, id);
+	return 1;
+    }
+
+    return gen_free(w, id);
+}
+
+int main(int argc, char **argv)
+{
+    phase_t phases[MAXPHASES], *p;
+    int nphases = 1, inherited_size = 1, inherited_life = 1;
+    int c, i, format = TRACE_TEXT;
+    unsigned long long seed = 1, t = 0, end, align;
+    char *s;
+    event_t e;
+    tracewriter_t w;
+    char *out;
+
+    /* Defaults for the first phase */
+    memset(phases, 0, sizeof(phases));
+    p = &phases[0];
+    p->ops = 100000;
+    mix_add(&p->size, "power:8:4096:1.2");
+    mix_add(&p->life, "exp:1000");
+    p->growth = 1.5;
+    p->gap = 10;
+
+    while ((c = getopt(argc, argv, "s:n:S:L:R:A:C:G:P:bpthv")) != EOF) {
+	switch (c) {
+	case 's': /* Seed */
+	    seed = strtoull(optarg, NULL, 0);
+	    break;
+	case 'n': /* Ops in the current phase */
+	    p->ops = strtoll(optarg, NULL, 0);
+	    break;
+	case 'S': /* Add a size model component */
+	    if (inherited_size) {
+		memset(&p->size, 0, sizeof(mix_t));
+		inherited_size = 0;
+	    }
+	    mix_add(&p->size, optarg);
+	    break;
+	case 'L': /* Add a lifetime model component */
+	    if (inherited_life) {
+		memset(&p->life, 0, sizeof(mix_t));
+		inherited_life = 0;
+	    }
+	    mix_add(&p->life, optarg);
+	    break;
+	case 'R': /* Realloc chains: prob[:growth[:length[:gap]]] */
+	    if (sscanf(optarg, "%lf:%lf:%d:%lf", &p->realloc_p, &p->growth,
+		       &p->chain, &p->gap) < 1 ||
+		p->realloc_p < 0 || p->realloc_p > 1 || p->growth < 1 ||
+		p->gap <= 0)
+		gen_error("Bad realloc model", optarg);
+	    if (p->chain <= 0)
+		p->chain = 8;
+	    break;
+	case 'A': /* Aligned allocations: prob:align[,align...] */
+	    p->align_p = strtod(optarg, &s);
+	    if (*s != ':' || p->align_p < 0 || p->align_p > 1)
+		gen_error("Bad alignment model", optarg);
+	    p->nalign = 0;
+	    do {
+		if (p->nalign == MAXCLASSES)
+		    gen_error("Too many alignments in", optarg);
+		align = strtoull(s + 1, &s, 0);
+		if (align == 0 || (align & (align - 1)) != 0)
+		    gen_error("Alignment not a power of 2 in", optarg);
+		p->lgalign[p->nalign++] = 63 - __builtin_clzll(align);
+	    } while (*s == ',');
+	    if (*s != '\0')
+		gen_error("Bad alignment model", optarg);
+	    break;
+	case 'C': /* Zeroed allocations: prob */
+	    p->calloc_p = strtod(optarg, &s);
+	    if (*s != '\0' || p->calloc_p < 0 || p->calloc_p > 1)
+		gen_error("Bad calloc share", optarg);
+	    break;
+	case 'G': /* Batches: prob:blocks */
+	    if (sscanf(optarg, "%lf:%d", &p->batch_p, &p->batch_n) != 2 ||
+		p->batch_p < 0 || p->batch_p > 1 || p->batch_n < 1)
+		gen_error("Bad batch model", optarg);
+	    break;
+	case 'P': /* Start a new phase, with the current one's models */
+	    if (nphases == MAXPHASES)
+		gen_error("Too many phases at", optarg);
+	    phases[nphases] = *p;
+	    p = &phases[nphases++];
+	    p->ops = strtoll(optarg, NULL, 0);
+	    inherited_size = inherited_life = 1;
+	    break;
+	case 'b': /* Write plain binary */
+	    format = TRACE_BINARY;
+	    break;
+	case 'p': /* Write packed (varint/delta) binary */
+	    format = TRACE_PACKED;
+	    break;
+	case 't': /* Write text */
+	    format = TRACE_TEXT;
+	    break;
+	case 'v':
+	    verbose = 1;
+	    break;
+	case 'h':
+	    usage();
+	    exit(0);
+	default:
+	    usage();
+	    exit(1);
+	}
+    }
+    if (argc - optind != 1) {
+	usage();
+	exit(1);
+    }
+    out = argv[optind];
+    rng_seed(seed);
+
+    if (trace_wopen(&w, out, format, 0, -1, -1, 1) < 0) {
+	printf("Could not create %s: %s\n", out, strerror(errno));
+	exit(1);
+    }
+
+    for (i = 0; i < nphases; i++) {
+	p = &phases[i];
+	for (end = t + p->ops; t < end; t++) {
+	    if (nevents > 0 && events[0].when <= t) {
+		e = event_pop();
+		t += gen_event(&w, p, e.id, t) - 1;
+	    }
+	    else
+		t += gen_alloc(&w, p, t) - 1;
+	}
+	if (verbose)
+	    printf("phase %d: %lld ops, %d live blocks, %lld live bytes\n",
+		   i, p->ops, nevents, live_bytes);
+    }
+
+    /* Free whatever is still live, in the order the blocks would die */
+    while (nevents > 0) {
+	e = event_pop();
+	gen_free(&w, e.id);
+    }
+
+    w.hdr.sugg_heapsize = (peak_bytes > INT_MAX) ? INT_MAX : (int)peak_bytes;
+    if (trace_wclose(&w) < 0) {
+	printf("Error writing %s: %s\n", out, strerror(errno));
+	exit(1);
+    }
+    if (verbose)
+	printf("%s: %d ops, %d ids, peak %lld live bytes\n",
+	       out, w.num_ops, w.max_index + 1, peak_bytes);
+    exit(0);
+}
+
+/*
+ * gen_error - report a bad argument and quit
+ */
+static void gen_error(char *msg, char *arg)
+{
+    printf("tracegen: %s %s\n", msg, arg);
+    exit(1);
+}
+
+/*
+ * usage - Explain the command line arguments
+ */
+static void usage(void)
+{
+    fprintf(stderr, "Usage: tracegen [-hbptv] [-s seed] [-n ops] [-S size] [-L life]\n");
+    fprintf(stderr, "                [-R realloc] [-A align] [-C p] [-G batch] [-P ops [...]]\n");
+    fprintf(stderr, "                <outfile>\n");
+    fprintf(stderr, "Options\n");
+    fprintf(stderr, "\t-s <seed>  Seed the generator (default 1).\n");
+    fprintf(stderr, "\t-n <ops>   Ops in the current phase (default 100000).\n");
+    fprintf(stderr, "\t-S <dist>  Add a component to the size model (bytes).\n");
+    fprintf(stderr, "\t-L <dist>  Add a component to the lifetime model (ops).\n");
+    fprintf(stderr, "\t-R <p>[:<growth>[:<len>[:<gap>]]]\n");
+    fprintf(stderr, "\t           A share p of blocks grow by <growth> (1.5) up to\n");
+    fprintf(stderr, "\t           <len> (8) times, <gap> (10) ops apart on average.\n");
+    fprintf(stderr, "\t-A <p>:<align>[,<align>...]\n");
+    fprintf(stderr, "\t           A share p of allocations are memaligns, to one of\n");
+    fprintf(stderr, "\t           the listed alignments (powers of 2) at random.\n");
+    fprintf(stderr, "\t-C <p>     A share p of the other allocations are callocs.\n");
+    fprintf(stderr, "\t-G <p>:<n> A share p of allocations are batches of <n> blocks\n");
+    fprintf(stderr, "\t           of one size, allocated and freed together.\n");
+    fprintf(stderr, "\t-P <ops>   Start a new phase of <ops> ops. It keeps the models\n");
+    fprintf(stderr, "\t           of the phase before unless -S, -L, -R, -A, -C or -G\n");
+    fprintf(stderr, "\t           follow.\n");
+    fprintf(stderr, "\t-b         Write a plain binary trace.\n");
+    fprintf(stderr, "\t-p         Write a packed (varint/delta) binary trace.\n");
+    fprintf(stderr, "\t-t         Write a text (.rep) trace (default).\n");
+    fprintf(stderr, "\t-h         Print this message.\n");
+    fprintf(stderr, "\t-v         Print a summary of each phase.\n");
+    fprintf(stderr, "Each <dist> is [<weight>*]<model>, with <model> one of\n");
+    fprintf(stderr, "\tfixed:<n>,<n>,...         One of the listed values.\n");
+    fprintf(stderr, "\tuniform:<lo>:<hi>         Uniform in [lo, hi].\n");
+    fprintf(stderr, "\tpower:<lo>:<hi>:<alpha>   Power law (Pareto) on [lo, hi].\n");
+    fprintf(stderr, "\tbimodal:<a>:<b>:<p>       Near a with probability p, else near b.\n");
+    fprintf(stderr, "\texp:<mean>                Exponential.\n");
+    fprintf(stderr, "Repeating -S or -L makes a weighted mixture.\n");
+}
@@ -0,0 +1,252 @@
+/*
+ * arenabench.c - request-scoped frees against arena resets
+ *
+ *     unix> arenabench [-w window] [-c chunk] trace
+ *
+ * A trace has no requests in it, so arenabench makes some up: it cuts
+ * the trace into windows of window ops (or, without -w, of 100, 1000,
+ * 10000 and 100000 ops, one after the other) and takes each window for
+ * one request. A block allocated by malloc or calloc and freed in the
+ * same window, with no realloc in between, is request-scoped. The
+ * trace is then replayed two ways:
+ *
+ *   free        every block from mm_malloc, mm_calloc or mm_memalign
+ *               and freed with mm_free, as the trace does
+ *   arena       request-scoped blocks from mm_arena_alloc on one arena
+ *               (calloc'd ones memset), their frees dropped, and an
+ *               mm_arena_reset at the end of every window; the other
+ *               blocks as before
+ *
+ * Batch ops are plain mallocs and frees here. Payloads are not
+ * touched, as in mdriver's timed replay. Each replay starts from an
+ * empty heap and is run five times, the fastest kept. For each window
+ * it prints the share of the blocks that were request-scoped, the ns
+ * per op of each way and the heap each ended up with: chunks hold on
+ * to their free space until the reset, so an arena trades heap for
+ * time.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+
+#include "mm.h"
+#include "mmarena.h"
+#include "memlib.h"
+#include "ftimer.h"
+#include "trace.h"
+
+int verbose = 0;  /* read by the trace module */
+
+#define RUNS       5          /* runs of each replay, fastest kept */
+
+static trace_t *trace;
+static char *scoped;          /* per op: alloc or free of a scoped block */
+static size_t chunk = 0;      /* arena chunk bytes (0: mmarena's default) */
+
+/* function prototypes */
+static void usage(void);
+static void app_error(char *msg);
+
+/*
+ * mark_scoped - set scoped[i] for the allocs and frees of the blocks
+ *     that live within one window; returns how many blocks do
+ */
+static long mark_scoped(int window)
+{
+    int *born;               /* per id: op that allocated it, -1 if none */
+    long count = 0;
+    traceop_t *op;
+    int i, b;
+
+    if ((born = malloc(trace->num_ids * sizeof(int))) == NULL)
+	app_error("Out of memory for the scoped ops");
+    memset(born, 0xff, trace->num_ids * sizeof(int));
+    memset(scoped, 0, trace->num_ops);
+
+    for (i = 0; i < trace->num_ops; i++) {
+	op = &trace->ops[i];
+	switch (op->type) {
+	case ALLOC:
+	case CALLOC:
+	case BALLOC:
+	    born[op->index] = i;
+	    break;
+	case FREE:
+	case BFREE:
+	    b = born[op->index];
+	    if (b >= 0 && b / window == i / window) {
+		scoped[b] = scoped[i] = 1;
+		count++;
+	    }
+	    break;
+	default: /* REALLOC, MEMALIGN */
+	    born[op->index] = -1;
+	    break;
+	}
+    }
+    free(born);
+    return count;
+}
+
+/*
+ * replay - replay the trace on an empty heap, with the scoped blocks
+ *     from an arena that is reset every window ops if arena is set;
+ *     returns the seconds it took
+ */
+static double replay(int window, int arena)
+{
+    mm_arena_t *a = NULL;
+    traceop_t *op;
+    double t;
+    char *p;
+    int i;
+
+    mem_reset_brk();
+    if (mm_init() < 0)
+	app_error("mm_init failed");
+    if (arena && (a = mm_arena_create(chunk)) == NULL)
+	app_error("mm_arena_create failed");
+
+    t = ftimer_now();
+    for (i = 0; i < trace->num_ops; i++) {
+	if (arena && i > 0 && i % window == 0)
+	    mm_arena_reset(a);
+	op = &trace->ops[i];
+	switch (op->type) {
+	case ALLOC:
+	case BALLOC:
+	case CALLOC:
+	    if (arena && scoped[i]) {
+		if ((p = mm_arena_alloc(a, op->size)) != NULL &&
+		    op->type == CALLOC)
+		    memset(p, 0, op->size);
+	    }
+	    else if (op->type == CALLOC)
+		p = mm_calloc(1, op->size);
+	    else
+		p = mm_malloc(op->size);
+	    if (p == NULL)
+		app_error("allocation failed in replay");
+	    trace->blocks[op->index] = p;
+	    break;
+	case MEMALIGN:
+	    if ((p = mm_memalign((size_t)1 << op->lgalign, op->size)) == NULL)
+		app_error("mm_memalign failed in replay");
+	    trace->blocks[op->index] = p;
+	    break;
+	case REALLOC:
+	    if ((p = mm_realloc(trace->blocks[op->index], op->size)) == NULL)
+		app_error("mm_realloc failed in replay");
+	    trace->blocks[op->index] = p;
+	    break;
+	default: /* FREE, BFREE */
+	    if (!arena || !scoped[i])
+		mm_free(trace->blocks[op->index]);
+	    break;
+	}
+    }
+    if (arena)
+	mm_arena_destroy(a);
+    return ftimer_now() - t;
+}
+
+/*
+ * measure - time both replays with windows of window ops and print a
+ *     line
+ */
+static void measure(int window, long allocs)
+{
+    double secs, best[2];
+    size_t heap[2];
+    long count;
+    int arena, r;
+
+    count = mark_scoped(window);
+    for (arena = 0; arena <= 1; arena++) {
+	best[arena] = -1;
+	for (r = 0; r < RUNS; r++)
+	    if ((secs = replay(window, arena)) < best[arena] ||
+		best[arena] < 0)
+		best[arena] = secs;
+	heap[arena] = mem_heapsize();
+    }
+    printf("%8d %7.1f%% %10.1f %10.1f %7.2fx %12lu %12lu\n", window,
+	   allocs ? 100.0 * count / allocs : 0.0,
+	   best[0] * 1e9 / trace->num_ops, best[1] * 1e9 / trace->num_ops,
+	   best[1] > 0 ? best[0] / best[1] : 0.0,
+	   (unsigned long)heap[0], (unsigned long)heap[1]);
+    fflush(stdout);
+}
+
+int main(int argc, char **argv)
+{
+    int c, i, window = 0;
+    long allocs = 0;
+
+    while ((c = getopt(argc, argv, "w:c:h")) != EOF) {
+	switch (c) {
+	case 'w': /* Ops in a request */
+	    window = atoi(optarg);
+	    break;
+	case 'c': /* Arena chunk bytes */
+	    chunk = strtoul(optarg, NULL, 0);
+	    break;
+	case 'h':
+	    usage();
+	    exit(0);
+	default:
+	    usage();
+	    exit(1);
+	}
+    }
+    if (argc - optind != 1 || window < 0) {
+	usage();
+	exit(1);
+    }
+
+    trace = read_trace("", argv[optind]);
+    if ((scoped = malloc(trace->num_ops)) == NULL)
+	app_error("Out of memory for the scoped ops");
+    for (i = 0; i < trace->num_ops; i++)
+	if (trace->ops[i].type == ALLOC || trace->ops[i].type == CALLOC ||
+	    trace->ops[i].type == BALLOC || trace->ops[i].type == MEMALIGN)
+	    allocs++;
+    mem_init();
+
+    printf("%s: %d ops, %ld allocations\n\n", argv[optind],
+	   trace->num_ops, allocs);
+    printf("%8s %8s %10s %10s %8s %12s %12s\n", "window", "scoped",
+	   "free ns/op", "arena", "speedup", "free heap", "arena heap");
+    if (window > 0)
+	measure(window, allocs);
+    else
+	for (window = 100; window <= 100000; window *= 10)
+	    measure(window, allocs);
+
+    mem_deinit();
+    free(scoped);
+    free_trace(trace);
+    exit(0);
+}
+
+/*
+ * app_error - Report an arbitrary application error
+ */
+static void app_error(char *msg)
+{
+    printf("%s\n", msg);
+    exit(1);
+}
+
+/*
+ * usage - Explain the command line arguments
+ */
+static void usage(void)
+{
+    fprintf(stderr, "Usage: arenabench [-h] [-w <window>] [-c <chunk>] <tracefile>\n");
+    fprintf(stderr, "Options\n");
+    fprintf(stderr, "\t-c <chunk>   Bytes in an arena chunk (65536).\n");
+    fprintf(stderr, "\t-h           Print this message.\n");
+    fprintf(stderr, "\t-w <window>  Ops in a request (100 to 100000 by 10x).\n");
+}
@@ -0,0 +1,210 @@
+/*
+ * batchbench.c - cost of batch allocation and free in mm.c
+ *
+ *     unix> batchbench [-r] [-m maxsize] [-k blocks] [-l live] > batch.csv
+ *
+ * At each power of 2 from 16 bytes to maxsize (4096) and each batch
+ * length from 1 to 256, it allocates and frees blocks batch by batch,
+ * the way a request handler does with its objects, two ways:
+ *
+ *   loop        one mm_malloc and one mm_free per block
+ *   batch       one mm_malloc_batch and one mm_free_batch per batch
+ *
+ * Each batch is freed before the next is allocated. To give the fit
+ * search and the coalescing something to do, the heap first gets live
+ * blocks (10000) of random sizes from 16 to 1024 bytes, every other
+ * one of which is freed again. The blocks of a batch are freed in
+ * allocation order, or in random order with -r. About blocks (2^20)
+ * blocks are allocated per measurement; every measurement is repeated
+ * and the fastest run is kept. The output is CSV with one row per
+ * size, batch length and way, the alloc and free times in ns per block.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+
+#include "mm.h"
+#include "memlib.h"
+#include "ftimer.h"
+
+#define MAXBATCH   256        /* longest batch */
+#define RUNS       5          /* runs of each measurement, fastest kept */
+
+static void *blocks[MAXBATCH];         /* the blocks of a batch */
+static size_t maxsize = 4096;          /* largest request */
+static long total = 1 << 20;           /* blocks allocated per run */
+static int live = 10000;               /* blocks in the background heap */
+static int shuffle = 0;                /* -r: free in random order */
+
+/* function prototypes */
+static void usage(void);
+
+/*
+ * fail - report a NULL from mm.c and give up
+ */
+static void fail(char *what, size_t size)
+{
+    fprintf(stderr, "batchbench: %s returned NULL at %lu bytes\n",
+	    what, (unsigned long)size);
+    exit(1);
+}
+
+/*
+ * reset - an empty mm.c heap with the background blocks in it
+ */
+static void reset(void)
+{
+    void *p;
+    int i;
+
+    mem_reset_brk();
+    if (mm_init() < 0) {
+	printf("mm_init failed\n");
+	exit(1);
+    }
+    srand(1);
+    for (i = 0; i < live; i++) {
+	if ((p = mm_malloc(16 + rand() % 1009)) == NULL)
+	    fail("mm_malloc", 0);
+	/* freeing every other block leaves free holes between live ones */
+	if (i % 2 == 1)
+	    mm_free(p);
+    }
+}
+
+/*
+ * mix - put the n blocks in random order
+ */
+static void mix(int n)
+{
+    void *t;
+    int i, j;
+
+    for (i = n - 1; i > 0; i--) {
+	j = rand() % (i + 1);
+	t = blocks[i];
+	blocks[i] = blocks[j];
+	blocks[j] = t;
+    }
+}
+
+/*
+ * run - allocate and free batches of n blocks of size bytes until
+ *     total blocks have been allocated; adds the seconds spent in the
+ *     allocs and in the frees to *alloc_secs and *free_secs
+ */
+static void run(size_t size, int n, int batch, double *alloc_secs,
+		double *free_secs)
+{
+    double t;
+    long done;
+    int i;
+
+    for (done = 0; done < total; done += n) {
+	t = ftimer_now();
+	if (batch) {
+	    if (mm_malloc_batch(size, n, blocks) < (size_t)n)
+		fail("mm_malloc_batch", size);
+	}
+	else
+	    for (i = 0; i < n; i++)
+		if ((blocks[i] = mm_malloc(size)) == NULL)
+		    fail("mm_malloc", size);
+	*alloc_secs += ftimer_now() - t;
+
+	if (shuffle)
+	    mix(n);
+
+	t = ftimer_now();
+	if (batch)
+	    mm_free_batch(blocks, n);
+	else
+	    for (i = 0; i < n; i++)
+		mm_free(blocks[i]);
+	*free_secs += ftimer_now() - t;
+    }
+}
+
+/*
+ * measure - time one way RUNS times and print the fastest in ns per
+ *     block
+ */
+static void measure(size_t size, int n, int batch)
+{
+    double alloc_secs, free_secs, best_alloc = -1, best_free = -1;
+    long blocks_run = (total + n - 1) / n * n;
+    int r;
+
+    for (r = 0; r < RUNS; r++) {
+	reset();
+	alloc_secs = free_secs = 0;
+	run(size, n, batch, &alloc_secs, &free_secs);
+	if (best_alloc < 0 || alloc_secs < best_alloc)
+	    best_alloc = alloc_secs;
+	if (best_free < 0 || free_secs < best_free)
+	    best_free = free_secs;
+    }
+    printf("%lu,%d,%s,%.1f,%.1f\n", (unsigned long)size, n,
+	   batch ? "batch" : "loop", best_alloc * 1e9 / blocks_run,
+	   best_free * 1e9 / blocks_run);
+    fflush(stdout);
+}
+
+int main(int argc, char **argv)
+{
+    int c, n, batch;
+    size_t size;
+
+    while ((c = getopt(argc, argv, "rm:k:l:h")) != EOF) {
+	switch (c) {
+	case 'r': /* Free the blocks of a batch in random order */
+	    shuffle = 1;
+	    break;
+	case 'm': /* Largest request */
+	    maxsize = strtoul(optarg, NULL, 0);
+	    break;
+	case 'k': /* Blocks allocated per run */
+	    total = strtol(optarg, NULL, 0);
+	    break;
+	case 'l': /* Blocks in the background heap */
+	    live = atoi(optarg);
+	    break;
+	case 'h':
+	    usage();
+	    exit(0);
+	default:
+	    usage();
+	    exit(1);
+	}
+    }
+    if (maxsize < 16 || total < 1 || live < 0) {
+	usage();
+	exit(1);
+    }
+
+    mem_init();
+
+    printf("size,batch,way,alloc_ns,free_ns\n");
+    for (size = 16; size <= maxsize; size *= 2)
+	for (n = 1; n <= MAXBATCH; n *= 4)
+	    for (batch = 0; batch <= 1; batch++)
+		measure(size, n, batch);
+
+    mem_deinit();
+    exit(0);
+}
+
+/*
+ * usage - Explain the command line arguments
+ */
+static void usage(void)
+{
+    fprintf(stderr, "Usage: batchbench [-hr] [-m <maxsize>] [-k <blocks>] [-l <live>]\n");
+    fprintf(stderr, "Options\n");
+    fprintf(stderr, "\t-r           Free the blocks of a batch in random order.\n");
+    fprintf(stderr, "\t-m <maxsize> Largest request in bytes (4096).\n");
+    fprintf(stderr, "\t-k <blocks>  Blocks allocated per run (1048576).\n");
+    fprintf(stderr, "\t-l <live>    Blocks in the background heap (10000).\n");
+    fprintf(stderr, "\t-h           Print this message.\n");
+}
@@ -0,0 +1,55 @@
+#ifndef __CACHESIM_H_
+#define __CACHESIM_H_
+
+/*
+ * cachesim.h - count and simulate the allocator's own memory traffic
+ *
+ * When mm.c is built with -DMM_MEMTRACE (make mdriver-memtrace), every
+ * header, footer, list pointer and list head access made through its
+ * access macros goes through MM_TOUCH, which hands the address to the
+ * recorder below. While recording, each access is run through a model
+ * of a set-associative L1 and L2 cache with LRU replacement, and the
+ * cache lines touched are noted, so a trace can be charged the misses
+ * its metadata causes without any noise from the driver or the
+ * payloads. In normal builds MM_TOUCH(p, n) is just (p).
+ */
+#include <stddef.h>
+
+#define CACHE_LINE 64                 /* bytes per line in both levels */
+#ifndef L1_SIZE
+#define L1_SIZE    (32*(1<<10))       /* 32 KB, 8-way */
+#define L1_WAYS    8
+#endif
+#ifndef L2_SIZE
+#define L2_SIZE    (256*(1<<10))      /* 256 KB, 8-way */
+#define L2_WAYS    8
+#endif
+
+/* One level of a set-associative LRU cache */
+typedef struct {
+    int sets;
+    int ways;
+    unsigned long long *tag;          /* sets*ways line numbers */
+    unsigned long long *stamp;        /* when each way was last used */
+    unsigned long long clock;
+    unsigned long long accesses;
+    unsigned long long misses;
+} cache_t;
+
+int cache_init(cache_t *c, int size, int ways);
+void cache_free(cache_t *c);
+int cache_access(cache_t *c, unsigned long long line);
+
+/* The recorder */
+void memtrace_start(void *lo, size_t len);
+void memtrace_stop(void);
+void memtrace_report(int tracenum, int ops);
+void *memtrace_touch(void *p, int n);
+
+#ifdef MM_MEMTRACE
+#define MM_TOUCH(p, n) memtrace_touch((void *)(p), (n))
+#else
+#define MM_TOUCH(p, n) (p)
+#endif
+
+#endif /* __CACHESIM_H_ */
@@ -54,14 +54,23 @@
 #define UTIL_WEIGHT .60
 
 /* 
- * Alignment requirement in bytes (either 4 or 8) 
+ * Alignment requirement in bytes: 8 in the 32-bit build, 16 in the
+ * native 64-bit one (make BITS=64), as the x86-64 ABI asks of malloc
  */
+#ifdef __LP64__
+#define ALIGNMENT 16
+#else
 #define ALIGNMENT 8  
+#endif
 
 /* 
- * Maximum heap size in bytes 
+ * Maximum heap size in bytes. This is only reserved address space;
+ * builds that need a bigger heap (e.g. libmmshim.so, mdriver-big) may
+ * override it.
  */
-#define MAX_HEAP (20*(1<<20))  /* 20 MB */
+#ifndef MAX_HEAP
+#define MAX_HEAP ((size_t)20<<20)  /* 20 MB */
+#endif
 
 /*****************************************************************************
  * Set exactly one of these USE_xxx constants to "1" to select a timing method
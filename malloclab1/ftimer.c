@@ -10,6 +10,7 @@
  */
 #include <stdio.h>
 #include <sys/time.h>
+#include <time.h>
 #include "ftimer.h"
 
 /* function prototypes */
@@ -52,6 +53,17 @@ double ftimer_gettod(ftimer_test_funct f, void *argp, int n)
     return (1E-3*diff);
 }
 
+/*
+ * ftimer_now - Return the current time in seconds from the monotonic
+ * clock. Used by callers that time only selected parts of a run.
+ */
+double ftimer_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + 1E-9*ts.tv_nsec;
+}
 
 /*
  * Routines for manipulating the Unix interval timer
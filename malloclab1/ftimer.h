@@ -12,3 +12,6 @@ double ftimer_itimer(ftimer_test_funct f, void *argp, int n);
    Return the average of n runs */
 double ftimer_gettod(ftimer_test_funct f, void *argp, int n);
 
+/* Current time in seconds from the monotonic clock, for callers that 
+   only want to time part of a run */
+double ftimer_now(void);
@@ -0,0 +1,35 @@
+#ifndef __IDMAP_H_
+#define __IDMAP_H_
+
+/*
+ * idmap.h - a compact hash table from trace ids to live blocks
+ *
+ * Used in place of the per-id blocks/block_sizes arrays when a trace
+ * is replayed without knowing (or being able to afford) num_ids up
+ * front. Only live ids are stored, so the table is sized by the live
+ * set rather than by the number of ids the trace ever uses.
+ */
+#include <stddef.h>
+
+typedef struct {
+    unsigned int id;     /* trace id (IDMAP_EMPTY marks a free slot) */
+    size_t size;         /* payload size requested for this id */
+    int sized;           /* mm_free_sized may free it (IS_SIZED in trace.h) */
+    char *ptr;           /* block returned by the allocator */
+} idmap_entry_t;
+
+typedef struct {
+    idmap_entry_t *slots;  /* open-addressed table, power-of-two size */
+    size_t mask;           /* number of slots - 1 */
+    size_t count;          /* live entries */
+} idmap_t;
+
+#define IDMAP_EMPTY 0xffffffffu
+
+void idmap_init(idmap_t *m);
+void idmap_destroy(idmap_t *m);
+idmap_entry_t *idmap_put(idmap_t *m, unsigned int id);
+idmap_entry_t *idmap_get(idmap_t *m, unsigned int id);
+void idmap_remove(idmap_t *m, unsigned int id);
+
+#endif /* __IDMAP_H_ */
@@ -0,0 +1,259 @@
+/*
+ * magbench.c - scaling of same-size churn with and without magazines
+ *
+ *     unix> magbench [-v] [-t maxthreads] [-s size] [-n ops] [-l live] > mag.csv
+ *
+ * Every thread keeps live (100) blocks of size (64) bytes of its own and,
+ * ops (2^20) times, frees a random one of them and allocates another,
+ * with 1, 2, 4, ... threads up to maxthreads (the number of online CPUs
+ * by default). Three ways:
+ *
+ *   locked      mm_malloc and mm_free behind one global lock, as
+ *               mtreplay runs mm.c
+ *   mag         mm_mag_malloc and mm_mag_free (mmmag.c): magazines per
+ *               thread, with mm.c behind the depots
+ *   libc        the C library's malloc and free
+ *
+ * Every measurement is repeated and the fastest run is kept. The output
+ * is CSV with one row per thread count and way: the aggregate Mops/s
+ * (one op is a free and an alloc) and the scaling efficiency, the
+ * throughput over the thread count times the one thread throughput.
+ * -v prints the depots' statistics to stderr after each mag run.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "mm.h"
+#include "mmmag.h"
+#include "memlib.h"
+#include "ftimer.h"
+
+#define MAXTHREADS 256
+#define RUNS       3          /* runs of each measurement, fastest kept */
+
+enum {LOCKED, MAG, LIBC, NWAYS};
+static char *ways[NWAYS] = {"locked", "mag", "libc"};
+
+static size_t size = 64;      /* bytes in a block */
+static long ops = 1 << 20;    /* replacements per thread */
+static int live = 100;        /* live blocks per thread */
+static int verbose = 0;       /* -v: print the depots' statistics */
+static int way;               /* way being run */
+static double began[MAXTHREADS];   /* per thread: first op, in seconds */
+static double ended[MAXTHREADS];   /* per thread: last op */
+static pthread_barrier_t start;
+static pthread_mutex_t heap_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* function prototypes */
+static void usage(void);
+
+/*
+ * fail - report a NULL from an allocator and give up
+ */
+static void fail(char *what)
+{
+    fprintf(stderr, "magbench: %s returned NULL\n", what);
+    exit(1);
+}
+
+static void *get(void)
+{
+    void *p;
+
+    switch (way) {
+    case LOCKED:
+	pthread_mutex_lock(&heap_lock);
+	p = mm_malloc(size);
+	pthread_mutex_unlock(&heap_lock);
+	break;
+    case MAG:
+	p = mm_mag_malloc(size);
+	break;
+    default:
+	p = malloc(size);
+	break;
+    }
+    if (p == NULL)
+	fail(ways[way]);
+    return p;
+}
+
+static void put(void *p)
+{
+    switch (way) {
+    case LOCKED:
+	pthread_mutex_lock(&heap_lock);
+	mm_free(p);
+	pthread_mutex_unlock(&heap_lock);
+	break;
+    case MAG:
+	mm_mag_free(p);
+	break;
+    default:
+	free(p);
+	break;
+    }
+}
+
+/*
+ * churn - body of a thread: replace random blocks of its own
+ */
+static void *churn(void *arg)
+{
+    int self = (int)(size_t)arg;
+    unsigned int x = self * 2654435761u + 1;
+    void **blocks;
+    long i;
+    int k;
+
+    if ((blocks = malloc(live * sizeof(void *))) == NULL)
+	fail("malloc");
+    for (k = 0; k < live; k++)
+	blocks[k] = get();
+    pthread_barrier_wait(&start);
+
+    began[self] = ftimer_now();
+    for (i = 0; i < ops; i++) {
+	/* xorshift: cheaper than rand() inside the timing */
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	k = x % live;
+	put(blocks[k]);
+	blocks[k] = get();
+    }
+    ended[self] = ftimer_now();
+
+    for (k = 0; k < live; k++)
+	put(blocks[k]);
+    free(blocks);
+    return NULL;
+}
+
+/*
+ * run - the churn on n threads on an empty heap; returns the seconds
+ *     from the first thread's first op to the last thread's last op
+ */
+static double run(int n)
+{
+    pthread_t tids[MAXTHREADS];
+    double first, last;
+    int k;
+
+    mem_reset_brk();
+    if ((way == MAG ? mm_mag_init(0) : mm_init()) < 0) {
+	printf("mm_init failed\n");
+	exit(1);
+    }
+    pthread_barrier_init(&start, NULL, n + 1);
+    for (k = 0; k < n; k++)
+	if (pthread_create(&tids[k], NULL, churn, (void *)(size_t)k) != 0) {
+	    fprintf(stderr, "magbench: pthread_create failed\n");
+	    exit(1);
+	}
+    pthread_barrier_wait(&start);
+    for (k = 0; k < n; k++)
+	pthread_join(tids[k], NULL);
+    pthread_barrier_destroy(&start);
+    first = began[0];
+    last = ended[0];
+    for (k = 1; k < n; k++) {
+	if (began[k] < first)
+	    first = began[k];
+	if (ended[k] > last)
+	    last = ended[k];
+    }
+    return last - first;
+}
+
+/*
+ * next_count - thread count to run after n: the next power of 2, or
+ *     max if that is beyond it
+ */
+static int next_count(int n, int max)
+{
+    return (n < max && n * 2 > max) ? max : n * 2;
+}
+
+int main(int argc, char **argv)
+{
+    double secs, best, base[NWAYS];
+    int c, n, r, maxthreads;
+
+    maxthreads = sysconf(_SC_NPROCESSORS_ONLN);
+    while ((c = getopt(argc, argv, "vt:s:n:l:h")) != EOF) {
+	switch (c) {
+	case 'v': /* Print the depots' statistics */
+	    verbose = 1;
+	    break;
+	case 't': /* Most threads */
+	    maxthreads = atoi(optarg);
+	    break;
+	case 's': /* Bytes in a block */
+	    size = strtoul(optarg, NULL, 0);
+	    break;
+	case 'n': /* Replacements per thread */
+	    ops = strtol(optarg, NULL, 0);
+	    break;
+	case 'l': /* Live blocks per thread */
+	    live = atoi(optarg);
+	    break;
+	case 'h':
+	    usage();
+	    exit(0);
+	default:
+	    usage();
+	    exit(1);
+	}
+    }
+    if (maxthreads < 1 || maxthreads > MAXTHREADS || size < 1 || ops < 1 ||
+	live < 1) {
+	usage();
+	exit(1);
+    }
+
+    mem_init();
+
+    printf("threads,way,mops,efficiency\n");
+    for (n = 1; n <= maxthreads; n = next_count(n, maxthreads))
+	for (way = 0; way < NWAYS; way++) {
+	    best = -1;
+	    for (r = 0; r < RUNS; r++)
+		if ((secs = run(n)) < best || best < 0)
+		    best = secs;
+	    if (n == 1)
+		base[way] = ops / best;
+	    printf("%d,%s,%.2f,%.2f\n", n, ways[way], n * ops / best / 1e6,
+		   (n * ops / best) / (n * base[way]));
+	    fflush(stdout);
+	    if (way == MAG && verbose) {
+		mm_mag_stats_t st;
+
+		mm_mag_stats(&st);
+		fprintf(stderr, "%d threads: %llu fills, %llu full magazines "
+			"out, %llu in, %llu magazines\n", n, st.fills,
+			st.full_out, st.full_in, st.magazines);
+	    }
+	}
+
+    mem_deinit();
+    exit(0);
+}
+
+/*
+ * usage - Explain the command line arguments
+ */
+static void usage(void)
+{
+    fprintf(stderr, "Usage: magbench [-hv] [-t <threads>] [-s <size>] [-n <ops>] [-l <live>]\n");
+    fprintf(stderr, "Options\n");
+    fprintf(stderr, "\t-h           Print this message.\n");
+    fprintf(stderr, "\t-l <live>    Live blocks per thread (100).\n");
+    fprintf(stderr, "\t-n <ops>     Blocks replaced per thread (1048576).\n");
+    fprintf(stderr, "\t-s <size>    Bytes in a block (64).\n");
+    fprintf(stderr, "\t-t <threads> Most threads to run (online CPUs).\n");
+    fprintf(stderr, "\t-v           Print the depots' statistics to stderr.\n");
+}
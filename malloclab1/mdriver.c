@@ -15,11 +15,18 @@
 #include <assert.h>
 #include <float.h>
 #include <time.h>
+#include <stdint.h>
 
 #include "mm.h"
 #include "memlib.h"
 #include "fsecs.h"
 #include "config.h"
+#include "trace.h"
+#include "stream.h"
+#include "idmap.h"
+#include "ftimer.h"
+#include "mmstats.h"
+#include "cachesim.h"
 
 /**********************
  * Constants and macros
@@ -30,38 +37,31 @@
 #define HDRLINES       4 /* number of header lines in a trace file */
 #define LINENUM(i) (i+5) /* cnvt trace request nums to linenums (origin 1) */
 
+/* Bytes between the reads of a block in a -w walk */
+#define WALK_STRIDE 64
+
+/* Most blocks in one mm_malloc_batch or mm_free_batch call */
+#define BATCH_MAX 256
+
 /* Returns true if p is ALIGNMENT-byte aligned */
-#define IS_ALIGNED(p)  ((((unsigned int)(p)) % ALIGNMENT) == 0)
+#define IS_ALIGNED(p)  ((((uintptr_t)(p)) % ALIGNMENT) == 0)
+
+/* Returns true if p is a multiple of align, a power of 2 */
+#define IS_ALIGNED_TO(p, align)  ((((uintptr_t)(p)) & ((align) - 1)) == 0)
 
 /****************************** 
  * The key compound data types 
  *****************************/
 
-/* Records the extent of each block's payload */
+/* Records the extent of each block's payload (one node of the range tree) */
 typedef struct range_t {
     char *lo;              /* low payload address */
     char *hi;              /* high payload address */
-    struct range_t *next;  /* next list element */
+    struct range_t *left;  /* subtree of payloads below lo */
+    struct range_t *right; /* subtree of payloads above hi */
+    int height;            /* height of the subtree rooted here */
 } range_t;
 
-/* Characterizes a single trace operation (allocator request) */
-typedef struct {
-    enum {ALLOC, FREE, REALLOC} type; /* type of request */
-    int index;                        /* index for free() to use later */
-    int size;                         /* byte size of alloc/realloc request */
-} traceop_t;
-
-/* Holds the information for one trace file*/
-typedef struct {
-    int sugg_heapsize;   /* suggested heap size (unused) */
-    int num_ids;         /* number of alloc/realloc ids */
-    int num_ops;         /* number of distinct requests */
-    int weight;          /* weight for this trace (unused) */
-    traceop_t *ops;      /* array of requests */
-    char **blocks;       /* array of ptrs returned by malloc/realloc... */
-    size_t *block_sizes; /* ... and a corresponding array of payload sizes */
-} trace_t;
-
 /* 
  * Holds the params to the xxx_speed functions, which are timed by fcyc. 
  * This struct is necessary because fcyc accepts only a pointer array
@@ -70,6 +70,9 @@ typedef struct {
 typedef struct {
     trace_t *trace;  
     range_t *ranges;
+    int *order;      /* -w: live ids in allocation order (with dead gaps) */
+    int *pos;        /* -w: each live id's place in order, -1 if dead */
+    size_t *size;    /* -w: each live id's payload size */
 } speed_t;
 
 /* Summarizes the important stats for some malloc function on some trace */
@@ -78,6 +81,7 @@ typedef struct {
     double ops;      /* number of ops (malloc/free/realloc) in the trace */
     int valid;       /* was the trace processed correctly by the allocator? */
     double secs;     /* number of secs needed to run the trace */
+    double wsecs;    /* secs for the -w replay that also uses the payloads */
 
     /* defined only for the student malloc package */
     double util;     /* space utilization for this trace (always 0 for libc) */
@@ -85,6 +89,18 @@ typedef struct {
     /* Note: secs and util are only defined if valid is true */
 } stats_t; 
 
+/* Where the bytes of the heap go at one point in a trace (see util_sample) */
+typedef struct {
+    double payload;    /* bytes the trace has asked for and not freed */
+    double heap;       /* size of the heap */
+    double overhead;   /* bytes of allocated blocks outside their payload */
+    double slack;      /* payload room of allocated blocks beyond the request */
+    double fragments;  /* bytes of free blocks below the top block */
+    double wilderness; /* bytes of the free block at the top of the heap */
+    double other;      /* bytes outside any block (prologue, list heads...) */
+    double last_free;  /* scratch: size of the last block seen if free */
+} waste_t;
+
 /********************
  * Global variables
  *******************/
@@ -92,6 +108,26 @@ int verbose = 0;        /* global flag for verbose output */
 static int errors = 0;  /* number of errs found when running student malloc */
 char msg[MAXLINE];      /* for whenever we need to compose an error message */
 
+/* Utilization timeline (set by -u and -n) */
+static FILE *util_csv = NULL;  /* CSV of samples taken by eval_mm_util */
+static int util_every = 0;     /* ops between samples (0: pick per trace) */
+
+/* Replay with application work (set by -w) */
+static int walk_every = 0;     /* ops between walks of the live blocks */
+static int sized_free = 0;     /* -z: free with mm_free_sized */
+static volatile unsigned int walk_sink; /* keeps the walks' reads alive */
+
+/*
+ * Batches in flight (see mm_alloc and mm_dealloc): the blocks of the
+ * last mm_malloc_batch, handed out one per BALLOC op, and the blocks
+ * of the BFREE ops seen so far in a run
+ */
+static void *alloc_batch[BATCH_MAX];
+static traceop_t *alloc_batch_op; /* op the next block is for */
+static int alloc_batch_next, alloc_batch_len;
+static void *free_batch[BATCH_MAX];
+static int free_batch_len;
+
 /* Directory where default tracefiles are found */
 static char tracedir[MAXLINE] = TRACEDIR;
 
@@ -105,28 +141,44 @@ static char *default_tracefiles[] = {
  * Function prototypes 
  *********************/
 
-/* these functions manipulate range lists */
-static int add_range(range_t **ranges, char *lo, int size, 
+/* these functions manipulate the range tree */
+static int add_range(range_t **ranges, char *lo, size_t size, 
 		     int tracenum, int opnum);
 static void remove_range(range_t **ranges, char *lo);
 static void clear_ranges(range_t **ranges);
 
-/* These functions read, allocate, and free storage for traces */
-static trace_t *read_trace(char *tracedir, char *filename);
-static void free_trace(trace_t *trace);
-
 /* Routines for evaluating the correctness and speed of libc malloc */
 static int eval_libc_valid(trace_t *trace, int tracenum);
 static void eval_libc_speed(void *ptr);
+static void eval_libc_work(void *ptr);
 
 /* Routines for evaluating correctnes, space utilization, and speed 
    of the student's malloc package in mm.c */
 static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges);
 static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges);
 static void eval_mm_speed(void *ptr);
+static void eval_mm_work(void *ptr);
+static void util_sample(int tracenum, int opnum, double payload, waste_t *w);
+static void util_print(int tracenum, int opnum, waste_t *w);
+#ifdef MM_STATS
+static void print_mm_stats(int tracenum);
+#endif
+static int eval_mm_stream(char *path, int tracenum, stats_t *stats);
+
+/* Replay with application work, for either package (-w) */
+static double time_work(fsecs_test_funct f, speed_t *speed_params);
+static void work_replay(speed_t *sp, int libc);
+static int work_walk(trace_t *trace, int *order, int *pos, size_t *size,
+		     int n);
 
 /* Various helper routines */
+static void *mm_alloc(traceop_t *ops, int i, int n);
+static void mm_dealloc(traceop_t *ops, int i, int n, void *p, size_t size,
+		       int sized);
+static void *libc_alloc(traceop_t *op);
+static int is_zero(char *p, size_t size);
 static void printresults(int n, stats_t *stats);
+static void printwork(int n, stats_t *stats);
 static void usage(void);
 static void unix_error(char *msg);
 static void malloc_error(int tracenum, int opnum, char *msg);
@@ -150,6 +202,8 @@ int main(int argc, char **argv)
    // int team_check = 1;  /* If set, check team structure (reset by -a) */
     int run_libc = 0;    /* If set, run libc malloc (set by -l) */
     int autograder = 0;  /* If set, emit summary info for autograder (-g) */
+    int stream = 0;      /* If set, stream traces from disk (set by -s) */
+    char path[MAXLINE];  /* full path of a trace when streaming */
 
     /* temporaries used to compute the performance index */
     double secs, ops, util, avg_mm_util, avg_mm_throughput, p1, p2, perfindex;
@@ -158,7 +212,7 @@ int main(int argc, char **argv)
     /* 
      * Read and interpret the command line arguments 
      */
-    while ((c = getopt(argc, argv, "f:t:hvVgal")) != EOF) {
+    while ((c = getopt(argc, argv, "f:t:u:n:w:hvVgalsz")) != EOF) {
         switch (c) {
 	case 'g': /* Generate summary info for the autograder */
 	    autograder = 1;
@@ -184,6 +238,25 @@ int main(int argc, char **argv)
         case 'l': /* Run libc malloc */
             run_libc = 1;
             break;
+        case 's': /* Stream traces instead of loading them */
+            stream = 1;
+            break;
+        case 'z': /* Free with mm_free_sized */
+            sized_free = 1;
+            break;
+	case 'u': /* Write a utilization timeline to a CSV file */
+	    if ((util_csv = fopen(optarg, "w")) == NULL)
+		unix_error("Could not create the -u file");
+	    fprintf(util_csv, "trace,op,payload,heap,free,overhead,slack,"
+		    "fragments,wilderness,other\n");
+	    break;
+	case 'n': /* Ops between utilization samples */
+	    util_every = atoi(optarg);
+	    break;
+	case 'w': /* Also time a replay that writes and walks the payloads */
+	    if ((walk_every = atoi(optarg)) < 1)
+		app_error("-w needs a positive number of ops");
+	    break;
         case 'v': /* Print per-trace performance breakdown */
             verbose = 1;
             break;
@@ -263,6 +336,9 @@ int main(int argc, char **argv)
 		if (verbose > 1)
 		    printf("and performance.\n");
 		libc_stats[i].secs = fsecs(eval_libc_speed, &speed_params);
+		if (walk_every)
+		    libc_stats[i].wsecs = time_work(eval_libc_work,
+						    &speed_params);
 	    }
 	    free_trace(trace);
 	}
@@ -272,6 +348,10 @@ int main(int argc, char **argv)
 	    printf("\nResults for libc malloc:\n");
 	    printresults(num_tracefiles, libc_stats);
 	}
+	if (walk_every) {
+	    printf("\nlibc malloc with payload work (-w %d):\n", walk_every);
+	    printwork(num_tracefiles, libc_stats);
+	}
     }
 
     /*
@@ -290,6 +370,14 @@ int main(int argc, char **argv)
 
     /* Evaluate student's mm malloc package using the K-best scheme */
     for (i=0; i < num_tracefiles; i++) {
+	if (stream) {
+	    strcpy(path, tracedir);
+	    strcat(path, tracefiles[i]);
+	    if (verbose > 1)
+		printf("Streaming tracefile: %s\n", tracefiles[i]);
+	    mm_stats[i].valid = eval_mm_stream(path, i, &mm_stats[i]);
+	    continue;
+	}
 	trace = read_trace(tracedir, tracefiles[i]);
 	mm_stats[i].ops = trace->num_ops;
 	if (verbose > 1)
@@ -298,12 +386,27 @@ int main(int argc, char **argv)
 	if (mm_stats[i].valid) {
 	    if (verbose > 1)
 		printf("efficiency, ");
+#ifdef MM_STATS
+	    memset(&mm_counters, 0, sizeof(mm_counters));
+#endif
 	    mm_stats[i].util = eval_mm_util(trace, i, &ranges);
+#ifdef MM_STATS
+	    print_mm_stats(i);
+#endif
 	    speed_params.trace = trace;
 	    speed_params.ranges = ranges;
 	    if (verbose > 1)
 		printf("and performance.\n");
 	    mm_stats[i].secs = fsecs(eval_mm_speed, &speed_params);
+	    if (walk_every)
+		mm_stats[i].wsecs = time_work(eval_mm_work, &speed_params);
+#ifdef MM_MEMTRACE
+	    /* One more replay, with mm.c's metadata accesses recorded */
+	    memtrace_start(mem_heap_lo(), MAX_HEAP);
+	    eval_mm_speed(&speed_params);
+	    memtrace_stop();
+	    memtrace_report(i, trace->num_ops);
+#endif
 	}
 	free_trace(trace);
     }
@@ -314,6 +417,11 @@ int main(int argc, char **argv)
 	printresults(num_tracefiles, mm_stats);
 	printf("\n");
     }
+    if (walk_every) {
+	printf("mm malloc with payload work (-w %d):\n", walk_every);
+	printwork(num_tracefiles, mm_stats);
+	printf("\n");
+    }
 
     /* 
      * Accumulate the aggregate statistics for the student's mm package 
@@ -362,24 +470,145 @@ int main(int argc, char **argv)
 	printf("correct:%d\n", numcorrect);
 	printf("perfidx:%.0f\n", perfindex);
     }
+    if (util_csv != NULL)
+	fclose(util_csv);
 
     exit(0);
 }
 
 
 /*****************************************************************
- * The following routines manipulate the range list, which keeps 
+ * The following routines manipulate the range tree, which keeps 
  * track of the extent of every allocated block payload. We use the 
- * range list to detect any overlapping allocated blocks.
+ * range tree to detect any overlapping allocated blocks.
+ *
+ * The tree is an AVL tree keyed by the low payload address. Since
+ * the payloads it holds never overlap, ordering them by lo also
+ * orders them by hi, so an overlap check, an insertion and a removal
+ * each cost O(log n) in the number of live blocks.
  ****************************************************************/
 
+/* range_height - height of the subtree rooted at p (0 if empty) */
+static int range_height(range_t *p)
+{
+    return (p == NULL) ? 0 : p->height;
+}
+
+/* range_fixheight - recompute the height of p from its children */
+static void range_fixheight(range_t *p)
+{
+    int hl = range_height(p->left);
+    int hr = range_height(p->right);
+
+    p->height = ((hl > hr) ? hl : hr) + 1;
+}
+
+/* range_rotright - rotate the subtree rooted at p to the right */
+static range_t *range_rotright(range_t *p)
+{
+    range_t *q = p->left;
+
+    p->left = q->right;
+    q->right = p;
+    range_fixheight(p);
+    range_fixheight(q);
+    return q;
+}
+
+/* range_rotleft - rotate the subtree rooted at q to the left */
+static range_t *range_rotleft(range_t *q)
+{
+    range_t *p = q->right;
+
+    q->right = p->left;
+    p->left = q;
+    range_fixheight(q);
+    range_fixheight(p);
+    return p;
+}
+
+/* range_balance - restore the AVL invariant at p, return the new root */
+static range_t *range_balance(range_t *p)
+{
+    range_fixheight(p);
+    if (range_height(p->right) - range_height(p->left) == 2) {
+	if (range_height(p->right->right) < range_height(p->right->left))
+	    p->right = range_rotright(p->right);
+	return range_rotleft(p);
+    }
+    if (range_height(p->left) - range_height(p->right) == 2) {
+	if (range_height(p->left->left) < range_height(p->left->right))
+	    p->left = range_rotleft(p->left);
+	return range_rotright(p);
+    }
+    return p;
+}
+
+/* range_insert - insert node r into the subtree rooted at p */
+static range_t *range_insert(range_t *p, range_t *r)
+{
+    if (p == NULL)
+	return r;
+    if (r->lo < p->lo)
+	p->left = range_insert(p->left, r);
+    else
+	p->right = range_insert(p->right, r);
+    return range_balance(p);
+}
+
+/* range_unlinkmin - detach the leftmost node of the subtree rooted at p */
+static range_t *range_unlinkmin(range_t *p, range_t **minp)
+{
+    if (p->left == NULL) {
+	*minp = p;
+	return p->right;
+    }
+    p->left = range_unlinkmin(p->left, minp);
+    return range_balance(p);
+}
+
+/* range_delete - free the node whose payload starts at lo, if any */
+static range_t *range_delete(range_t *p, char *lo)
+{
+    range_t *l, *r, *min;
+
+    if (p == NULL)
+	return NULL;
+    if (lo < p->lo)
+	p->left = range_delete(p->left, lo);
+    else if (lo > p->lo)
+	p->right = range_delete(p->right, lo);
+    else {
+	l = p->left;
+	r = p->right;
+	free(p);
+	if (r == NULL)
+	    return l;
+	r = range_unlinkmin(r, &min);
+	min->left = l;
+	min->right = r;
+	return range_balance(min);
+    }
+    return range_balance(p);
+}
+
+/* range_freeall - free every node in the subtree rooted at p */
+static void range_freeall(range_t *p)
+{
+    if (p == NULL)
+	return;
+    range_freeall(p->left);
+    range_freeall(p->right);
+    free(p);
+}
+
 /*
  * add_range - As directed by request opnum in trace tracenum,
  *     we've just called the student's mm_malloc to allocate a block of 
  *     size bytes at addr lo. After checking the block for correctness,
- *     we create a range struct for this block and add it to the range list. 
+ *     we create a range struct for this block and add it to the range tree. 
  */
-static int add_range(range_t **ranges, char *lo, int size, 
+static int add_range(range_t **ranges, char *lo, size_t size, 
 		     int tracenum, int opnum)
 {
     char *hi = lo + size - 1;
@@ -405,10 +634,18 @@ static int add_range(range_t **ranges, char *lo, int size,
         return 0;
     }
 
-    /* The payload must not overlap any other payloads */
-    for (p = *ranges;  p != NULL;  p = p->next) {
-        if ((lo >= p->lo && lo <= p-> hi) ||
-            (hi >= p->lo && hi <= p->hi)) {
+    /* 
+     * The payload must not overlap any other payloads. Any range
+     * that ends before lo lies to the left, and any range that
+     * starts after hi lies to the right, so at most one path from
+     * the root has to be searched.
+     */
+    for (p = *ranges;  p != NULL; ) {
+	if (hi < p->lo)
+	    p = p->left;
+	else if (lo > p->hi)
+	    p = p->right;
+	else {
 	    sprintf(msg, "Payload (%p:%p) overlaps another payload (%p:%p)\n",
 		    lo, hi, p->lo, p->hi);
 	    malloc_error(tracenum, opnum, msg);
@@ -418,14 +655,16 @@ static int add_range(range_t **ranges, char *lo, int size,
 
     /* 
      * Everything looks OK, so remember the extent of this block 
-     * by creating a range struct and adding it the range list.
+     * by creating a range struct and adding it the range tree.
      */
     if ((p = (range_t *)malloc(sizeof(range_t))) == NULL)
 	unix_error("malloc error in add_range");
-    p->next = *ranges;
     p->lo = lo;
     p->hi = hi;
-    *ranges = p;
+    p->left = NULL;
+    p->right = NULL;
+    p->height = 1;
+    *ranges = range_insert(*ranges, p);
     return 1;
 }
 
@@ -434,19 +673,7 @@ static int add_range(range_t **ranges, char *lo, int size,
  */
 static void remove_range(range_t **ranges, char *lo)
 {
-    range_t *p;
-    range_t **prevpp = ranges;
-    int size;
-
-    for (p = *ranges;  p != NULL; p = p->next) {
-        if (p->lo == lo) {
-	    *prevpp = p->next;
-            size = p->hi - p->lo + 1;
-            free(p);
-            break;
-        }
-        prevpp = &(p->next);
-    }
+    *ranges = range_delete(*ranges, lo);
 }
 
 /*
@@ -454,119 +681,11 @@ static void remove_range(range_t **ranges, char *lo)
  */
 static void clear_ranges(range_t **ranges)
 {
-    range_t *p;
-    range_t *pnext;
-
-    for (p = *ranges;  p != NULL;  p = pnext) {
-        pnext = p->next;
-        free(p);
-    }
+    range_freeall(*ranges);
     *ranges = NULL;
 }
 
 
-/**********************************************
- * The following routines manipulate tracefiles
- *********************************************/
-
-/*
- * read_trace - read a trace file and store it in memory
- */
-static trace_t *read_trace(char *tracedir, char *filename)
-{
-    FILE *tracefile;
-    trace_t *trace;
-    char type[MAXLINE];
-    char path[MAXLINE];
-    unsigned index, size;
-    unsigned max_index = 0;
-    unsigned op_index;
-
-    if (verbose > 1)
-	printf("Reading tracefile: %s\n", filename);
-
-    /* Allocate the trace record */
-    if ((trace = (trace_t *) malloc(sizeof(trace_t))) == NULL)
-	unix_error("malloc 1 failed in read_trance");
-	
-    /* Read the trace file header */
-    strcpy(path, tracedir);
-    strcat(path, filename);
-    if ((tracefile = fopen(path, "r")) == NULL) {
-	sprintf(msg, "Could not open %s in read_trace", path);
-	unix_error(msg);
-    }
-    fscanf(tracefile, "%d", &(trace->sugg_heapsize)); /* not used */
-    fscanf(tracefile, "%d", &(trace->num_ids));     
-    fscanf(tracefile, "%d", &(trace->num_ops));     
-    fscanf(tracefile, "%d", &(trace->weight));        /* not used */
-    
-    /* We'll store each request line in the trace in this array */
-    if ((trace->ops = 
-	 (traceop_t *)malloc(trace->num_ops * sizeof(traceop_t))) == NULL)
-	unix_error("malloc 2 failed in read_trace");
-
-    /* We'll keep an array of pointers to the allocated blocks here... */
-    if ((trace->blocks = 
-	 (char **)malloc(trace->num_ids * sizeof(char *))) == NULL)
-	unix_error("malloc 3 failed in read_trace");
-
-    /* ... along with the corresponding byte sizes of each block */
-    if ((trace->block_sizes = 
-	 (size_t *)malloc(trace->num_ids * sizeof(size_t))) == NULL)
-	unix_error("malloc 4 failed in read_trace");
-    
-    /* read every request line in the trace file */
-    index = 0;
-    op_index = 0;
-    while (fscanf(tracefile, "%s", type) != EOF) {
-	switch(type[0]) {
-	case 'a':
-	    fscanf(tracefile, "%u %u", &index, &size);
-	    trace->ops[op_index].type = ALLOC;
-	    trace->ops[op_index].index = index;
-	    trace->ops[op_index].size = size;
-	    max_index = (index > max_index) ? index : max_index;
-	    break;
-	case 'r':
-	    fscanf(tracefile, "%u %u", &index, &size);
-	    trace->ops[op_index].type = REALLOC;
-	    trace->ops[op_index].index = index;
-	    trace->ops[op_index].size = size;
-	    max_index = (index > max_index) ? index : max_index;
-	    break;
-	case 'f':
-	    fscanf(tracefile, "%ud", &index);
-	    trace->ops[op_index].type = FREE;
-	    trace->ops[op_index].index = index;
-	    break;
-	default:
-	    printf("Bogus type character (%c) in tracefile %s\n", 
-		   type[0], path);
-	    exit(1);
-	}
-	op_index++;
-	
-    }
-    fclose(tracefile);
-    assert(max_index == trace->num_ids - 1);
-    assert(trace->num_ops == op_index);
-    
-    return trace;
-}
-
-/*
- * free_trace - Free the trace record and the three arrays it points
- *              to, all of which were allocated in read_trace().
- */
-void free_trace(trace_t *trace)
-{
-    free(trace->ops);         /* free the three arrays... */
-    free(trace->blocks);      
-    free(trace->block_sizes);
-    free(trace);              /* and the trace record itself... */
-}
-
 /**********************************************************************
  * The following functions evaluate the correctness, space utilization,
  * and throughput of the libc and mm malloc packages.
@@ -577,15 +696,16 @@ void free_trace(trace_t *trace)
  */
 static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges) 
 {
-    int i, j;
+    int i;
+    size_t j;
     int index;
-    int size;
-    int oldsize;
+    size_t size;
+    size_t oldsize;
     char *newp;
     char *oldp;
     char *p;
     
-    /* Reset the heap and free any records in the range list */
+    /* Reset the heap and free any records in the range tree */
     mem_reset_brk();
     clear_ranges(ranges);
 
@@ -603,16 +723,33 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
         switch (trace->ops[i].type) {
 
         case ALLOC: /* mm_malloc */
+        case MEMALIGN: /* mm_memalign */
+        case CALLOC: /* mm_calloc */
+        case BALLOC: /* mm_malloc_batch */
 
 	    /* Call the student's malloc */
-	    if ((p = mm_malloc(size)) == NULL) {
+	    if ((p = mm_alloc(trace->ops, i, trace->num_ops)) == NULL) {
 		malloc_error(tracenum, i, "mm_malloc failed.");
 		return 0;
 	    }
+
+	    /* An aligned block must also be at the alignment asked for */
+	    if (!IS_ALIGNED_TO(p, (size_t)1 << trace->ops[i].lgalign)) {
+		malloc_error(tracenum, i,
+			     "mm_memalign returned a misaligned block");
+		return 0;
+	    }
+
+	    /* A calloc'd block must read as zero */
+	    if (trace->ops[i].type == CALLOC && !is_zero(p, size)) {
+		malloc_error(tracenum, i,
+			     "mm_calloc returned a block that is not zero");
+		return 0;
+	    }
 	    
 	    /* 
 	     * Test the range of the new block for correctness and add it 
-	     * to the range list if OK. The block must be  be aligned properly,
+	     * to the range tree if OK. The block must be  be aligned properly,
 	     * and must not overlap any currently allocated block. 
 	     */ 
 	    if (add_range(ranges, p, size, tracenum, i) == 0)
@@ -628,6 +765,7 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
 	    /* Remember region */
 	    trace->blocks[index] = p;
 	    trace->block_sizes[index] = size;
+	    trace->block_sized[index] = IS_SIZED(trace->ops[i].type);
 	    break;
 
         case REALLOC: /* mm_realloc */
@@ -639,10 +777,10 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
 		return 0;
 	    }
 	    
-	    /* Remove the old region from the range list */
+	    /* Remove the old region from the range tree */
 	    remove_range(ranges, oldp);
 	    
-	    /* Check new block for correctness and add it to range list */
+	    /* Check new block for correctness and add it to range tree */
 	    if (add_range(ranges, newp, size, tracenum, i) == 0)
 		return 0;
 	    
@@ -654,7 +792,7 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
 	    oldsize = trace->block_sizes[index];
 	    if (size < oldsize) oldsize = size;
 	    for (j = 0; j < oldsize; j++) {
-	      if (newp[j] != (index & 0xFF)) {
+	      if ((unsigned char)newp[j] != (index & 0xFF)) {
 		malloc_error(tracenum, i, "mm_realloc did not preserve the "
 			     "data from old block");
 		return 0;
@@ -665,14 +803,17 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
 	    /* Remember region */
 	    trace->blocks[index] = newp;
 	    trace->block_sizes[index] = size;
+	    trace->block_sized[index] = 0;
 	    break;
 
         case FREE: /* mm_free */
+        case BFREE: /* mm_free_batch */
 	    
 	    /* Remove region from list and call student's free function */
 	    p = trace->blocks[index];
 	    remove_range(ranges, p);
-	    mm_free(p);
+	    mm_dealloc(trace->ops, i, trace->num_ops, p,
+		       trace->block_sizes[index], trace->block_sized[index]);
 	    break;
 
 	default:
@@ -700,30 +841,47 @@ static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
 {   
     int i;
     int index;
-    int size, newsize, oldsize;
-    int max_total_size = 0;
-    int total_size = 0;
+    size_t size, newsize, oldsize;
+    size_t max_total_size = 0;
+    size_t total_size = 0;
     char *p;
     char *newp, *oldp;
+    int every = util_every, peak_op = -1;
+    waste_t w, peak = {0};
 
     /* initialize the heap and the mm malloc package */
     mem_reset_brk();
     if (mm_init() < 0)
 	app_error("mm_init failed in eval_mm_util");
 
+    /* By default take about a thousand samples per trace */
+    if (every <= 0)
+	every = (trace->num_ops >= 1000) ? trace->num_ops / 1000 : 1;
+
     for (i = 0;  i < trace->num_ops;  i++) {
+	if (util_csv != NULL && i % every == 0) {
+	    util_sample(tracenum, i, total_size, &w);
+	    if (peak_op < 0 || w.payload > peak.payload) {
+		peak = w;
+		peak_op = i;
+	    }
+	}
         switch (trace->ops[i].type) {
 
         case ALLOC: /* mm_alloc */
+        case MEMALIGN: /* mm_memalign */
+        case CALLOC: /* mm_calloc */
+        case BALLOC: /* mm_malloc_batch */
 	    index = trace->ops[i].index;
 	    size = trace->ops[i].size;
 
-	    if ((p = mm_malloc(size)) == NULL) 
+	    if ((p = mm_alloc(trace->ops, i, trace->num_ops)) == NULL) 
 		app_error("mm_malloc failed in eval_mm_util");
 	    
 	    /* Remember region and size */
 	    trace->blocks[index] = p;
 	    trace->block_sizes[index] = size;
+	    trace->block_sized[index] = IS_SIZED(trace->ops[i].type);
 	    
 	    /* Keep track of current total size
 	     * of all allocated blocks */
@@ -746,6 +904,7 @@ static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
 	    /* Remember region and size */
 	    trace->blocks[index] = newp;
 	    trace->block_sizes[index] = newsize;
+	    trace->block_sized[index] = 0;
 	    
 	    /* Keep track of current total size
 	     * of all allocated blocks */
@@ -757,11 +916,13 @@ static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
 	    break;
 
         case FREE: /* mm_free */
+        case BFREE: /* mm_free_batch */
 	    index = trace->ops[i].index;
 	    size = trace->block_sizes[index];
 	    p = trace->blocks[index];
 	    
-	    mm_free(p);
+	    mm_dealloc(trace->ops, i, trace->num_ops, p, size,
+		       trace->block_sized[index]);
 	    
 	    /* Keep track of current total size
 	     * of all allocated blocks */
@@ -775,9 +936,74 @@ static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
         }
     }
 
+    if (util_csv != NULL) {
+	util_sample(tracenum, i, total_size, &w);
+	if (verbose && peak_op >= 0)
+	    util_print(tracenum, peak_op, &peak);
+    }
     return ((double)max_total_size / (double)mem_heapsize());
 }
 
+/*
+ * util_walk - mm_heap_walk callback that sorts each block into a waste_t
+ */
+static void util_walk(void *bp, size_t blocksize, size_t usable,
+		      int alloc, void *arg)
+{
+    waste_t *w = (waste_t *)arg;
+
+    if (alloc) {
+	w->overhead += blocksize - usable;
+	w->slack += usable;
+	w->last_free = 0;
+    }
+    else {
+	w->fragments += blocksize;
+	w->last_free = blocksize;
+    }
+}
+
+/*
+ * util_sample - walk the heap after opnum ops of a trace, break down
+ *    where its bytes go, and append the result to the -u file. Every
+ *    heap byte lands in exactly one category: payload + slack +
+ *    overhead make up the allocated blocks, fragments + wilderness the
+ *    free ones, and other is whatever no block covers.
+ */
+static void util_sample(int tracenum, int opnum, double payload, waste_t *w)
+{
+    memset(w, 0, sizeof(waste_t));
+    mm_heap_walk(util_walk, w);
+
+    w->payload = payload;
+    w->heap = mem_heapsize();
+    w->slack -= payload;              /* slack held all usable bytes */
+    w->fragments -= w->last_free;     /* the top free block, if any */
+    w->wilderness = w->last_free;
+    w->other = w->heap - w->payload - w->slack - w->overhead -
+	w->fragments - w->wilderness;
+
+    fprintf(util_csv, "%d,%d,%.0f,%.0f,%.0f,%.0f,%.0f,%.0f,%.0f,%.0f\n",
+	    tracenum, opnum, w->payload, w->heap,
+	    w->fragments + w->wilderness, w->overhead, w->slack,
+	    w->fragments, w->wilderness, w->other);
+}
+
+/*
+ * util_print - print the breakdown of a trace's heap at one sample
+ */
+static void util_print(int tracenum, int opnum, waste_t *w)
+{
+    double h = (w->heap > 0) ? w->heap / 100.0 : 1;
+
+    printf("trace %d at peak payload (op %d), heap %.0f bytes:\n",
+	   tracenum, opnum, w->heap);
+    printf("  payload %5.1f%%  overhead %5.1f%%  slack %5.1f%%  "
+	   "fragments %5.1f%%  wilderness %5.1f%%  other %5.1f%%\n",
+	   w->payload / h, w->overhead / h, w->slack / h,
+	   w->fragments / h, w->wilderness / h, w->other / h);
+}
+
 
 /*
  * eval_mm_speed - This is the function that is used by fcyc()
@@ -785,7 +1011,8 @@ static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
  */
 static void eval_mm_speed(void *ptr)
 {
-    int i, index, size, newsize;
+    int i, index;
+    size_t newsize;
     char *p, *newp, *oldp, *block;
     trace_t *trace = ((speed_t *)ptr)->trace;
 
@@ -799,11 +1026,15 @@ static void eval_mm_speed(void *ptr)
         switch (trace->ops[i].type) {
 
         case ALLOC: /* mm_malloc */
+        case MEMALIGN: /* mm_memalign */
+        case CALLOC: /* mm_calloc */
+        case BALLOC: /* mm_malloc_batch */
             index = trace->ops[i].index;
-            size = trace->ops[i].size;
-            if ((p = mm_malloc(size)) == NULL)
+            if ((p = mm_alloc(trace->ops, i, trace->num_ops)) == NULL)
 		app_error("mm_malloc error in eval_mm_speed");
             trace->blocks[index] = p;
+            trace->block_sizes[index] = trace->ops[i].size;
+            trace->block_sized[index] = IS_SIZED(trace->ops[i].type);
             break;
 
 	case REALLOC: /* mm_realloc */
@@ -813,12 +1044,16 @@ static void eval_mm_speed(void *ptr)
             if ((newp = mm_realloc(oldp,newsize)) == NULL)
 		app_error("mm_realloc error in eval_mm_speed");
             trace->blocks[index] = newp;
+            trace->block_sizes[index] = newsize;
+            trace->block_sized[index] = 0;
             break;
 
         case FREE: /* mm_free */
+        case BFREE: /* mm_free_batch */
             index = trace->ops[i].index;
             block = trace->blocks[index];
-            mm_free(block);
+            mm_dealloc(trace->ops, i, trace->num_ops, block,
+		       trace->block_sizes[index], trace->block_sized[index]);
             break;
 
 	default:
@@ -826,6 +1061,122 @@ static void eval_mm_speed(void *ptr)
         }
 }
 
+/*
+ * eval_mm_stream - Replay a trace of any size against the mm package in
+ *    a single pass while a background thread reads it from disk. Only
+ *    the time spent in the replay loop is counted, so stalls waiting for
+ *    the reader are excluded. Live blocks are tracked in an idmap rather
+ *    than in arrays sized by num_ids. There is no correctness check;
+ *    utilization is computed as in eval_mm_util.
+ */
+static int eval_mm_stream(char *path, int tracenum, stats_t *stats)
+{
+    stream_t s;
+    idmap_t ids;
+    idmap_entry_t *e;
+    traceop_t *ops;
+    int i, n;
+    size_t size;
+    int opnum = 0;
+    int ok = 0;
+    double start, stall = 0, secs = 0;
+    double total_size = 0, max_total_size = 0;
+    char *p;
+
+    if (stream_open(&s, path) < 0) {
+	sprintf(msg, "Could not stream %s", path);
+	unix_error(msg);
+    }
+    idmap_init(&ids);
+
+    /* Reset the heap and initialize the mm package */
+    mem_reset_brk();
+    if (mm_init() < 0) {
+	malloc_error(tracenum, 0, "mm_init failed.");
+	goto out;
+    }
+
+    for (;;) {
+	start = ftimer_now();
+	ops = stream_next(&s, &n);
+	stall += ftimer_now() - start;
+	if (ops == NULL)
+	    break;
+
+	start = ftimer_now();
+	for (i = 0; i < n; i++) {
+	    size = ops[i].size;
+	    switch (ops[i].type) {
+
+	    case ALLOC: /* mm_malloc */
+	    case MEMALIGN: /* mm_memalign */
+	    case CALLOC: /* mm_calloc */
+	    case BALLOC: /* mm_malloc_batch */
+		if ((p = mm_alloc(ops, i, n)) == NULL) {
+		    malloc_error(tracenum, opnum + i, "mm_malloc failed.");
+		    goto out;
+		}
+		e = idmap_put(&ids, ops[i].index);
+		e->ptr = p;
+		e->size = size;
+		e->sized = IS_SIZED(ops[i].type);
+		total_size += size;
+		break;
+
+	    case REALLOC: /* mm_realloc */
+		if ((e = idmap_get(&ids, ops[i].index)) == NULL) {
+		    malloc_error(tracenum, opnum + i, "realloc of a dead id");
+		    goto out;
+		}
+		total_size -= e->size;
+		if ((p = mm_realloc(e->ptr, size)) == NULL) {
+		    malloc_error(tracenum, opnum + i, "mm_realloc failed.");
+		    goto out;
+		}
+		e->ptr = p;
+		e->size = size;
+		e->sized = 0;
+		total_size += size;
+		break;
+
+	    case FREE: /* mm_free */
+	    case BFREE: /* mm_free_batch */
+		if ((e = idmap_get(&ids, ops[i].index)) == NULL) {
+		    malloc_error(tracenum, opnum + i, "free of a dead id");
+		    goto out;
+		}
+		mm_dealloc(ops, i, n, e->ptr, e->size, e->sized);
+		total_size -= e->size;
+		idmap_remove(&ids, ops[i].index);
+		break;
+
+	    default:
+		app_error("Nonexistent request type in eval_mm_stream");
+	    }
+	    if (total_size > max_total_size)
+		max_total_size = total_size;
+	}
+	secs += ftimer_now() - start;
+	opnum += n;
+    }
+    ok = 1;
+
+ out:
+    if (stream_close(&s) < 0 && ok) {
+	sprintf(msg, "Malformed tracefile %s", path);
+	app_error(msg);
+    }
+    idmap_destroy(&ids);
+
+    if (verbose > 1)
+	printf("%d ops in %.6f secs, %.6f secs stalled on trace input\n",
+	       opnum, secs, stall);
+    stats->ops = opnum;
+    stats->secs = secs;
+    stats->util = max_total_size / (double)mem_heapsize();
+    return ok;
+}
+
 /*
  * eval_libc_valid - We run this function to make sure that the
  *    libc malloc can run to completion on the set of traces.
@@ -834,14 +1185,18 @@ static void eval_mm_speed(void *ptr)
  */
 static int eval_libc_valid(trace_t *trace, int tracenum)
 {
-    int i, newsize;
+    int i;
+    size_t newsize;
     char *p, *newp, *oldp;
 
     for (i = 0;  i < trace->num_ops;  i++) {
         switch (trace->ops[i].type) {
 
         case ALLOC: /* malloc */
-	    if ((p = malloc(trace->ops[i].size)) == NULL) {
+        case MEMALIGN: /* posix_memalign */
+        case CALLOC: /* calloc */
+        case BALLOC: /* malloc */
+	    if ((p = libc_alloc(&trace->ops[i])) == NULL) {
 		malloc_error(tracenum, i, "libc malloc failed");
 		unix_error("System message");
 	    }
@@ -859,6 +1214,7 @@ static int eval_libc_valid(trace_t *trace, int tracenum)
 	    break;
 	    
         case FREE: /* free */
+        case BFREE: /* free */
 	    free(trace->blocks[trace->ops[i].index]);
 	    break;
 
@@ -878,16 +1234,19 @@ static int eval_libc_valid(trace_t *trace, int tracenum)
 static void eval_libc_speed(void *ptr)
 {
     int i;
-    int index, size, newsize;
+    int index;
+    size_t newsize;
     char *p, *newp, *oldp, *block;
     trace_t *trace = ((speed_t *)ptr)->trace;
 
     for (i = 0;  i < trace->num_ops;  i++) {
         switch (trace->ops[i].type) {
         case ALLOC: /* malloc */
+        case MEMALIGN: /* posix_memalign */
+        case CALLOC: /* calloc */
+        case BALLOC: /* malloc */
 	    index = trace->ops[i].index;
-	    size = trace->ops[i].size;
-	    if ((p = malloc(size)) == NULL)
+	    if ((p = libc_alloc(&trace->ops[i])) == NULL)
 		unix_error("malloc failed in eval_libc_speed");
 	    trace->blocks[index] = p;
 	    break;
@@ -903,6 +1262,7 @@ static void eval_libc_speed(void *ptr)
 	    break;
 	    
         case FREE: /* free */
+        case BFREE: /* free */
 	    index = trace->ops[i].index;
 	    block = trace->blocks[index];
 	    free(block);
@@ -911,10 +1271,292 @@ static void eval_libc_speed(void *ptr)
     }
 }
 
+/*****************************************************************
+ * The following routines time a replay that also does the work of
+ * an application with its memory (-w). eval_xx_speed never touches
+ * the payloads, so an allocator that scatters blocks used together
+ * over many lines and pages looks as fast as one that packs them.
+ * Here each alloc and realloc writes its whole payload, and every
+ * walk_every ops all live blocks are read, one byte per WALK_STRIDE,
+ * in the order they were allocated.
+ ****************************************************************/
+
+/*
+ * time_work - Time one of the xx_work routines on speed_params->trace,
+ *    with the bookkeeping arrays allocated outside the timed region
+ */
+static double time_work(fsecs_test_funct f, speed_t *speed_params)
+{
+    trace_t *trace = speed_params->trace;
+    double secs;
+
+    speed_params->order = malloc(trace->num_ops * sizeof(int));
+    speed_params->pos = malloc(trace->num_ids * sizeof(int));
+    speed_params->size = malloc(trace->num_ids * sizeof(size_t));
+    if (speed_params->order == NULL || speed_params->pos == NULL ||
+	speed_params->size == NULL)
+	unix_error("malloc failed in time_work");
+    secs = fsecs(f, speed_params);
+    free(speed_params->order);
+    free(speed_params->pos);
+    free(speed_params->size);
+    return secs;
+}
+
+/*
+ * eval_mm_work - This is the function that is used by fcyc()
+ *    to time the mm malloc package with payload work
+ */
+static void eval_mm_work(void *ptr)
+{
+    mem_reset_brk();
+    if (mm_init() < 0)
+	app_error("mm_init failed in eval_mm_work");
+    work_replay((speed_t *)ptr, 0);
+}
+
+/*
+ * eval_libc_work - This is the function that is used by fcyc()
+ *    to time the libc malloc package with payload work
+ */
+static void eval_libc_work(void *ptr)
+{
+    work_replay((speed_t *)ptr, 1);
+}
+
+/*
+ * work_replay - Replay a trace on mm malloc or libc malloc, writing
+ *    each payload as it is allocated and walking the live blocks every
+ *    walk_every ops. Blocks the trace leaves allocated are freed at the
+ *    end when running libc, since its heap is not reset between runs.
+ */
+static void work_replay(speed_t *sp, int libc)
+{
+    trace_t *trace = sp->trace;
+    int *order = sp->order, *pos = sp->pos;
+    size_t *size = sp->size;
+    int i, k, index, n = 0;
+    char *p;
+
+    memset(pos, 0xff, trace->num_ids * sizeof(int));
+    for (i = 0;  i < trace->num_ops;  i++) {
+	index = trace->ops[i].index;
+	switch (trace->ops[i].type) {
+
+	case ALLOC: /* malloc, placed last in allocation order */
+	case MEMALIGN:
+	case CALLOC:
+	case BALLOC:
+	    p = libc ? libc_alloc(&trace->ops[i]) :
+		mm_alloc(trace->ops, i, trace->num_ops);
+	    if (p == NULL)
+		app_error("malloc failed in work_replay");
+	    trace->blocks[index] = p;
+	    size[index] = trace->ops[i].size;
+	    trace->block_sized[index] = IS_SIZED(trace->ops[i].type);
+	    pos[index] = n;
+	    order[n++] = index;
+	    memset(p, index & 0xFF, size[index]);
+	    break;
+
+	case REALLOC: /* realloc, keeping its place */
+	    p = libc ? realloc(trace->blocks[index], trace->ops[i].size) :
+		mm_realloc(trace->blocks[index], trace->ops[i].size);
+	    if (p == NULL)
+		app_error("realloc failed in work_replay");
+	    trace->blocks[index] = p;
+	    size[index] = trace->ops[i].size;
+	    trace->block_sized[index] = 0;
+	    memset(p, index & 0xFF, size[index]);
+	    break;
+
+	case FREE: /* free */
+	case BFREE:
+	    if (libc)
+		free(trace->blocks[index]);
+	    else
+		mm_dealloc(trace->ops, i, trace->num_ops, trace->blocks[index],
+			   size[index], trace->block_sized[index]);
+	    pos[index] = -1;
+	    break;
+
+	default:
+	    app_error("Nonexistent request type in work_replay");
+	}
+	if ((i + 1) % walk_every == 0)
+	    n = work_walk(trace, order, pos, size, n);
+    }
+
+    if (libc)
+	for (k = 0; k < n; k++)
+	    if (pos[order[k]] == k)
+		free(trace->blocks[order[k]]);
+}
+
+/*
+ * work_walk - Read every live block, in allocation order, one byte
+ *    per WALK_STRIDE. Entries of order for blocks that have died (or
+ *    whose id has been reused since) are squeezed out on the way;
+ *    returns the new number of entries.
+ */
+static int work_walk(trace_t *trace, int *order, int *pos, size_t *size,
+		     int n)
+{
+    int j, k, index;
+    size_t b;
+    unsigned char *p;
+    unsigned int sum = 0;
+
+    for (j = k = 0; k < n; k++) {
+	index = order[k];
+	if (pos[index] != k)
+	    continue;
+	pos[index] = j;
+	order[j++] = index;
+	p = (unsigned char *)trace->blocks[index];
+	for (b = 0; b < size[index]; b += WALK_STRIDE)
+	    sum += p[b];
+    }
+    walk_sink += sum;
+    return j;
+}
+
 /*************************************
  * Some miscellaneous helper routines
  ************************************/
 
+/*
+ * mm_alloc - make the mm_malloc, mm_memalign or mm_calloc call alloc
+ *    op i of the n in ops asks for. The first BALLOC op of a run gets
+ *    the blocks for the whole run (up to BATCH_MAX ops of its size)
+ *    from one mm_malloc_batch call, and each op takes the next one.
+ */
+static void *mm_alloc(traceop_t *ops, int i, int n)
+{
+    traceop_t *op = &ops[i];
+    int k;
+
+    if (op->type == BALLOC) {
+	if (alloc_batch_next == alloc_batch_len || op != alloc_batch_op) {
+	    for (k = 1; k < BATCH_MAX && i + k < n && ops[i + k].type == BALLOC
+		     && ops[i + k].size == op->size; k++)
+		;
+	    if (mm_malloc_batch(op->size, k, alloc_batch) < k)
+		return NULL;
+	    alloc_batch_next = 0;
+	    alloc_batch_len = k;
+	}
+	alloc_batch_op = op + 1;
+	return alloc_batch[alloc_batch_next++];
+    }
+    if (op->type == MEMALIGN)
+	return mm_memalign((size_t)1 << op->lgalign, op->size);
+    if (op->type == CALLOC)
+	return mm_calloc(1, op->size);
+    return mm_malloc(op->size);
+}
+
+/*
+ * mm_dealloc - free the block p of free op i of the n in ops, last
+ *    allocated with size bytes, by an op IS_SIZED takes if sized is
+ *    set. With -z a FREE op of such a block is an mm_free_sized call.
+ *    The blocks of a run of BFREE ops are kept until the last op of
+ *    the run (or BATCH_MAX of them) and then freed by one
+ *    mm_free_batch call.
+ */
+static void mm_dealloc(traceop_t *ops, int i, int n, void *p, size_t size,
+		       int sized)
+{
+    if (ops[i].type != BFREE) {
+	if (sized_free && sized)
+	    mm_free_sized(p, size);
+	else
+	    mm_free(p);
+	return;
+    }
+    free_batch[free_batch_len++] = p;
+    if (i + 1 == n || ops[i + 1].type != BFREE ||
+	free_batch_len == BATCH_MAX) {
+	mm_free_batch(free_batch, free_batch_len);
+	free_batch_len = 0;
+    }
+}
+
+/*
+ * libc_alloc - the same with libc's malloc, posix_memalign, which
+ *    takes no alignment below the size of a pointer, or calloc; libc
+ *    has no batch calls, so a BALLOC op is a plain malloc
+ */
+static void *libc_alloc(traceop_t *op)
+{
+    size_t align = (size_t)1 << op->lgalign;
+    void *p;
+
+    if (op->type == CALLOC)
+	return calloc(1, op->size);
+    if (op->type != MEMALIGN)
+	return malloc(op->size);
+    if (align < sizeof(void *))
+	align = sizeof(void *);
+    return posix_memalign(&p, align, op->size) == 0 ? p : NULL;
+}
+
+/*
+ * is_zero - true if the size bytes at p are all zero
+ */
+static int is_zero(char *p, size_t size)
+{
+    size_t i;
+
+    for (i = 0; i < size; i++)
+	if (p[i] != 0)
+	    return 0;
+    return 1;
+}
+
+#ifdef MM_STATS
+/*
+ * print_mm_stats - dump the hot path counters mm.c kept during one
+ *    replay of a trace (the eval_mm_util pass)
+ */
+static void print_mm_stats(int tracenum)
+{
+    static char *paths[MM_REALLOC_NPATHS] = {
+	"malloc", "free", "inplace", "next", "prev", "both", "move"};
+    mm_counters_t *s = &mm_counters;
+    double calls = s->mallocs + s->reallocs + s->callocs;
+    int k;
+
+    if (calls == 0)
+	calls = 1;
+    printf("\nmm stats for trace %d:\n", tracenum);
+    printf("  %llu mallocs, %llu frees, %llu reallocs, %llu callocs\n",
+	   s->mallocs, s->frees, s->reallocs, s->callocs);
+    printf("  fit search: %llu lists, %llu blocks (%.2f blocks/call)\n",
+	   s->find_lists, s->find_visits, s->find_visits / calls);
+    printf("  list insert: %llu blocks passed\n", s->insert_visits);
+    printf("  coalesce: none %llu, prev %llu, next %llu, both %llu\n",
+	   s->coalesce[MM_COALESCE_NONE], s->coalesce[MM_COALESCE_PREV],
+	   s->coalesce[MM_COALESCE_NEXT], s->coalesce[MM_COALESCE_BOTH]);
+    printf("  placement: %llu split, %llu whole\n", s->splits, s->nosplits);
+    printf("  extend_heap: %llu calls, %llu bytes\n",
+	   s->extends, s->extend_bytes);
+    printf("  calloc: %llu of %llu got known-zero memory\n",
+	   s->calloc_zero, s->callocs);
+    printf("  release: %llu blocks, %llu bytes\n",
+	   s->releases, s->release_bytes);
+    printf("  sized free: %llu of %llu calls went straight onto a free list\n",
+	   s->sized_hits, s->sized_frees);
+    printf("  batch: %llu malloc_batch, %llu free_batch calls, "
+	   "%llu blocks merged into runs\n",
+	   s->batch_mallocs, s->batch_frees, s->batch_merges);
+    printf("  realloc paths:");
+    for (k = 0; k < MM_REALLOC_NPATHS; k++)
+	printf(" %s %llu", paths[k], s->realloc_path[k]);
+    printf("\n");
+}
+#endif
+
 
 /*
  * printresults - prints a performance summary for some malloc package
@@ -973,6 +1615,37 @@ static void printresults(int n, stats_t *stats)
 
 }
 
+/*
+ * printwork - prints the -w timings next to the plain ones
+ */
+static void printwork(int n, stats_t *stats)
+{
+    int i;
+    double secs = 0, wsecs = 0, ops = 0;
+
+    printf("%5s%8s%10s%10s%6s%7s\n",
+	   "trace", "ops", "secs", "work secs", "Kops", "ratio");
+    for (i=0; i < n; i++) {
+	if (!stats[i].valid) {
+	    printf("%2d%11s%10s%10s%6s%7s\n", i, "-", "-", "-", "-", "-");
+	    continue;
+	}
+	printf("%2d%11.0f%10.6f%10.6f%6.0f%7.2f\n",
+	       i,
+	       stats[i].ops,
+	       stats[i].secs,
+	       stats[i].wsecs,
+	       (stats[i].ops/1e3)/stats[i].wsecs,
+	       stats[i].wsecs/stats[i].secs);
+	secs += stats[i].secs;
+	wsecs += stats[i].wsecs;
+	ops += stats[i].ops;
+    }
+    if (wsecs > 0)
+	printf("%-5s%8.0f%10.6f%10.6f%6.0f%7.2f\n", "Total",
+	       ops, secs, wsecs, (ops/1e3)/wsecs, wsecs/secs);
+}
+
 /* 
  * app_error - Report an arbitrary application error
  */
@@ -1005,14 +1678,20 @@ void malloc_error(int tracenum, int opnum, char *msg)
  */
 static void usage(void) 
 {
-    fprintf(stderr, "Usage: mdriver [-hvVal] [-f <file>] [-t <dir>]\n");
+    fprintf(stderr, "Usage: mdriver [-hvValsz] [-f <file>] [-t <dir>] [-u <csv> [-n <ops>]] [-w <ops>]\n");
     fprintf(stderr, "Options\n");
 //    fprintf(stderr, "\t-a         Don't check the team structure.\n");
     fprintf(stderr, "\t-f <file>  Use <file> as the trace file.\n");
     fprintf(stderr, "\t-g         Generate summary info for autograder.\n");
     fprintf(stderr, "\t-h         Print this message.\n");
     fprintf(stderr, "\t-l         Run libc malloc as well.\n");
+    fprintf(stderr, "\t-n <ops>   Sample the heap every <ops> ops for -u.\n");
+    fprintf(stderr, "\t-s         Stream traces from disk in one timed pass (no checks).\n");
     fprintf(stderr, "\t-t <dir>   Directory to find default traces.\n");
+    fprintf(stderr, "\t-u <csv>   Write a utilization and waste timeline to <csv>.\n");
     fprintf(stderr, "\t-v         Print per-trace performance breakdowns.\n");
     fprintf(stderr, "\t-V         Print additional debug info.\n");
+    fprintf(stderr, "\t-w <ops>   Also time a replay that writes the payloads and walks\n");
+    fprintf(stderr, "\t           the live blocks in allocation order every <ops> ops.\n");
+    fprintf(stderr, "\t-z         Free malloc'd and calloc'd blocks with mm_free_sized.\n");
 }
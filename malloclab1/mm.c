@@ -2,10 +2,12 @@
  * We use explitict segregated free lists with rounding to upper power of 2 as the class equivalence condition
  * Blocks within each class are sorted based on size in descending order
  *
- * Format of allocated block and free block are shown below
+ * Format of allocated block and free block are shown below, for the 32-bit build
+ * In the native 64-bit build every word is 8 bytes and blocks are 16-byte aligned
  ///////////////////////////////// Block information /////////////////////////////////////////////////////////
  /*
  A   : Allocated? (1: true, 0:false)
+ Z   : Free blocks only: the payload past the links is known to be zero (see mm_calloc)
  < Allocated Block >
  31 30 29 28 27 26 25 24 23 22 21 20 19 18 17 16 15 14 13 12 11 10  9  8  7  6  5  4  3  2  1  0
  bp --->     +--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+
@@ -22,11 +24,11 @@
  < Free block >
  31 30 29 28 27 26 25 24 23 22 21 20 19 18 17 16 15 14 13 12 11 10  9  8  7  6  5  4  3  2  1  0
  bp --->    +--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+
- Header :   |                              size of the block                                       |  |  | A|
+ Header :   |                              size of the block                                       |  | Z| A|
  bp+4 --->  +--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+
- |                        pointer to its predecessor in Segregated list                          |
+ |                        pointer to its predecessor in Segregated list                         |
  +--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+
- |                        pointer to its successor in Segregated list                            |
+ |                        pointer to its successor in Segregated list                           |
  +--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+--+
  .                                                                                               .
  .                                                                                               .
@@ -44,9 +46,12 @@
 #include <assert.h>
 #include <unistd.h>
 #include <string.h>
+#include <stdint.h>
 
 #include "mm.h"
 #include "memlib.h"
+#include "mmstats.h"
+#include "cachesim.h"
 
 /*********************************************************
  * NOTE TO STUDENTS: Before you do anything else, please
@@ -68,33 +73,37 @@ team_t team = {
 #define MAX_POWER 50
 #define TAKEN 1
 #define FREE 0
+#define ZERO 2 // with FREE: the payload is zero apart from the links
 
-#define WORD_SIZE 4 /* bytes */
-#define D_WORD_SIZE 8
+#define WORD_SIZE ((int)sizeof(char *)) /* bytes: 4 with -m32, 8 natively */
+#define D_WORD_SIZE (2 * WORD_SIZE)
 #define CHUNK ((1<<12)/WORD_SIZE) /* extend heap by this amount (words) */
 #define STATUS_BIT_SIZE 3 // bits
 #define HDR_FTR_SIZE 2 // in words
 #define HDR_SIZE 1 // in words
 #define FTR_SIZE 1 // in words
-#define PRED_FIELD_SIZE 1 // in words
 #define EPILOG_SIZE 2 // in words
+#define RELEASE_WORDS ((1<<20)/WORD_SIZE) // with MM_RELEASE, free blocks this big give their pages back
 
 // Read and write a word at address p
-#define GET_BYTE(p) (*(char *)(p))
-#define GET_WORD(p) (*(unsigned int *)(p))
-#define PUT_WORD(p, val) (*(char **)(p) = (val))
+// A word is a pointer wide; headers and footers are always read and
+// written as uintptr_t, list links as char *
+// Every access to heap metadata goes through MM_TOUCH (see cachesim.h)
+#define GET_BYTE(p) (*(char *)MM_TOUCH(p, 1))
+#define GET_WORD(p) (*(uintptr_t *)MM_TOUCH(p, WORD_SIZE))
+#define PUT_WORD(p, val) (*(uintptr_t *)MM_TOUCH(p, WORD_SIZE) = (uintptr_t)(val))
 
 // Get a bit mask where the lowest size bit is set to 1
 #define GET_MASK(size) ((1 << size) - 1)
 
-/* single word (4) or double word (8) alignment */
-#define ALIGNMENT 8
+/* double word alignment: 8 bytes with -m32, 16 natively */
+#define ALIGNMENT D_WORD_SIZE
 
 /* rounds up to the nearest multiple of ALIGNMENT */
 #define ALIGN(size) (((size) + (ALIGNMENT-1)) & ~(ALIGNMENT-1))
 
 // Pack a size and allocated bit into a BIT_word
-#define PACK(size, status) ((size<<STATUS_BIT_SIZE) | (status))
+#define PACK(size, status) (((size)<<STATUS_BIT_SIZE) | (status))
 
 /* Round up to even */
 #define EVENIZE(x) ((x + 1) & ~1)
@@ -102,6 +111,7 @@ team_t team = {
 // Read the size and allocation bit from address p
 #define GET_SIZE(p)  ((GET_WORD(p) & ~GET_MASK(STATUS_BIT_SIZE)) >> STATUS_BIT_SIZE)
 #define GET_STATUS(p) (GET_WORD(p) & 0x1)
+#define GET_ZERO(p) (GET_WORD(p) & ZERO)
 
 // Address of block's footer
 // Take in a pointer that points to the header
@@ -115,21 +125,35 @@ team_t team = {
 
 // Define this so later when we move to store the list in heap,
 // we can just change this function
-#define GET_FREE_LIST_PTR(i) (*(free_lists+i))
-#define SET_FREE_LIST_PTR(i, ptr) (*(free_lists+i) = ptr)
+#define GET_FREE_LIST_PTR(i) (*(char **)MM_TOUCH(free_lists+i, sizeof(char *)))
+#define SET_FREE_LIST_PTR(i, ptr) (*(char **)MM_TOUCH(free_lists+i, sizeof(char *)) = ptr)
+
+// Pred and succ links are plain pointers. Build with -DMM_OFFSET_LINKS
+// to store them as 32-bit offsets in words from the start of the heap
+// instead, 0 standing for NULL (see to_link and from_link): both then
+// fit in the first word of a 64-bit free block, and heaps of up to
+// 32 GB can be linked.
+#ifdef MM_OFFSET_LINKS
+typedef uint32_t link_t;
+#else
+typedef char *link_t;
+#endif
 
 // Set pred or succ for free blocks
-#define SET_PTR(p, ptr) (*(char **)(p) = (char *)(ptr))
+#define SET_PTR(p, ptr) (*(link_t *)MM_TOUCH(p, sizeof(link_t)) = to_link(ptr))
 
-// Get pointer to the word containing the address of pred and succ for a free block
+// Get pointer to the field holding the link to pred and succ for a free block
 // ptr should point to the start of the header
 #define GET_PTR_PRED_FIELD(ptr) ((char **)(ptr) + HDR_SIZE)
-#define GET_PTR_SUCC_FIELD(ptr) ((char **)(ptr) + HDR_SIZE + PRED_FIELD_SIZE)
+#define GET_PTR_SUCC_FIELD(ptr) ((char **)((link_t *)GET_PTR_PRED_FIELD(ptr) + 1))
 
 // Get the pointer that points to the succ of a free block
 // ptr should point to the header of the free block
-#define GET_PRED(bp) (*(GET_PTR_PRED_FIELD(bp)))
-#define GET_SUCC(bp) (*(GET_PTR_SUCC_FIELD(bp)))
+#define GET_PRED(bp) from_link(*(link_t *)MM_TOUCH(GET_PTR_PRED_FIELD(bp), sizeof(link_t)))
+#define GET_SUCC(bp) from_link(*(link_t *)MM_TOUCH(GET_PTR_SUCC_FIELD(bp), sizeof(link_t)))
+
+// Payload words the links of a free block take up
+#define LINK_WORDS ((2 * (int)sizeof(link_t) + WORD_SIZE - 1) / WORD_SIZE)
 
 // Given pointer to current block, return pointer to header of previous block
 #define PREV_BLOCK_IN_HEAP(header_p) ((char **)(header_p) - GET_TOTAL_SIZE((char **)(header_p) - FTR_SIZE))
@@ -140,18 +164,56 @@ team_t team = {
 // Global variables
 static char **free_lists;
 static char **heap_ptr;
+static char *heap_base; // mem_heap_lo(), what offset links count from
+
+#ifdef MM_STATS
+__thread mm_counters_t mm_counters;
+#endif
+
+// Convert a block pointer to a free list link and back
+static inline link_t to_link(void *ptr)
+{
+#ifdef MM_OFFSET_LINKS
+    if (ptr == NULL)
+        return 0;
+    return (link_t)(((char *)ptr - heap_base) / WORD_SIZE);
+#else
+    return (link_t)ptr;
+#endif
+}
+
+static inline char **from_link(link_t link)
+{
+#ifdef MM_OFFSET_LINKS
+    if (link == 0)
+        return NULL;
+    return (char **)(heap_base + (size_t)link * WORD_SIZE);
+#else
+    return (char **)link;
+#endif
+}
 
 // Function Declarations
 static size_t find_free_list_index(size_t words);
+static inline size_t request_class(size_t words);
 
 static void *extend_heap(size_t words);
 
 static void *coalesce(void *bp);
+static void zero_seam(char **bp);
+#ifdef MM_RELEASE
+static void release_block(char **bp);
+#endif
+static void free_block(char **bp);
+static void absorb_next(char **bp);
+static void sort_ptrs(void **a, size_t n);
 static void *find_free_block(size_t words);
+static char **take_free_block(size_t words);
 static void alloc_free_block(void *bp, size_t words);
 static void place_block_into_free_list(char **bp);
+static void place_block_into_class(char **bp, size_t index);
 static void remove_block_from_free_list(char **bp);
-void *mm_realloc_wrapped(void *ptr, size_t size, int buffer_size);
+void *mm_realloc_wrapped(void *ptr, size_t size, size_t buffer_size);
 static int round_up_power_2(int x);
 
 int mm_check();
@@ -189,6 +251,17 @@ static size_t find_free_list_index(size_t words) {
     return index;
 }
 
+/*
+ Index of the free list for a block of the given size in words, taken
+ from the top bit of the size instead of shifting it down one bit at
+ a time: the same index as find_free_list_index.
+ */
+static inline size_t request_class(size_t words) {
+    size_t index = words > 1 ? 63 - __builtin_clzll(words) : 0;
+    
+    return index < MAX_POWER ? index : MAX_POWER;
+}
+
 /*
  The function combines the current block in
  physical memory with neigboring free blocks.
@@ -196,6 +269,8 @@ static size_t find_free_list_index(size_t words) {
  new free block.
  Coalesce is only called on a block that is not in the free list.
  As such, coalesce does not set pointer values.
+ The new block is known-zero only if all the blocks merged were; then
+ the tags and links between them are zeroed too.
  */
 static void *coalesce(void *bp) {
     char **prev_block = PREV_BLOCK_IN_HEAP(bp);
@@ -203,41 +278,196 @@ static void *coalesce(void *bp) {
     size_t prev_status = GET_STATUS(prev_block);
     size_t next_status = GET_STATUS(next_block);
     size_t new_size = GET_SIZE(bp);
+    size_t zero = GET_ZERO(bp);
     
     if (prev_status == TAKEN && next_status == TAKEN) {
+        MM_STAT(coalesce[MM_COALESCE_NONE]);
         return bp;
     } else if (prev_status == TAKEN && next_status == FREE) {
+        MM_STAT(coalesce[MM_COALESCE_NEXT]);
         remove_block_from_free_list(next_block);
         new_size += GET_TOTAL_SIZE(next_block);
+        zero &= GET_ZERO(next_block);
         
-        PUT_WORD(bp, PACK(new_size, FREE));
-        PUT_WORD(FTRP(next_block), PACK(new_size, FREE));
+        PUT_WORD(bp, PACK(new_size, FREE | zero));
+        PUT_WORD(FTRP(next_block), PACK(new_size, FREE | zero));
+        if (zero) {
+            zero_seam(next_block);
+        }
     } else if (prev_status == FREE && next_status == TAKEN) {
+        MM_STAT(coalesce[MM_COALESCE_PREV]);
         remove_block_from_free_list(prev_block);
         new_size += GET_TOTAL_SIZE(prev_block);
+        zero &= GET_ZERO(prev_block);
         
-        PUT_WORD(prev_block, PACK(new_size, FREE));
-        PUT_WORD(FTRP(bp), PACK(new_size, FREE));
+        PUT_WORD(prev_block, PACK(new_size, FREE | zero));
+        PUT_WORD(FTRP(bp), PACK(new_size, FREE | zero));
+        if (zero) {
+            zero_seam(bp);
+        }
         bp = prev_block;
     } else if (prev_status == FREE && next_status == FREE) {
+        MM_STAT(coalesce[MM_COALESCE_BOTH]);
         remove_block_from_free_list(prev_block);
         remove_block_from_free_list(next_block);
         new_size += GET_TOTAL_SIZE(prev_block) + GET_TOTAL_SIZE(next_block);
+        zero &= GET_ZERO(prev_block) & GET_ZERO(next_block);
         
-        PUT_WORD(prev_block, PACK(new_size, FREE));
-        PUT_WORD(FTRP(next_block), PACK(new_size, FREE));
+        PUT_WORD(prev_block, PACK(new_size, FREE | zero));
+        PUT_WORD(FTRP(next_block), PACK(new_size, FREE | zero));
+        if (zero) {
+            zero_seam(bp);
+            zero_seam(next_block);
+        }
         bp = prev_block;
     }
     
     return bp;
 }
 
+/*
+ Zeroes the footer in front of bp, bp's header and its links.
+ Called when bp is merged into the known-zero block before it, whose
+ payload these words become. Known-zero blocks are never smaller than
+ their links, so this stays within bp.
+ */
+static void zero_seam(char **bp) {
+    PUT_WORD(bp - FTR_SIZE, 0);
+    PUT_WORD(bp, 0);
+    for (int i = 0; i < LINK_WORDS; i++) {
+        PUT_WORD(bp + HDR_SIZE + i, 0);
+    }
+}
+
+#ifdef MM_RELEASE
+/*
+ Gives the pages of a large free block back to the system with
+ mem_release, which leaves its payload zero, and marks it known-zero.
+ The block must not be in a free list.
+ */
+static void release_block(char **bp) {
+    size_t size = GET_SIZE(bp);
+    
+    MM_STAT(releases);
+    MM_STAT_ADD(release_bytes, size * WORD_SIZE);
+    mem_release(bp + HDR_SIZE, size * WORD_SIZE);
+    
+    PUT_WORD(bp, PACK(size, FREE | ZERO));
+    PUT_WORD(FTRP(bp), PACK(size, FREE | ZERO));
+}
+#endif
+
+/*
+ Coalesces the free block bp, which is not in the free list, with its
+ neighbours and places it into free_lists.
+ Built with -DMM_RELEASE (libmmshim.so, callocbench) it also gives the
+ pages of the merged block back if it is RELEASE_WORDS or more, so that
+ mm_calloc finds them known-zero. When the merged block would be that
+ big and every free neighbour is known-zero, a smaller bp is zeroed
+ instead, so the merged block stays known-zero and a block taken from a
+ large free block and freed again does not release all of it every
+ time. Neither is paid for by mm_free in the graded build.
+ */
+static void free_block(char **bp) {
+#ifdef MM_RELEASE
+    char **prev_block = PREV_BLOCK_IN_HEAP(bp);
+    char **next_block = NEXT_BLOCK_IN_HEAP(bp);
+    size_t size = GET_SIZE(bp);
+    size_t zero = ZERO; // are the free neighbours known-zero?
+    
+    if (GET_STATUS(prev_block) == FREE) {
+        size += GET_TOTAL_SIZE(prev_block);
+        zero &= GET_ZERO(prev_block);
+    }
+    if (GET_STATUS(next_block) == FREE) {
+        size += GET_TOTAL_SIZE(next_block);
+        zero &= GET_ZERO(next_block);
+    }
+    if (size >= RELEASE_WORDS && zero && GET_SIZE(bp) < RELEASE_WORDS) {
+        memset(bp + HDR_SIZE, 0, GET_SIZE(bp) * WORD_SIZE);
+        PUT_WORD(bp, PACK(GET_SIZE(bp), FREE | ZERO));
+        PUT_WORD(FTRP(bp), PACK(GET_SIZE(bp), FREE | ZERO));
+    }
+#endif
+    
+    bp = coalesce(bp);
+    
+#ifdef MM_RELEASE
+    // give the pages of large free blocks back
+    if (GET_SIZE(bp) >= RELEASE_WORDS && !GET_ZERO(bp)) {
+        release_block(bp);
+    }
+#endif
+    
+    place_block_into_free_list(bp);
+}
+
+/*
+ Merges the block after bp into bp.
+ bp must be free and not in the free list; it stays that way.
+ The block after it must be out of the free list too.
+ */
+static void absorb_next(char **bp) {
+    size_t size = GET_SIZE(bp) + GET_TOTAL_SIZE(NEXT_BLOCK_IN_HEAP(bp));
+    
+    MM_STAT(batch_merges);
+    PUT_WORD(bp, PACK(size, FREE));
+    PUT_WORD(FTRP(bp), PACK(size, FREE));
+}
+
+/*
+ Sorts the n block pointers in a by address.
+ Quicksort, recursing into the smaller side, down to 16 pointers,
+ which an insertion sort finishes. Pointers are compared inline, which
+ is several times faster than qsort calling back for each comparison.
+ */
+static void sort_ptrs(void **a, size_t n) {
+    char *pivot, *t;
+    long i, j;
+    
+    while (n > 16) {
+        pivot = a[n / 2];
+        i = -1;
+        j = n;
+        while (1) {
+            do i++; while ((char *)a[i] < pivot);
+            do j--; while ((char *)a[j] > pivot);
+            if (i >= j) {
+                break;
+            }
+            t = a[i];
+            a[i] = a[j];
+            a[j] = t;
+        }
+        
+        // a[0..j] and a[j+1..n-1] are left to sort
+        if (j + 1 < n - (j + 1)) {
+            sort_ptrs(a, j + 1);
+            a += j + 1;
+            n -= j + 1;
+        } else {
+            sort_ptrs(a + j + 1, n - (j + 1));
+            n = j + 1;
+        }
+    }
+    
+    for (i = 1; i < n; i++) {
+        t = a[i];
+        for (j = i; j > 0 && (char *)a[j - 1] > t; j--) {
+            a[j] = a[j - 1];
+        }
+        a[j] = t;
+    }
+}
+
 /*
  Relies on mem_sbrk to create a new free block.
  Does not coalesce.
  Does not place into free list.
  Returns pointer to the new block of memory with
  header and footer already defined.
+ The block is known-zero if the heap never reached that far before
+ (only the old epilog footer, in its links, is not).
  Returns NULL if we ran out of physical memory.
  */
 static void *extend_heap(size_t words) {
@@ -245,19 +475,24 @@ static void *extend_heap(size_t words) {
     char **end_pointer; // pointer to the end of the free block
     size_t words_extend = EVENIZE(words); // make sure double aligned
     size_t words_extend_tot = words_extend + HDR_FTR_SIZE; // add header and footer
+    char *fresh = mem_fresh_lo();
+    size_t zero;
     
     // extend memory by so many words
     // multiply words by WORD_SIZE because mem_sbrk takes input as bytes
     if ((long)(bp = mem_sbrk((words_extend_tot) * WORD_SIZE)) == -1) {
         return NULL;
     }
+    MM_STAT(extends);
+    MM_STAT_ADD(extend_bytes, words_extend_tot * WORD_SIZE);
+    zero = (char *)bp >= fresh ? ZERO : 0;
     
     // offset to make use of old epilog and add space for new epilog
     bp -= EPILOG_SIZE;
     
     // set new block header/footer to size (in words)
-    PUT_WORD(bp, PACK(words_extend, FREE));
-    PUT_WORD(FTRP(bp), PACK(words_extend, FREE));
+    PUT_WORD(bp, PACK(words_extend, FREE | zero));
+    PUT_WORD(FTRP(bp), PACK(words_extend, FREE | zero));
     
     // add epilog to the end
     end_pointer = bp + words_extend_tot;
@@ -281,9 +516,11 @@ static void *find_free_block(size_t words) {
     size_t index = find_free_list_index(words);
     
     // check if first free list can contain large enough block
+    MM_STAT(find_lists);
     if ((bp = GET_FREE_LIST_PTR(index)) != NULL && GET_SIZE(bp) >= words) {
         // iterate through blocks
         while(1) {
+            MM_STAT(find_visits);
             // if block is of exact size, return right away
             if (GET_SIZE(bp) == words) {
                 return bp;
@@ -303,12 +540,16 @@ static void *find_free_block(size_t words) {
     
     // find a large enough non-empty free list
     while (GET_FREE_LIST_PTR(index) == NULL && index < MAX_POWER) {
+        MM_STAT(find_lists);
         index++;
     }
+    MM_STAT(find_lists);
     
     // if there is a non-NULL free list, go until the smallest block in free list
     if ((bp = GET_FREE_LIST_PTR(index)) != NULL) {
+        MM_STAT(find_visits);
         while (GET_SUCC(bp) != NULL) {
+            MM_STAT(find_visits);
             bp = GET_SUCC(bp);
         }
         
@@ -318,38 +559,72 @@ static void *find_free_block(size_t words) {
     }
 }
 
+/*
+ Finds a free block that can hold the amount of words specified and
+ takes it out of the free list, extending the heap if there is none.
+ Returns the pointer to the block, still marked free, for alloc_free_block.
+ Returns NULL if we ran out of physical memory.
+ */
+static char **take_free_block(size_t words) {
+    char **bp;
+    size_t extend_size;
+    
+    // check if there is a block that is large enough
+    // if not, extend the heap
+    if ((bp = find_free_block(words)) == NULL) {
+        extend_size = words > CHUNK ? words : CHUNK;
+        
+        // do not remove block from free list because it is not in it
+        return extend_heap(extend_size);
+    }
+    
+    remove_block_from_free_list(bp);
+    return bp;
+}
+
 /*
  The function takes free block and changes status to taken.
  The free block is assumed to have been removed from free list.
  The function reduces the size of the free block (splits it) if size is too large.
- Too large is a free block whose size is > needed size + HDR_FTR_SIZE
+ Too large is a free block whose size is >= needed size + HDR_FTR_SIZE
  The remaining size is either placed in free_list or left hanging if it is > 0.
- If remaining size is 0 it becomes part of the allocated block.
+ It stays known-zero if the free block was.
+ If remaining size is 0 it is left as a free block of size 0, which has
+ only its tags and is on no free list, so the allocated block always has
+ the size asked for (mm_free_sized relies on this).
  bp input is the block that you found already that is large enough.
  Assume that size in words given is <= the size of the block at input.
  */
 static void alloc_free_block(void *bp, size_t words) {
     size_t bp_size = GET_SIZE(bp);
+    size_t zero = GET_ZERO(bp);
     size_t bp_tot_size = bp_size + HDR_FTR_SIZE;
     
     size_t needed_size = words;
     size_t needed_tot_size = words + HDR_FTR_SIZE;
     
-    int new_block_tot_size = bp_tot_size - needed_tot_size;
-    int new_block_size = new_block_tot_size - HDR_FTR_SIZE;
+    long new_block_tot_size = bp_tot_size - needed_tot_size;
+    long new_block_size = new_block_tot_size - HDR_FTR_SIZE;
     
     // the block created from extra free space
     char **new_block;
     
     // if size of block is larger than needed size, split the block
     // handle new block by making it part of the free block ecosystem
-    if ((int)new_block_size > 0) {
+    if (new_block_size >= 0) {
+        MM_STAT(splits);
+        
+        // a block of size 0 has no room for the links zero_seam clears
+        if (new_block_size == 0) {
+            zero = 0;
+        }
+        
         // set new block pointer at offset from start of bp
         new_block = (char **)(bp) + needed_tot_size;
         
         // set new block's size and status
-        PUT_WORD(new_block, PACK(new_block_size, FREE));
-        PUT_WORD(FTRP(new_block), PACK(new_block_size, FREE));
+        PUT_WORD(new_block, PACK(new_block_size, FREE | zero));
+        PUT_WORD(FTRP(new_block), PACK(new_block_size, FREE | zero));
         
         // set bp size to exact needed size
         PUT_WORD(bp, PACK(needed_size, TAKEN));
@@ -360,15 +635,9 @@ static void alloc_free_block(void *bp, size_t words) {
         
         // handle this new block by putting back into free list
         place_block_into_free_list(new_block);
-    } else if (new_block_size == 0) {
-        // if the new_block_size is zero there is no point in separating the blocks
-        // thus the extra two words are just kept as part of the allocated block
-        needed_size += HDR_FTR_SIZE;
-        
-        PUT_WORD(bp, PACK(needed_size, TAKEN));
-        PUT_WORD(FTRP(bp), PACK(needed_size, TAKEN));
     } else {
         // if exact size just change status
+        MM_STAT(nosplits);
         PUT_WORD(bp, PACK(needed_size, TAKEN));
         PUT_WORD(FTRP(bp), PACK(needed_size, TAKEN));
     }
@@ -411,8 +680,16 @@ static void remove_block_from_free_list(char **bp) {
  Keeps free list sorted.
  */
 static void place_block_into_free_list(char **bp) {
+    place_block_into_class(bp, find_free_list_index(GET_SIZE(bp)));
+}
+
+/*
+ Places the block into free list index, which must be the one for its
+ size.
+ Keeps free list sorted.
+ */
+static void place_block_into_class(char **bp, size_t index) {
     size_t size = GET_SIZE(bp);
-    int index = find_free_list_index(size);
     
     char **front_ptr = GET_FREE_LIST_PTR(index);
     char **back_ptr = NULL;
@@ -445,6 +722,7 @@ static void place_block_into_free_list(char **bp) {
     // Keep each free list sorted in descending order of size
     while (front_ptr != NULL && GET_SIZE(front_ptr) > size)
     {
+        MM_STAT(insert_visits);
         back_ptr = front_ptr;
         front_ptr = GET_SUCC(front_ptr);
     }
@@ -476,6 +754,8 @@ static void place_block_into_free_list(char **bp) {
  */
 int mm_init(void)
 {
+    heap_base = mem_heap_lo();
+    
     // Store the pointer to the free list on the heap
     int even_max_power = EVENIZE(MAX_POWER); // Maintain alignment
     if ((long)(free_lists = mem_sbrk(even_max_power*sizeof(char *))) == -1)
@@ -519,50 +799,143 @@ int mm_init(void)
  */
 void *mm_malloc(size_t size)
 {
+    MM_STAT(mallocs);
+    
     if (size <= 1<<12) {
         size = round_up_power_2(size);
     }
     
     size_t words = ALIGN(size) / WORD_SIZE;
     
-    size_t extend_size;
     char **bp;
     
     if (size == 0) {
         return NULL;
     }
     
-    // check if there is a block that is large enough
-    // if not, extend the heap
-    if ((bp = find_free_block(words)) == NULL) {
-        extend_size = words > CHUNK ? words : CHUNK;
-        
-        if ((bp = extend_heap(extend_size)) == NULL) {
-            return NULL;
-        }
-        
-        // do not remove block from free list because it is not in it
-        alloc_free_block(bp, words);
-        
-        return bp + HDR_SIZE;
+    if ((bp = take_free_block(words)) == NULL) {
+        return NULL;
     }
     
-    remove_block_from_free_list(bp);
     alloc_free_block(bp, words);
     
     return bp + HDR_SIZE;
 }
 
+/*
+ * mm_calloc
+ Input is a count and a size in bytes.
+ Returns NULL on no memory, on a zero or overflowing product.
+ Returns a block of n * size zero bytes. If the block comes out of a
+ known-zero free block (fresh wilderness, or with MM_RELEASE pages
+ given back by release_block) only the words the free list links took are cleared,
+ instead of the whole block.
+ */
+void *mm_calloc(size_t n, size_t size)
+{
+    size_t bytes, words, zero;
+    char **bp;
+    
+    MM_STAT(callocs);
+    
+    if (size != 0 && n > (size_t)-1 / size) {
+        return NULL;
+    }
+    bytes = n * size;
+    
+    if (bytes == 0) {
+        return NULL;
+    }
+    
+    // same rounding as mm_malloc
+    size = bytes <= 1<<12 ? round_up_power_2(bytes) : bytes;
+    words = ALIGN(size) / WORD_SIZE;
+    
+    if ((bp = take_free_block(words)) == NULL) {
+        return NULL;
+    }
+    
+    zero = GET_ZERO(bp);
+    alloc_free_block(bp, words);
+    
+    if (zero) {
+        MM_STAT(calloc_zero);
+        memset(bp + HDR_SIZE, 0, bytes < LINK_WORDS * WORD_SIZE ? bytes : LINK_WORDS * WORD_SIZE);
+    } else {
+        memset(bp + HDR_SIZE, 0, bytes);
+    }
+    
+    return bp + HDR_SIZE;
+}
+
+/*
+ * mm_malloc_batch
+ Input is a size in bytes, a count n and an array for n pointers.
+ Returns the number of blocks put in out, which is n unless we ran out
+ of physical memory, and 0 on size 0.
+ The blocks are rounded as mm_malloc rounds them. All n of them, with
+ the tags between them, are taken as one span from one free block, so
+ the free lists are searched and the block split once rather than n
+ times; the span is then cut into the n blocks in address order.
+ If no free block can hold the span the blocks are taken one at a time,
+ rather than extending the heap for it while smaller blocks could
+ still fill holes one by one.
+ */
+size_t mm_malloc_batch(size_t size, size_t n, void **out)
+{
+    size_t words, span, i;
+    char **bp = NULL;
+    
+    MM_STAT(batch_mallocs);
+    
+    if (size == 0 || n == 0) {
+        return 0;
+    }
+    
+    if (size <= 1<<12) {
+        size = round_up_power_2(size);
+    }
+    
+    words = ALIGN(size) / WORD_SIZE;
+    
+    // the span leaves out the header of the first block and the footer of the last
+    span = n * (words + HDR_FTR_SIZE) - HDR_FTR_SIZE;
+    if (n <= (size_t)-1 / WORD_SIZE / (words + HDR_FTR_SIZE)) {
+        bp = find_free_block(span);
+    }
+    
+    if (bp == NULL) {
+        for (i = 0; i < n && (out[i] = mm_malloc(size)) != NULL; i++)
+            ;
+        return i;
+    }
+    
+    remove_block_from_free_list(bp);
+    alloc_free_block(bp, span);
+    
+    for (i = 0; i < n; i++) {
+        PUT_WORD(bp, PACK(words, TAKEN));
+        PUT_WORD(FTRP(bp), PACK(words, TAKEN));
+        out[i] = bp + HDR_SIZE;
+        
+        bp = NEXT_BLOCK_IN_HEAP(bp);
+    }
+    
+    return n;
+}
+
 /*
  * mm_free
  * Role:
  - change the status of block to free
  - coalesce the block
+ - with MM_RELEASE, release the pages of the block if it is RELEASE_WORDS or more
  - place block into free_lists
  * Assume: ptr points to the beginning of a block header
  */
 void mm_free(void *ptr)
 {
+    MM_STAT(frees);
     ptr -= WORD_SIZE;
     
     size_t size = GET_SIZE(ptr);
@@ -570,12 +943,211 @@ void mm_free(void *ptr)
     PUT_WORD(ptr, PACK(size, FREE));
     PUT_WORD(FTRP(ptr), PACK(size, FREE));
     
-    ptr = coalesce(ptr);
+    free_block(ptr);
+}
+
+/*
+ * mm_free_sized
+ Input is a block from mm_malloc, mm_calloc or mm_malloc_batch and the
+ size in bytes it was asked for with. Blocks from mm_realloc and
+ mm_memalign can hold more than their size asks for; free them with mm_free.
+ The size is rounded as mm_malloc rounds it, which gives the size of
+ the block, since alloc_free_block never leaves words in a block that
+ it did not ask for, so the header is not read. Unless a neighbour is
+ free, or the block is RELEASE_WORDS or more, it goes straight onto the
+ free list of its class, taken from the size, without coalesce. The
+ neighbours' tags are the words on either side of the block's own, so
+ looking at them costs no more misses; leaving blocks unmerged instead
+ halves the utilization of coalescing-bal.rep.
+ With -DMM_DEBUG a size that does not give the block's size is reported.
+ */
+void mm_free_sized(void *ptr, size_t size)
+{
+    char **bp = (char **)ptr - HDR_SIZE;
+    size_t words;
+    
+    MM_STAT(frees);
+    MM_STAT(sized_frees);
+    
+    // same rounding as mm_malloc
+    if (size <= 1<<12) {
+        size = round_up_power_2(size);
+    }
+    words = ALIGN(size) / WORD_SIZE;
+    
+#ifdef MM_DEBUG
+    if (words != GET_SIZE(bp)) {
+        printf("mm_free_sized: %lu words for the block at %p of %lu words\n",
+               (unsigned long)words, ptr, (unsigned long)GET_SIZE(bp));
+        assert(0);
+    }
+#endif
+    
+    PUT_WORD(bp, PACK(words, FREE));
+    PUT_WORD(bp + HDR_SIZE + words, PACK(words, FREE));
+    
+    if (words >= RELEASE_WORDS || GET_STATUS(bp - FTR_SIZE) == FREE ||
+        GET_STATUS(bp + HDR_FTR_SIZE + words) == FREE) {
+        free_block(bp);
+        return;
+    }
+    
+    MM_STAT(sized_hits);
+    MM_STAT(coalesce[MM_COALESCE_NONE]);
+    place_block_into_class(bp, request_class(words));
+}
+
+/*
+ * mm_free_batch
+ Frees the n blocks in ptrs, skipping NULL entries.
+ ptrs is sorted by address in place. Blocks that are next to each
+ other in the heap, with or without a free block between them, are
+ merged into one run while it is out of the free lists, so a run is
+ coalesced and placed into free_lists once instead of every block in it
+ being placed and taken out again by the next one's coalesce.
+ */
+void mm_free_batch(void **ptrs, size_t n)
+{
+    char **run = NULL; // the free run being built, not in the free lists
+    char **bp, **next;
+    size_t i;
+    
+    MM_STAT(batch_frees);
+    
+    // blocks freed in the order mm_malloc_batch gave them are sorted already
+    for (i = 1; i < n && (char *)ptrs[i - 1] <= (char *)ptrs[i]; i++)
+        ;
+    if (i < n) {
+        sort_ptrs(ptrs, n);
+    }
+    
+    for (i = 0; i < n; i++) {
+        if (ptrs[i] == NULL) {
+            continue;
+        }
+        bp = (char **)ptrs[i] - HDR_SIZE;
+        
+        // take in the free block after the run, as coalesce would
+        if (run != NULL && GET_STATUS(next = NEXT_BLOCK_IN_HEAP(run)) == FREE) {
+            remove_block_from_free_list(next);
+            absorb_next(run);
+        }
+        
+        if (run != NULL && NEXT_BLOCK_IN_HEAP(run) == bp) {
+            absorb_next(run);
+        } else {
+            if (run != NULL) {
+                free_block(run);
+            }
+            run = bp;
+            PUT_WORD(run, PACK(GET_SIZE(run), FREE));
+            PUT_WORD(FTRP(run), PACK(GET_SIZE(run), FREE));
+        }
+    }
+    
+    if (run != NULL) {
+        free_block(run);
+    }
+}
+
+/*
+ * mm_memalign
+ Input is an alignment in bytes, which must be a power of 2, and a size in bytes.
+ Returns NULL on no memory, on size 0 or on a bad alignment.
+ Alignments up to ALIGNMENT are plain mm_malloc calls.
+ Otherwise a block with room for the size plus the alignment is taken
+ with mm_malloc, and the words in front of the first aligned payload
+ are split off as a free block of their own (at least 4 words, so it
+ can hold both links). What is left beyond the size is split off the
+ end by alloc_free_block, so nothing is kept as padding.
+ */
+void *mm_memalign(size_t align, size_t size)
+{
+    char **ptr, **bp, **aligned_bp;
+    size_t words = ALIGN(size) / WORD_SIZE;
+    size_t lead; // in words
+    
+    if (align == 0 || (align & (align - 1)) != 0) {
+        return NULL;
+    }
+    
+    if (align <= ALIGNMENT) {
+        return mm_malloc(size);
+    }
+    
+    if (size == 0 || size > (size_t)-1 - align - 4 * WORD_SIZE) {
+        return NULL;
+    }
+    
+    if ((ptr = mm_malloc(size + align + 4 * WORD_SIZE)) == NULL) {
+        return NULL;
+    }
+    
+    // find the first aligned payload that leaves a usable block in front
+    lead = (((uintptr_t)ptr + align - 1) & ~(uintptr_t)(align - 1)) - (uintptr_t)ptr;
+    lead /= WORD_SIZE;
+    while (lead != 0 && lead < 2 * HDR_FTR_SIZE) {
+        lead += align / WORD_SIZE;
+    }
+    
+    bp = ptr - HDR_SIZE;
+    aligned_bp = bp + lead;
+    
+    if (lead > 0) {
+        size_t bp_size = GET_SIZE(bp);
+        
+        // the aligned block is taken before the lead is coalesced
+        PUT_WORD(aligned_bp, PACK(bp_size - lead, TAKEN));
+        PUT_WORD(FTRP(aligned_bp), PACK(bp_size - lead, TAKEN));
+        
+        PUT_WORD(bp, PACK(lead - HDR_FTR_SIZE, FREE));
+        PUT_WORD(FTRP(bp), PACK(lead - HDR_FTR_SIZE, FREE));
+        place_block_into_free_list(coalesce(bp));
+    }
+    
+    // give back what is left after the payload
+    alloc_free_block(aligned_bp, words);
+    
+    return aligned_bp + HDR_SIZE;
+}
+
+/*
+ * mm_aligned_alloc
+ The C11 name for mm_memalign.
+ */
+void *mm_aligned_alloc(size_t align, size_t size)
+{
+    return mm_memalign(align, size);
+}
+
+/*
+ * mm_usable_size
+ Returns the number of payload bytes in the allocated block at ptr.
+ This is at least the size that was asked for, and often more since
+ small requests are rounded up to a power of 2.
+ */
+size_t mm_usable_size(void *ptr)
+{
+    return GET_SIZE((char *)ptr - WORD_SIZE) * WORD_SIZE;
+}
+
+/*
+ * mm_heap_walk
+ Calls fn on every block between the prolog and the epilog.
+ Sizes are handed out in bytes.
+ */
+void mm_heap_walk(mm_walker_t fn, void *arg)
+{
+    char **bp;
     
-    place_block_into_free_list(ptr);
+    for (bp = heap_ptr; GET_SIZE(bp) != 0 || GET_STATUS(bp) != TAKEN;
+         bp = NEXT_BLOCK_IN_HEAP(bp)) {
+        fn(bp + HDR_SIZE, GET_TOTAL_SIZE(bp) * WORD_SIZE,
+           GET_SIZE(bp) * WORD_SIZE, GET_STATUS(bp) == TAKEN, arg);
+    }
 }
 
-int round_to_thousand(size_t x)
+size_t round_to_thousand(size_t x)
 {
     return x % 1000 >= 500 ? x + 1000 - x % 1000 : x - x % 1000;
 }
@@ -585,11 +1157,13 @@ int round_to_thousand(size_t x)
 // Call mm_realloc_wrapped to perform the actual reallocation
 void *mm_realloc(void *ptr, size_t size)
 {
-    static int previous_size;
-    int buffer_size;
-    int diff = abs(size - previous_size);
+    static size_t previous_size;
+    size_t buffer_size;
+    size_t diff = size > previous_size ? size - previous_size : previous_size - size;
     
-    if (diff < 1<<12 && diff % round_up_power_2(diff)) {
+    MM_STAT(reallocs);
+    
+    if (diff != 0 && diff < 1<<12 && diff % round_up_power_2(diff)) {
         buffer_size = round_up_power_2(diff);
     } else {
         buffer_size = round_to_thousand(size);
@@ -611,12 +1185,13 @@ void *mm_realloc(void *ptr, size_t size)
  If that is not possible, simple reallocates based on alloc and free.
  Uses buffer to not have to reallocate often.
  */
-void *mm_realloc_wrapped(void *ptr, size_t size, int buffer_size)
+void *mm_realloc_wrapped(void *ptr, size_t size, size_t buffer_size)
 {
     
     // equivalent to mm_malloc if ptr is NULL
     if (ptr == NULL) {
-        return mm_malloc(ptr);
+        MM_STAT(realloc_path[MM_REALLOC_MALLOC]);
+        return mm_malloc(size);
     }
     
     // adjust to be at start of block
@@ -629,10 +1204,12 @@ void *mm_realloc_wrapped(void *ptr, size_t size, int buffer_size)
     size_t old_size = GET_SIZE(bp); // in words
     
     if (size_with_buffer == old_size && new_size <= size_with_buffer) {
+        MM_STAT(realloc_path[MM_REALLOC_INPLACE]);
         return bp + HDR_SIZE;
     }
     
     if (new_size == 0) {
+        MM_STAT(realloc_path[MM_REALLOC_FREE]);
         mm_free(ptr);
         return NULL;
     } else if (new_size > old_size) {
@@ -640,6 +1217,7 @@ void *mm_realloc_wrapped(void *ptr, size_t size, int buffer_size)
             GET_STATUS(PREV_BLOCK_IN_HEAP(bp)) == TAKEN &&
             GET_STATUS(NEXT_BLOCK_IN_HEAP(bp)) == FREE
             ) { // checks if possible to merge with previous block in memory
+            MM_STAT(realloc_path[MM_REALLOC_NEXT]);
             PUT_WORD(bp, PACK(old_size, FREE));
             PUT_WORD(FTRP(bp), PACK(old_size, FREE));
             
@@ -649,6 +1227,7 @@ void *mm_realloc_wrapped(void *ptr, size_t size, int buffer_size)
                    GET_STATUS(PREV_BLOCK_IN_HEAP(bp)) == FREE &&
                    GET_STATUS(NEXT_BLOCK_IN_HEAP(bp)) == TAKEN
                    ) { // checks if possible to merge with next block in memory
+            MM_STAT(realloc_path[MM_REALLOC_PREV]);
             PUT_WORD(bp, PACK(old_size, FREE));
             PUT_WORD(FTRP(bp), PACK(old_size, FREE));
             
@@ -660,6 +1239,7 @@ void *mm_realloc_wrapped(void *ptr, size_t size, int buffer_size)
                    GET_STATUS(PREV_BLOCK_IN_HEAP(bp)) == FREE &&
                    GET_STATUS(NEXT_BLOCK_IN_HEAP(bp)) == FREE
                    ) { // checks if possible to merge with both prev and next block in memory
+            MM_STAT(realloc_path[MM_REALLOC_BOTH]);
             PUT_WORD(bp, PACK(old_size, FREE));
             PUT_WORD(FTRP(bp), PACK(old_size, FREE));
             
@@ -668,15 +1248,19 @@ void *mm_realloc_wrapped(void *ptr, size_t size, int buffer_size)
             memmove(bp + 1, old + 1, old_size * WORD_SIZE);
             alloc_free_block(bp, size_with_buffer);
         } else { // end case: if no optimization possible, just do brute force realloc
-            bp = (char **)mm_malloc(size_with_buffer*WORD_SIZE + WORD_SIZE) - 1;
+            MM_STAT(realloc_path[MM_REALLOC_MOVE]);
+            void *new_ptr = mm_malloc(size_with_buffer*WORD_SIZE + WORD_SIZE);
             
-            if (bp == NULL) {
+            if (new_ptr == NULL) {
                 return NULL;
             }
+            bp = (char **)new_ptr - 1;
             
             memcpy(bp + 1, old + 1, old_size * WORD_SIZE);
             mm_free(old + 1);
         }
+    } else {
+        MM_STAT(realloc_path[MM_REALLOC_INPLACE]);
     }
     
     return bp + HDR_SIZE;
@@ -753,7 +1337,7 @@ static void is_valid_free_block(char ** bp)
 
 static void should_be_in_free_list(char ** bp)
 {
-    int size = GET_SIZE(bp);
+    size_t size = GET_SIZE(bp);
     int index = find_free_list_index(size);
     
     if (GET_FREE_LIST_PTR(index) == bp)
@@ -0,0 +1,142 @@
+/*
+ * mmarena.c - bump allocation from chunks of mm_malloc memory
+ *
+ * The chunks of an arena are kept on a list, newest first, each one
+ * starting with a chunk_t. Blocks are cut off the front of the newest
+ * chunk; when it has no room left for a request, a new chunk is taken
+ * and the rest of the old one is given up. A request over a quarter of
+ * a chunk gets a chunk of exactly its size, put on the list behind the
+ * newest one, so that the room left in that one is not given up for
+ * it. The arena itself lives in an mm_malloc block too.
+ */
+#include <stdlib.h>
+
+#include "mm.h"
+#include "mmarena.h"
+
+#define ARENA_CHUNK  (64 << 10)               /* default chunk bytes */
+#define ARENA_ALIGN  (2 * sizeof(void *))     /* as mm_malloc aligns */
+
+/* rounds up to the nearest multiple of ARENA_ALIGN */
+#define ARENA_ROUND(size) (((size) + (ARENA_ALIGN-1)) & ~(ARENA_ALIGN-1))
+
+/* Head of a chunk; two words, so the blocks after it stay aligned */
+typedef struct chunk {
+    struct chunk *next;  /* next older chunk */
+    size_t size;         /* bytes in the chunk, this head included */
+} chunk_t;
+
+struct mm_arena {
+    char *next;          /* first free byte in the newest chunk */
+    char *end;           /* end of the newest chunk */
+    chunk_t *chunks;     /* all chunks, newest first */
+    size_t chunk;        /* bytes in a chunk, head included */
+};
+
+/*
+ * mm_arena_create - an empty arena that takes chunks of chunk bytes
+ */
+mm_arena_t *mm_arena_create(size_t chunk)
+{
+    mm_arena_t *a;
+
+    if (chunk == 0)
+	chunk = ARENA_CHUNK;
+    chunk = ARENA_ROUND(chunk);
+    if (chunk < 4 * sizeof(chunk_t))
+	chunk = 4 * sizeof(chunk_t);
+
+    if ((a = mm_malloc(sizeof(mm_arena_t))) == NULL)
+	return NULL;
+    a->next = a->end = NULL;
+    a->chunks = NULL;
+    a->chunk = chunk;
+    return a;
+}
+
+/*
+ * mm_arena_alloc - a block of size bytes that lives until the arena
+ *     is reset or destroyed
+ */
+void *mm_arena_alloc(mm_arena_t *a, size_t size)
+{
+    chunk_t *c;
+    char *p;
+
+    if (size > (size_t)-1 / 2)
+	return NULL;
+    size = ARENA_ROUND(size);
+
+    /* The common case: room in the newest chunk */
+    if (size <= (size_t)(a->end - a->next)) {
+	p = a->next;
+	a->next += size;
+	return p;
+    }
+
+    /* A big block gets its own chunk, behind the newest one */
+    if (size > a->chunk / 4) {
+	if ((c = mm_malloc(sizeof(chunk_t) + size)) == NULL)
+	    return NULL;
+	c->size = sizeof(chunk_t) + size;
+	if (a->chunks == NULL) {
+	    c->next = NULL;
+	    a->chunks = c;
+	}
+	else {
+	    c->next = a->chunks->next;
+	    a->chunks->next = c;
+	}
+	return c + 1;
+    }
+
+    if ((c = mm_malloc(a->chunk)) == NULL)
+	return NULL;
+    c->size = a->chunk;
+    c->next = a->chunks;
+    a->chunks = c;
+    p = (char *)(c + 1);
+    a->next = p + size;
+    a->end = (char *)c + c->size;
+    return p;
+}
+
+/*
+ * mm_arena_reset - free every block in the arena: all chunks but one
+ *     of the usual size go back to mm.c, and that one is emptied
+ */
+void mm_arena_reset(mm_arena_t *a)
+{
+    chunk_t *c, *next, *keep = NULL;
+
+    for (c = a->chunks; c != NULL; c = next) {
+	next = c->next;
+	if (keep == NULL && c->size == a->chunk)
+	    keep = c;
+	else
+	    mm_free(c);
+    }
+
+    a->chunks = keep;
+    if (keep == NULL) {
+	a->next = a->end = NULL;
+	return;
+    }
+    keep->next = NULL;
+    a->next = (char *)(keep + 1);
+    a->end = (char *)keep + keep->size;
+}
+
+/*
+ * mm_arena_destroy - free every block in the arena and the arena
+ */
+void mm_arena_destroy(mm_arena_t *a)
+{
+    chunk_t *c, *next;
+
+    for (c = a->chunks; c != NULL; c = next) {
+	next = c->next;
+	mm_free(c);
+    }
+    mm_free(a);
+}
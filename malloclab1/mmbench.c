@@ -0,0 +1,293 @@
+/*
+ * mmbench.c - time the primitives of mm.c one at a time
+ *
+ *     unix> mmbench [-r rounds] [-l maxlen] [-k class]
+ *
+ * mm.c is included whole so that its static helpers can be called
+ * directly. For each list length L = 1, 2, 4, ..., maxlen a synthetic
+ * heap is built whose free list for size class k holds exactly L
+ * blocks, each between two allocated blocks so nothing coalesces by
+ * accident, and each primitive is timed against it in batches of
+ * BATCH calls between reads of the clock. Blocks the primitives work
+ * on are carved next to the list, and any bookkeeping needed to
+ * repeat a batch (rewriting headers, taking blocks back out of a
+ * list) is done outside the timed region.
+ *
+ * Two size mixes are run. In "same" every block on the list has
+ * 2^k words, so a search or sorted insert for that size stops at the
+ * head. In "spread" the sizes are spread evenly over the class and
+ * the requests are for the smallest, which sorts last. A row that
+ * stays flat as L doubles is O(1); one that doubles with it is O(L).
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "mm.c"
+#include "ftimer.h"
+
+#define BATCH     64     /* calls between reads of the clock */
+#define SEP_WORDS 2      /* size of the allocated blocks between others */
+
+/* Results for one heap, in ns per call */
+typedef struct {
+    double index;        /* find_free_list_index */
+    double find;         /* find_free_block */
+    double place;        /* place_block_into_free_list */
+    double remove;       /* remove_block_from_free_list */
+    double coalesce;     /* coalesce, both neighbours free */
+    double alloc;        /* alloc_free_block, splitting onto the list */
+} result_t;
+
+static int rounds = 2000;           /* batches timed per primitive */
+static int cls = 6;                 /* size class of the list */
+static char **spare[BATCH];         /* blocks for place and remove */
+static char **triple[BATCH];        /* first of three blocks for coalesce */
+static char **big[BATCH];           /* blocks for alloc_free_block */
+static volatile size_t bench_sink;  /* keeps results of pure calls alive */
+
+/* function prototypes */
+static void usage(void);
+
+/*
+ * set_block - write the header and footer of the block at bp
+ */
+static void set_block(char **bp, size_t words, int status)
+{
+    PUT_WORD(bp, PACK(words, status));
+    PUT_WORD(FTRP(bp), PACK(words, status));
+}
+
+/*
+ * carve - take a new allocated block of words words (even) from the
+ *     top of the heap
+ */
+static char **carve(size_t words)
+{
+    char **bp;
+
+    if ((bp = extend_heap(words)) == NULL) {
+	printf("mmbench: out of heap, use a smaller -l\n");
+	exit(1);
+    }
+    set_block(bp, words, TAKEN);
+    return bp;
+}
+
+/*
+ * list_size - size in words of the i'th of n blocks on the list
+ */
+static size_t list_size(int i, int n, int spread)
+{
+    size_t lo = (size_t)1 << cls;
+
+    if (!spread || n == 1)
+	return lo;
+    return lo + 2 * ((lo / 2 - 1) * i / (n - 1));
+}
+
+/*
+ * build - reset the heap and lay out the list of n blocks, followed by
+ *     the blocks the primitives will be run on
+ */
+static void build(int n, int spread)
+{
+    size_t small = (size_t)1 << cls;
+    char **bp;
+    int i;
+
+    mem_reset_brk();
+    if (mm_init() < 0) {
+	printf("mmbench: mm_init failed\n");
+	exit(1);
+    }
+
+    /* Take the first chunk off its list so the only free blocks are ours */
+    remove_block_from_free_list(heap_ptr);
+    set_block(heap_ptr, GET_SIZE(heap_ptr), TAKEN);
+
+    for (i = 0; i < n; i++) {
+	bp = carve(list_size(i, n, spread));
+	carve(SEP_WORDS);
+	set_block(bp, GET_SIZE(bp), FREE);
+	place_block_into_free_list(bp);
+    }
+
+    /* Free blocks of the smallest size, kept off the list */
+    for (i = 0; i < BATCH; i++) {
+	spare[i] = carve(small);
+	set_block(spare[i], small, FREE);
+	carve(SEP_WORDS);
+    }
+
+    /* Three blocks in a row; the outer two go on a list per batch */
+    for (i = 0; i < BATCH; i++) {
+	triple[i] = carve(2);
+	carve(2);
+	carve(2);
+	carve(SEP_WORDS);
+    }
+
+    /* Blocks that split into a 2 word block and a list-sized remainder */
+    for (i = 0; i < BATCH; i++) {
+	big[i] = carve(small + 2 + HDR_FTR_SIZE);
+	carve(SEP_WORDS);
+    }
+}
+
+/*
+ * ns - convert secs spent on rounds batches into ns per call
+ */
+static double ns(double secs)
+{
+    return secs * 1e9 / ((double)rounds * BATCH);
+}
+
+/*
+ * run - time each primitive against the heap left by build()
+ */
+static void run(result_t *res)
+{
+    size_t small = (size_t)1 << cls;
+    size_t sum = 0;
+    double t, s_index = 0, s_find = 0, s_place = 0, s_remove = 0;
+    double s_coalesce = 0, s_alloc = 0;
+    char **mid, **right;
+    int r, i;
+
+    for (r = 0; r < rounds; r++) {
+	t = ftimer_now();
+	for (i = 0; i < BATCH; i++)
+	    sum += find_free_list_index(small + i);
+	s_index += ftimer_now() - t;
+
+	t = ftimer_now();
+	for (i = 0; i < BATCH; i++)
+	    sum += (size_t)find_free_block(small);
+	s_find += ftimer_now() - t;
+
+	t = ftimer_now();
+	for (i = 0; i < BATCH; i++)
+	    place_block_into_free_list(spare[i]);
+	s_place += ftimer_now() - t;
+
+	t = ftimer_now();
+	for (i = 0; i < BATCH; i++)
+	    remove_block_from_free_list(spare[i]);
+	s_remove += ftimer_now() - t;
+
+	/* Free the outer blocks of each triple, as mm_free would */
+	for (i = 0; i < BATCH; i++) {
+	    mid = NEXT_BLOCK_IN_HEAP(triple[i]);
+	    right = NEXT_BLOCK_IN_HEAP(mid);
+	    set_block(triple[i], 2, FREE);
+	    set_block(right, 2, FREE);
+	    set_block(mid, 2, FREE);
+	    place_block_into_free_list(triple[i]);
+	    place_block_into_free_list(right);
+	}
+	t = ftimer_now();
+	for (i = 0; i < BATCH; i++)
+	    sum += (size_t)coalesce(NEXT_BLOCK_IN_HEAP(triple[i]));
+	s_coalesce += ftimer_now() - t;
+	for (i = 0; i < BATCH; i++) {
+	    set_block(triple[i], 2, TAKEN);
+	    mid = NEXT_BLOCK_IN_HEAP(triple[i]);
+	    set_block(mid, 2, TAKEN);
+	    set_block(NEXT_BLOCK_IN_HEAP(mid), 2, TAKEN);
+	}
+
+	for (i = 0; i < BATCH; i++)
+	    set_block(big[i], small + 2 + HDR_FTR_SIZE, FREE);
+	t = ftimer_now();
+	for (i = 0; i < BATCH; i++)
+	    alloc_free_block(big[i], 2);
+	s_alloc += ftimer_now() - t;
+	for (i = 0; i < BATCH; i++)
+	    remove_block_from_free_list(NEXT_BLOCK_IN_HEAP(big[i]));
+    }
+    bench_sink += sum;
+
+    res->index = ns(s_index);
+    res->find = ns(s_find);
+    res->place = ns(s_place);
+    res->remove = ns(s_remove);
+    res->coalesce = ns(s_coalesce);
+    res->alloc = ns(s_alloc);
+}
+
+static void print_row(char *label, result_t *r)
+{
+    printf("%8s %8.1f %8.1f %8.1f %8.1f %8.1f %8.1f\n", label,
+	   r->index, r->find, r->place, r->remove, r->coalesce, r->alloc);
+}
+
+int main(int argc, char **argv)
+{
+    static char *mixes[2] = {"same", "spread"};
+    result_t first = {0}, res;
+    int c, n, spread, maxlen = 4096;
+    char label[16];
+
+    while ((c = getopt(argc, argv, "r:l:k:h")) != EOF) {
+	switch (c) {
+	case 'r': /* Batches per primitive */
+	    rounds = atoi(optarg);
+	    break;
+	case 'l': /* Longest list */
+	    maxlen = atoi(optarg);
+	    break;
+	case 'k': /* Size class of the list */
+	    cls = atoi(optarg);
+	    break;
+	case 'h':
+	    usage();
+	    exit(0);
+	default:
+	    usage();
+	    exit(1);
+	}
+    }
+    if (rounds < 1 || maxlen < 1 || cls < 2 || cls > 16) {
+	usage();
+	exit(1);
+    }
+
+    mem_init();
+    for (spread = 0; spread < 2; spread++) {
+	printf("\n%s sizes, class %d (%d-%d words), ns per call\n",
+	       mixes[spread], cls, 1 << cls, (1 << (cls + 1)) - 1);
+	printf("%8s %8s %8s %8s %8s %8s %8s\n", "L", "index", "find",
+	       "place", "remove", "coalesce", "alloc");
+	for (n = 1; n <= maxlen; n *= 2) {
+	    build(n, spread);
+	    run(&res);
+	    if (n == 1)
+		first = res;
+	    sprintf(label, "%d", n);
+	    print_row(label, &res);
+	}
+	res.index /= first.index;
+	res.find /= first.find;
+	res.place /= first.place;
+	res.remove /= first.remove;
+	res.coalesce /= first.coalesce;
+	res.alloc /= first.alloc;
+	print_row("growth", &res);
+    }
+    mem_deinit();
+    exit(0);
+}
+
+/*
+ * usage - Explain the command line arguments
+ */
+static void usage(void)
+{
+    fprintf(stderr, "Usage: mmbench [-h] [-r <rounds>] [-l <maxlen>] [-k <class>]\n");
+    fprintf(stderr, "Options\n");
+    fprintf(stderr, "\t-r <rounds> Batches of %d calls timed per primitive (2000).\n", BATCH);
+    fprintf(stderr, "\t-l <maxlen> Longest free list, in blocks (4096).\n");
+    fprintf(stderr, "\t-k <class>  Size class of the list, 2 to 16 (6).\n");
+    fprintf(stderr, "\t-h          Print this message.\n");
+}
@@ -0,0 +1,452 @@
+/*
+ * mmrecord.c - LD_PRELOAD library that records a program's allocator
+ *     calls as a malloc lab trace
+ *
+ *     unix> MMRECORD_OUT=app.rep LD_PRELOAD=./libmmrecord.so app ...
+ *
+ * malloc, free, calloc, realloc, memalign, posix_memalign and
+ * aligned_alloc are interposed and forwarded to the next definition
+ * (normally libc's). Each call appends a 32-byte event to a buffer
+ * owned by the calling thread; the only shared write is an atomic
+ * increment of the global sequence number. Full buffers are pushed onto
+ * a lock-free list and a background thread writes them to a raw log.
+ * At exit the log is merged into global order and converted to a trace
+ * file with dense ids (see recmerge.c).
+ *
+ * Environment:
+ *   MMRECORD_OUT     trace to write (default mmrecord.<pid>.rep); the
+ *                    processes the recorded one starts write to
+ *                    <out>.<pid>, and it sets MMRECORD_PID to tell
+ *                    them apart from itself (and the programs it execs)
+ *   MMRECORD_FORMAT  text, binary or packed (default text)
+ *   MMRECORD_KEEP    if set, keep the raw log (<out>.raw) after converting
+ *
+ * Events from threads still running when the process exits may be
+ * lost, and a forked child does not record.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <dlfcn.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#include "record.h"
+#include "trace.h"
+
+#define EXPORT __attribute__((visibility("default")))
+
+#define RECBUF_EVENTS  (1<<16)   /* events per thread buffer */
+#define REC_MAXTHREADS 4096      /* threads that can ever record */
+#define BOOT_HEAP      (1<<16)   /* bytes served while resolving libc */
+#define MAXPATH        1024
+
+int verbose = 0;  /* read by the trace module; hidden in the .so */
+
+/* A thread's event buffer; full ones are chained on full_list */
+typedef struct recbuf {
+    struct recbuf *next;
+    recblock_t hdr;                  /* written to the log as is... */
+    recevent_t ev[RECBUF_EVENTS];    /* ... followed by hdr.n events */
+} recbuf_t;
+
+/* Per-thread recorder state, in a slab that is never freed */
+typedef struct {
+    recbuf_t *buf;                   /* buffer being filled */
+} recthread_t;
+
+/* Pointers to the real allocator */
+static void *(*real_malloc)(size_t);
+static void (*real_free)(void *);
+static void *(*real_calloc)(size_t, size_t);
+static void *(*real_realloc)(void *, size_t);
+static void *(*real_memalign)(size_t, size_t);
+static int (*real_posix_memalign)(void **, size_t, size_t);
+static void *(*real_aligned_alloc)(size_t, size_t);
+
+/* Recorder state */
+static enum {REC_OFF, REC_INIT, REC_ON, REC_DONE} rec_state = REC_OFF;
+static unsigned long long rec_seq;        /* next sequence number */
+static recbuf_t *full_list;               /* buffers waiting to be written */
+static recthread_t *threads;              /* slab of per-thread state */
+static unsigned int nthreads;             /* slots handed out so far */
+static pthread_key_t thread_key;          /* runs rec_thread_exit */
+static pthread_t flusher;
+static int raw_fd = -1;
+static char out_path[MAXPATH];
+static char raw_path[MAXPATH + 8];
+
+static __thread recthread_t *self __attribute__((tls_model("initial-exec")));
+static __thread int in_hook __attribute__((tls_model("initial-exec")));
+
+/* Memory handed out while dlsym is still resolving the real functions */
+static char boot_heap[BOOT_HEAP] __attribute__((aligned(16)));
+static size_t boot_used;
+
+#define IN_BOOT_HEAP(p) \
+    ((char *)(p) >= boot_heap && (char *)(p) < boot_heap + BOOT_HEAP)
+
+static void rec_init(void);
+
+/***************************************************
+ * Buffers and the background writer
+ ***************************************************/
+
+static recbuf_t *new_buf(unsigned int tid)
+{
+    recbuf_t *b = mmap(NULL, sizeof(recbuf_t), PROT_READ | PROT_WRITE,
+		       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (b == MAP_FAILED)
+	return NULL;
+    b->hdr.n = 0;
+    b->hdr.tid = tid;
+    return b;
+}
+
+/* push_full - hand a buffer to the writer (lock-free push) */
+static void push_full(recbuf_t *b)
+{
+    recbuf_t *head = __atomic_load_n(&full_list, __ATOMIC_RELAXED);
+
+    do {
+	b->next = head;
+    } while (!__atomic_compare_exchange_n(&full_list, &head, b, 1,
+					  __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+/*
+ * write_full - write every queued buffer to the raw log and unmap it,
+ *     unless keep is set: then a thread may still be appending to it,
+ *     and only the events it had finished are written
+ */
+static void write_full(int keep)
+{
+    recbuf_t *b = __atomic_exchange_n(&full_list, NULL, __ATOMIC_ACQUIRE);
+    recbuf_t *next;
+    recblock_t hdr;
+    size_t len;
+
+    for (; b != NULL; b = next) {
+	next = b->next;
+	hdr = b->hdr;
+	hdr.n = __atomic_load_n(&b->hdr.n, __ATOMIC_ACQUIRE);
+	len = (size_t)hdr.n * sizeof(recevent_t);
+	if (write(raw_fd, &hdr, sizeof(hdr)) != (ssize_t)sizeof(hdr) ||
+	    write(raw_fd, b->ev, len) != (ssize_t)len)
+	    fprintf(stderr, "mmrecord: short write to %s\n", raw_path);
+	if (!keep)
+	    munmap(b, sizeof(recbuf_t));
+    }
+}
+
+/* flush_thread - body of the background writer */
+static void *flush_thread(void *arg)
+{
+    struct timespec ts = {0, 1000000};  /* 1 ms */
+
+    in_hook = 1;  /* never record our own allocations */
+    while (__atomic_load_n(&rec_state, __ATOMIC_ACQUIRE) == REC_ON) {
+	if (__atomic_load_n(&full_list, __ATOMIC_RELAXED) == NULL)
+	    nanosleep(&ts, NULL);
+	else
+	    write_full(0);
+    }
+    return NULL;
+}
+
+/* rec_thread_exit - push the partial buffer of an exiting thread */
+static void rec_thread_exit(void *arg)
+{
+    recthread_t *t = (recthread_t *)arg;
+    recbuf_t *b = t->buf;
+
+    if (b != NULL && __atomic_exchange_n(&t->buf, NULL, __ATOMIC_ACQ_REL) == b)
+	push_full(b);
+}
+
+/***************************************************
+ * Recording
+ ***************************************************/
+
+/* rec_self - the calling thread's recorder slot, created on first use */
+static recthread_t *rec_self(void)
+{
+    unsigned int tid;
+
+    if (self == NULL) {
+	tid = __atomic_fetch_add(&nthreads, 1, __ATOMIC_RELAXED);
+	if (tid >= REC_MAXTHREADS)
+	    return NULL;
+	self = &threads[tid];
+	pthread_setspecific(thread_key, self);
+    }
+    return self;
+}
+
+/* rec - append one event to the calling thread's buffer */
+static void rec(int type, void *ptr, void *old, size_t size)
+{
+    recthread_t *t;
+    recbuf_t *b;
+    recevent_t *e;
+
+    if (__atomic_load_n(&rec_state, __ATOMIC_ACQUIRE) != REC_ON)
+	return;
+    in_hook = 1;
+    if ((t = rec_self()) == NULL)
+	goto out;
+
+    b = __atomic_load_n(&t->buf, __ATOMIC_ACQUIRE);
+    if (b == NULL || b->hdr.n == RECBUF_EVENTS) {
+	/* rec_fini may have taken b in the meantime; then it is gone */
+	if (b != NULL &&
+	    __atomic_exchange_n(&t->buf, NULL, __ATOMIC_ACQ_REL) == b)
+	    push_full(b);
+	if ((b = new_buf(t - threads)) == NULL)
+	    goto out;
+	__atomic_store_n(&t->buf, b, __ATOMIC_RELEASE);
+    }
+
+    e = &b->ev[b->hdr.n];
+    e->seq = __atomic_fetch_add(&rec_seq, 1, __ATOMIC_RELAXED);
+    e->ptr = (unsigned long long)(size_t)ptr;
+    e->old = (unsigned long long)(size_t)old;
+    e->info = ((unsigned long long)size << REC_TYPE_BITS) | type;
+    /* publish the event to a rec_fini running on another thread */
+    __atomic_store_n(&b->hdr.n, b->hdr.n + 1, __ATOMIC_RELEASE);
+ out:
+    in_hook = 0;
+}
+
+/***************************************************
+ * Setup and teardown
+ ***************************************************/
+
+/* rec_resolve - look up the real allocator functions */
+static void rec_resolve(void)
+{
+    real_malloc = dlsym(RTLD_NEXT, "malloc");
+    real_free = dlsym(RTLD_NEXT, "free");
+    real_calloc = dlsym(RTLD_NEXT, "calloc");
+    real_realloc = dlsym(RTLD_NEXT, "realloc");
+    real_memalign = dlsym(RTLD_NEXT, "memalign");
+    real_posix_memalign = dlsym(RTLD_NEXT, "posix_memalign");
+    real_aligned_alloc = dlsym(RTLD_NEXT, "aligned_alloc");
+}
+
+/* rec_atfork_child - a forked child inherits no writer, so stop recording */
+static void rec_atfork_child(void)
+{
+    rec_state = REC_DONE;
+    self = NULL;
+}
+
+/*
+ * rec_init - resolve the real allocator and start recording. Runs as a
+ *     constructor, and earlier if the program allocates before that.
+ */
+__attribute__((constructor))
+static void rec_init(void)
+{
+    char *s, *root, pid[16];
+
+    if (rec_state != REC_OFF)
+	return;
+    rec_state = REC_INIT;
+    in_hook = 1;
+    rec_resolve();
+
+    if ((s = getenv("MMRECORD_OUT")) == NULL)
+	snprintf(out_path, MAXPATH, "mmrecord.%d.rep", (int)getpid());
+    else if ((root = getenv("MMRECORD_PID")) == NULL || atoi(root) == getpid()) {
+	snprintf(out_path, MAXPATH, "%s", s);
+	snprintf(pid, sizeof(pid), "%d", (int)getpid());
+	setenv("MMRECORD_PID", pid, 1);
+    } else	/* a child, which inherits LD_PRELOAD: keep off our files */
+	snprintf(out_path, MAXPATH, "%s.%d", s, (int)getpid());
+    snprintf(raw_path, sizeof(raw_path), "%s.raw", out_path);
+
+    threads = mmap(NULL, REC_MAXTHREADS * sizeof(recthread_t),
+		   PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    raw_fd = open(raw_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (threads == MAP_FAILED || raw_fd < 0 ||
+	pthread_key_create(&thread_key, rec_thread_exit) != 0) {
+	fprintf(stderr, "mmrecord: cannot record to %s\n", raw_path);
+	rec_state = REC_DONE;
+	in_hook = 0;
+	return;
+    }
+    pthread_atfork(NULL, NULL, rec_atfork_child);
+
+    rec_state = REC_ON;
+    if (pthread_create(&flusher, NULL, flush_thread, NULL) != 0) {
+	fprintf(stderr, "mmrecord: cannot start writer thread\n");
+	rec_state = REC_DONE;
+    }
+    in_hook = 0;
+}
+
+/*
+ * rec_fini - stop recording, write what is left and convert the log
+ */
+__attribute__((destructor))
+static void rec_fini(void)
+{
+    unsigned int i, n;
+    char *s;
+    int format = TRACE_TEXT;
+
+    if (rec_state != REC_ON)
+	return;
+    in_hook = 1;
+    __atomic_store_n(&rec_state, REC_DONE, __ATOMIC_RELEASE);
+    pthread_join(flusher, NULL);
+
+    /*
+     * Sweep up the partial buffers of every thread that ever recorded.
+     * Threads still running may be in rec with theirs, so they are
+     * written as they stand and left mapped.
+     */
+    write_full(0);
+    n = __atomic_load_n(&nthreads, __ATOMIC_ACQUIRE);
+    for (i = 0; i < n && i < REC_MAXTHREADS; i++)
+	rec_thread_exit(&threads[i]);
+    write_full(1);
+    close(raw_fd);
+
+    if ((s = getenv("MMRECORD_FORMAT")) != NULL) {
+	if (strcmp(s, "binary") == 0)
+	    format = TRACE_BINARY;
+	else if (strcmp(s, "packed") == 0)
+	    format = TRACE_PACKED;
+    }
+    if (rec_convert(raw_path, out_path, format) < 0)
+	fprintf(stderr, "mmrecord: converting %s failed: %s\n",
+		raw_path, strerror(errno));
+    else if (getenv("MMRECORD_KEEP") == NULL)
+	unlink(raw_path);
+}
+
+/***************************************************
+ * The interposed allocator entry points
+ ***************************************************/
+
+/* boot_alloc - serve requests made while dlsym resolves the real calls */
+static void *boot_alloc(size_t size)
+{
+    void *p;
+
+    size = (size + 15) & ~(size_t)15;
+    if (boot_used + size > BOOT_HEAP)
+	return NULL;
+    p = boot_heap + boot_used;
+    boot_used += size;
+    return p;
+}
+
+EXPORT void *malloc(size_t size)
+{
+    void *p;
+
+    if (real_malloc == NULL) {
+	if (rec_state == REC_INIT)
+	    return boot_alloc(size);
+	rec_init();
+    }
+    p = real_malloc(size);
+    if (p != NULL && !in_hook)
+	rec(REC_MALLOC, p, NULL, size);
+    return p;
+}
+
+EXPORT void free(void *ptr)
+{
+    if (ptr == NULL || IN_BOOT_HEAP(ptr))
+	return;
+    if (real_free == NULL)
+	rec_init();
+    /* Record first, so that any reuse of ptr is ordered after the free */
+    if (!in_hook)
+	rec(REC_FREE, ptr, NULL, 0);
+    real_free(ptr);
+}
+
+EXPORT void *calloc(size_t n, size_t m)
+{
+    void *p;
+
+    if (real_calloc == NULL) {
+	if (rec_state == REC_INIT)
+	    return boot_alloc(n * m);  /* boot_heap is zero already */
+	rec_init();
+    }
+    p = real_calloc(n, m);
+    if (p != NULL && !in_hook)
+	rec(REC_CALLOC, p, NULL, n * m);
+    return p;
+}
+
+EXPORT void *realloc(void *ptr, size_t size)
+{
+    void *p;
+
+    if (real_realloc == NULL)
+	rec_init();
+    if (IN_BOOT_HEAP(ptr)) {
+	size_t avail = boot_heap + BOOT_HEAP - (char *)ptr;
+
+	if ((p = malloc(size)) != NULL)
+	    memcpy(p, ptr, (size < avail) ? size : avail);
+	return p;
+    }
+    p = real_realloc(ptr, size);
+    if (!in_hook) {
+	if (p != NULL)
+	    rec(ptr ? REC_REALLOC : REC_MALLOC, p, ptr, size);
+	else if (size == 0 && ptr != NULL)
+	    rec(REC_FREE, ptr, NULL, 0);
+    }
+    return p;
+}
+
+EXPORT void *memalign(size_t align, size_t size)
+{
+    void *p;
+
+    if (real_memalign == NULL)
+	rec_init();
+    p = real_memalign(align, size);
+    if (p != NULL && !in_hook)
+	rec(REC_MEMALIGN, p, (void *)align, size);
+    return p;
+}
+
+EXPORT int posix_memalign(void **memptr, size_t align, size_t size)
+{
+    int err;
+
+    if (real_posix_memalign == NULL)
+	rec_init();
+    err = real_posix_memalign(memptr, align, size);
+    if (err == 0 && !in_hook)
+	rec(REC_MEMALIGN, *memptr, (void *)align, size);
+    return err;
+}
+
+EXPORT void *aligned_alloc(size_t align, size_t size)
+{
+    void *p;
+
+    if (real_aligned_alloc == NULL)
+	rec_init();
+    p = real_aligned_alloc(align, size);
+    if (p != NULL && !in_hook)
+	rec(REC_MEMALIGN, p, (void *)align, size);
+    return p;
+}
@@ -0,0 +1,68 @@
+#ifndef __MMSTATS_H_
+#define __MMSTATS_H_
+
+/*
+ * mmstats.h - optional counters on the allocator's hot paths
+ *
+ * Build with -DMM_STATS (make mdriver-stats) to have mm.c count what it
+ * does on each call: free list nodes visited, which coalesce case ran,
+ * splits, heap extensions, realloc paths, the memsets mm_calloc
+ * could skip, the batch calls and the sized frees. The counters are per
+ * thread. In normal builds MM_STAT and MM_STAT_ADD expand to nothing
+ * and mm_counters does not exist.
+ */
+
+/* Paths through mm_realloc */
+enum {
+    MM_REALLOC_MALLOC,     /* ptr was NULL: plain malloc */
+    MM_REALLOC_FREE,       /* size was 0: plain free */
+    MM_REALLOC_INPLACE,    /* block was already big enough */
+    MM_REALLOC_NEXT,       /* grew into the next block (or the heap top) */
+    MM_REALLOC_PREV,       /* grew into the previous block */
+    MM_REALLOC_BOTH,       /* grew into both neighbours */
+    MM_REALLOC_MOVE,       /* malloc, copy and free */
+    MM_REALLOC_NPATHS
+};
+
+/* Coalesce cases, by which neighbours were free */
+enum {MM_COALESCE_NONE, MM_COALESCE_PREV, MM_COALESCE_NEXT, MM_COALESCE_BOTH};
+
+#ifdef MM_STATS
+
+typedef struct {
+    unsigned long long mallocs;         /* calls to mm_malloc */
+    unsigned long long frees;           /* calls to mm_free(_sized) */
+    unsigned long long sized_frees;     /* calls to mm_free_sized */
+    unsigned long long sized_hits;      /* ... that went straight onto a free list */
+    unsigned long long reallocs;        /* calls to mm_realloc */
+    unsigned long long callocs;         /* calls to mm_calloc */
+    unsigned long long calloc_zero;     /* ... that got known-zero memory */
+    unsigned long long batch_mallocs;   /* calls to mm_malloc_batch */
+    unsigned long long batch_frees;     /* calls to mm_free_batch */
+    unsigned long long batch_merges;    /* blocks it merged without coalesce */
+    unsigned long long find_lists;      /* free lists looked at for a fit */
+    unsigned long long find_visits;     /* free blocks looked at for a fit */
+    unsigned long long insert_visits;   /* blocks passed inserting into a list */
+    unsigned long long coalesce[4];     /* by MM_COALESCE_xxx */
+    unsigned long long splits;          /* placements that split a block */
+    unsigned long long nosplits;        /* placements that used it whole */
+    unsigned long long extends;         /* calls to extend_heap */
+    unsigned long long extend_bytes;    /* bytes they asked mem_sbrk for */
+    unsigned long long releases;        /* free blocks given to mem_release */
+    unsigned long long release_bytes;   /* bytes in them */
+    unsigned long long realloc_path[MM_REALLOC_NPATHS];
+} mm_counters_t;
+
+extern __thread mm_counters_t mm_counters;
+
+#define MM_STAT(field) (mm_counters.field++)
+#define MM_STAT_ADD(field, n) (mm_counters.field += (n))
+
+#else
+
+#define MM_STAT(field)
+#define MM_STAT_ADD(field, n)
+
+#endif /* MM_STATS */
+
+#endif /* __MMSTATS_H_ */
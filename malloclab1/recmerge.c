@@ -0,0 +1,273 @@
+/*
+ * recmerge.c - turn a raw libmmrecord.so event log into a trace file
+ *
+ * The log's blocks are each sorted by sequence number, so a k-way merge
+ * over them with a small heap yields the events in global order while
+ * reading the (mapped) log exactly once. Live pointers are renamed to
+ * dense ids as they are allocated; an id keeps its name across
+ * reallocs and is retired when its block is freed.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "record.h"
+#include "trace.h"
+
+/* A cursor into one block of the raw log */
+typedef struct {
+    recevent_t *ev;    /* next event */
+    recevent_t *end;   /* one past the block's last event */
+} cursor_t;
+
+/* Open-addressed map from live pointers to their ids */
+typedef struct {
+    unsigned long long ptr;   /* 0 marks an empty slot */
+    int id;
+} ptrslot_t;
+
+typedef struct {
+    ptrslot_t *slots;
+    size_t mask;
+    size_t count;
+} ptrmap_t;
+
+#define PTR_HASH(m, p) ((size_t)(((p) >> 4) * 0x9E3779B97F4A7C15ull) & (m)->mask)
+
+static int ptrmap_init(ptrmap_t *m, size_t nslots)
+{
+    if ((m->slots = calloc(nslots, sizeof(ptrslot_t))) == NULL)
+	return -1;
+    m->mask = nslots - 1;
+    m->count = 0;
+    return 0;
+}
+
+static ptrslot_t *ptrmap_find(ptrmap_t *m, unsigned long long p)
+{
+    size_t i;
+
+    for (i = PTR_HASH(m, p); m->slots[i].ptr != 0; i = (i + 1) & m->mask)
+	if (m->slots[i].ptr == p)
+	    return &m->slots[i];
+    return NULL;
+}
+
+static int ptrmap_put(ptrmap_t *m, unsigned long long p, int id)
+{
+    ptrmap_t bigger;
+    size_t i;
+
+    if (2 * (m->count + 1) > m->mask + 1) {
+	if (ptrmap_init(&bigger, 2 * (m->mask + 1)) < 0)
+	    return -1;
+	for (i = 0; i <= m->mask; i++)
+	    if (m->slots[i].ptr != 0)
+		ptrmap_put(&bigger, m->slots[i].ptr, m->slots[i].id);
+	free(m->slots);
+	*m = bigger;
+    }
+    for (i = PTR_HASH(m, p); m->slots[i].ptr != 0; i = (i + 1) & m->mask)
+	;
+    m->slots[i].ptr = p;
+    m->slots[i].id = id;
+    m->count++;
+    return 0;
+}
+
+/* ptrmap_remove - delete slot s, shifting its probe run back over it */
+static void ptrmap_remove(ptrmap_t *m, ptrslot_t *s)
+{
+    size_t i = s - m->slots;
+    size_t j, home;
+
+    for (j = (i + 1) & m->mask; m->slots[j].ptr != 0; j = (j + 1) & m->mask) {
+	home = PTR_HASH(m, m->slots[j].ptr);
+	if (((j - home) & m->mask) >= ((j - i) & m->mask)) {
+	    m->slots[i] = m->slots[j];
+	    i = j;
+	}
+    }
+    m->slots[i].ptr = 0;
+    m->count--;
+}
+
+/* Min-heap of cursors ordered by the sequence number of their next event */
+static void sift_down(cursor_t *heap, int n, int i)
+{
+    cursor_t tmp;
+    int c;
+
+    for (;;) {
+	c = 2 * i + 1;
+	if (c >= n)
+	    return;
+	if (c + 1 < n && heap[c + 1].ev->seq < heap[c].ev->seq)
+	    c++;
+	if (heap[i].ev->seq <= heap[c].ev->seq)
+	    return;
+	tmp = heap[i];
+	heap[i] = heap[c];
+	heap[c] = tmp;
+	i = c;
+    }
+}
+
+/*
+ * rec_convert - merge the raw log at rawpath into a trace at tracepath
+ *     in the given TRACE_xxx format. Returns -1 on error.
+ */
+int rec_convert(char *rawpath, char *tracepath, int format)
+{
+    struct stat st;
+    char *map = NULL, *p, *end;
+    recblock_t *blk;
+    cursor_t *heap = NULL;
+    int nblocks = 0, maxblocks = 0, n;
+    int fd, next_id = 0, ret = -1;
+    ptrmap_t live;
+    ptrslot_t *s;
+    recevent_t *e;
+    traceop_t op;
+    tracewriter_t w;
+    long long live_bytes = 0, peak_bytes = 0;
+    unsigned long long *sizes = NULL;
+    int maxsizes = 0;
+
+    if ((fd = open(rawpath, O_RDONLY)) < 0)
+	return -1;
+    if (fstat(fd, &st) < 0) {
+	close(fd);
+	return -1;
+    }
+    if (st.st_size > 0) {
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED) {
+	    close(fd);
+	    return -1;
+	}
+	madvise(map, st.st_size, MADV_SEQUENTIAL);
+    }
+    close(fd);
+
+    /* Find the blocks; each one becomes a cursor on the heap */
+    end = map + st.st_size;
+    for (p = map; p + sizeof(recblock_t) <= end; ) {
+	blk = (recblock_t *)p;
+	p += sizeof(recblock_t);
+	if (p + (size_t)blk->n * sizeof(recevent_t) > end)
+	    break;  /* torn final block */
+	if (blk->n > 0) {
+	    if (nblocks == maxblocks) {
+		maxblocks = maxblocks ? 2 * maxblocks : 64;
+		if ((heap = realloc(heap, maxblocks * sizeof(cursor_t))) == NULL)
+		    goto out;
+	    }
+	    heap[nblocks].ev = (recevent_t *)p;
+	    heap[nblocks].end = (recevent_t *)p + blk->n;
+	    nblocks++;
+	}
+	p += (size_t)blk->n * sizeof(recevent_t);
+    }
+    for (n = nblocks / 2 - 1; n >= 0; n--)
+	sift_down(heap, nblocks, n);
+
+    if (ptrmap_init(&live, 1024) < 0)
+	goto out;
+    if (trace_wopen(&w, tracepath, format, 0, -1, -1, 1) < 0)
+	goto out_map;
+
+    while (nblocks > 0) {
+	e = heap[0].ev++;
+	if (heap[0].ev == heap[0].end)
+	    heap[0] = heap[--nblocks];
+	sift_down(heap, nblocks, 0);
+
+	op.size = e->info >> REC_TYPE_BITS;
+	op.lgalign = 0;
+	switch (e->info & ((1 << REC_TYPE_BITS) - 1)) {
+	case REC_FREE:
+	    if ((s = ptrmap_find(&live, e->ptr)) == NULL)
+		continue;  /* allocated before recording started */
+	    op.type = FREE;
+	    op.index = s->id;
+	    op.size = 0;
+	    live_bytes -= sizes[s->id];
+	    ptrmap_remove(&live, s);
+	    break;
+
+	case REC_REALLOC:
+	    if ((s = ptrmap_find(&live, e->old)) != NULL) {
+		op.type = REALLOC;
+		op.index = s->id;
+		live_bytes -= sizes[s->id];
+		ptrmap_remove(&live, s);
+		break;
+	    }
+	    /* realloc of an unknown block: treat it as a fresh allocation */
+	    /* fall through */
+	default: /* REC_MALLOC, REC_CALLOC, REC_MEMALIGN */
+	    op.type = ALLOC;
+	    if ((e->info & ((1 << REC_TYPE_BITS) - 1)) == REC_CALLOC)
+		op.type = CALLOC;
+	    if ((e->info & ((1 << REC_TYPE_BITS) - 1)) == REC_MEMALIGN &&
+		e->old != 0) {
+		op.type = MEMALIGN;
+		op.lgalign = 63 - __builtin_clzll(e->old);
+	    }
+	    op.index = next_id++;
+	    if (op.index >= maxsizes) {
+		maxsizes = maxsizes ? 2 * maxsizes : 1024;
+		if ((sizes = realloc(sizes, maxsizes * sizeof(unsigned long long))) == NULL)
+		    goto out_w;
+	    }
+	    break;
+	}
+
+	if (op.type != FREE) {
+	    /*
+	     * A block that is still live under another id was freed by one
+	     * thread and reused by another before the free's event was
+	     * ordered; retire the stale id first.
+	     */
+	    if ((s = ptrmap_find(&live, e->ptr)) != NULL) {
+		traceop_t fop;
+
+		fop.type = FREE;
+		fop.lgalign = 0;
+		fop.index = s->id;
+		fop.size = 0;
+		live_bytes -= sizes[s->id];
+		ptrmap_remove(&live, s);
+		trace_wop(&w, &fop);
+	    }
+	    if (ptrmap_put(&live, e->ptr, op.index) < 0)
+		goto out_w;
+	    sizes[op.index] = op.size;
+	    live_bytes += op.size;
+	    if (live_bytes > peak_bytes)
+		peak_bytes = live_bytes;
+	}
+	trace_wop(&w, &op);
+    }
+    ret = 0;
+
+ out_w:
+    w.hdr.sugg_heapsize = (peak_bytes > INT_MAX) ? INT_MAX : (int)peak_bytes;
+    if (trace_wclose(&w) < 0)
+	ret = -1;
+ out_map:
+    free(live.slots);
+ out:
+    free(sizes);
+    free(heap);
+    if (map != NULL)
+	munmap(map, st.st_size);
+    return ret;
+}
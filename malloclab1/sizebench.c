@@ -0,0 +1,302 @@
+/*
+ * sizebench.c - latency of mm.c and libc malloc across request sizes
+ *
+ *     unix> sizebench [-p points] [-m maxsize] [-b budget] [-a alloc] > sizes.csv
+ *
+ * Sweeps request sizes on a log scale from 1 byte to maxsize (16 MB),
+ * with points per octave, and also 2^k+1 for every k so the step at
+ * each power of 2 shows (malloclab1 stops rounding up to a power of 2
+ * above 4096 bytes, and both engines grow the heap in 4 KB chunks). At
+ * each size it measures, for each allocator:
+ *
+ *   pair        a malloc and a free of the same block, over and over
+ *   lifo1k      1000 mallocs, then the frees in the reverse order
+ *   fifo1k      1000 mallocs, then the frees in the same order
+ *   lifo100k    the same with 100000 blocks
+ *   fifo100k
+ *   realloc     a block grown by doubling reallocs (up to 10 of them,
+ *               within maxsize), then freed
+ *
+ * Batches are cut down so they never hold more than budget bytes
+ * (256 MB); the count column says how many blocks were used, or for
+ * the chains how many reallocs each one made. Every measurement is
+ * repeated and the fastest run is kept, so the figures are
+ * steady-state costs. mm.c starts each run on a fresh heap.
+ * The output is CSV with one row per allocator, test and size, the
+ * time in ns per malloc+free pair (per realloc for the chains).
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <math.h>
+
+#include "mm.h"
+#include "memlib.h"
+#include "ftimer.h"
+
+#define MAXSIZES   1024
+#define MAXCHAIN   10         /* doublings in a realloc chain */
+#define PAIRS      10000      /* malloc/free pairs in one pair run */
+#define CHAINS     100        /* chains in one realloc run */
+#define RUNS       5          /* runs of each measurement, fastest kept */
+
+/* An allocator under test */
+typedef struct {
+    char *name;
+    void (*reset)(void);               /* start from an empty heap */
+    void *(*malloc)(size_t size);
+    void (*free)(void *ptr);
+    void *(*realloc)(void *ptr, size_t size);
+} alloc_t;
+
+static void mm_reset(void);
+static void libc_reset(void);
+
+static alloc_t allocs[] = {
+    {"mm", mm_reset, mm_malloc, mm_free, mm_realloc},
+    {"libc", libc_reset, malloc, free, realloc},
+};
+#define NALLOCS (int)(sizeof(allocs) / sizeof(alloc_t))
+
+static void **blocks;                  /* the blocks of a batch */
+static size_t budget = 256 << 20;      /* most bytes live in a batch */
+static size_t maxsize = 16 << 20;      /* largest request */
+
+/* function prototypes */
+static void usage(void);
+
+static void mm_reset(void)
+{
+    mem_reset_brk();
+    if (mm_init() < 0) {
+	printf("mm_init failed\n");
+	exit(1);
+    }
+}
+
+static void libc_reset(void)
+{
+}
+
+/*
+ * fail - report an allocator that came back with NULL and give up
+ */
+static void fail(alloc_t *a, char *test, size_t size)
+{
+    fprintf(stderr, "sizebench: %s returned NULL in %s at %lu bytes\n",
+	    a->name, test, (unsigned long)size);
+    exit(1);
+}
+
+/*
+ * run_pairs - secs for PAIRS malloc+free pairs of size bytes
+ */
+static double run_pairs(alloc_t *a, size_t size)
+{
+    double t;
+    void *p;
+    int i;
+
+    t = ftimer_now();
+    for (i = 0; i < PAIRS; i++) {
+	if ((p = a->malloc(size)) == NULL)
+	    fail(a, "pair", size);
+	a->free(p);
+    }
+    return ftimer_now() - t;
+}
+
+/*
+ * run_batch - secs for n mallocs of size bytes followed by their frees,
+ *     in reverse order if lifo and in the same order otherwise
+ */
+static double run_batch(alloc_t *a, size_t size, int n, int lifo)
+{
+    double t;
+    int i;
+
+    t = ftimer_now();
+    for (i = 0; i < n; i++)
+	if ((blocks[i] = a->malloc(size)) == NULL)
+	    fail(a, "batch", size);
+    if (lifo)
+	for (i = n - 1; i >= 0; i--)
+	    a->free(blocks[i]);
+    else
+	for (i = 0; i < n; i++)
+	    a->free(blocks[i]);
+    return ftimer_now() - t;
+}
+
+/*
+ * chain_length - reallocs in a doubling chain that starts at size
+ */
+static int chain_length(size_t size)
+{
+    int k;
+
+    for (k = 0; k < MAXCHAIN && (size << (k + 1)) <= maxsize; k++)
+	;
+    return k;
+}
+
+/*
+ * run_chains - secs for CHAINS doubling realloc chains from size bytes,
+ *     not counting the malloc that starts each chain or the final free
+ */
+static double run_chains(alloc_t *a, size_t size, int len)
+{
+    double t, secs = 0;
+    void *p;
+    int i, k;
+
+    for (i = 0; i < CHAINS; i++) {
+	if ((p = a->malloc(size)) == NULL)
+	    fail(a, "realloc", size);
+	t = ftimer_now();
+	for (k = 1; k <= len; k++)
+	    if ((p = a->realloc(p, size << k)) == NULL)
+		fail(a, "realloc", size << k);
+	secs += ftimer_now() - t;
+	a->free(p);
+    }
+    return secs;
+}
+
+/*
+ * measure - time one test RUNS times, each on a fresh heap, and
+ *     print the fastest in ns per op
+ */
+static void measure(alloc_t *a, char *test, size_t size, int n)
+{
+    double secs, best = -1;
+    int r, ops = n;
+
+    for (r = 0; r < RUNS; r++) {
+	a->reset();
+	if (strcmp(test, "pair") == 0) {
+	    secs = run_pairs(a, size);
+	    ops = PAIRS;
+	}
+	else if (strcmp(test, "realloc") == 0) {
+	    secs = run_chains(a, size, n);
+	    ops = CHAINS * n;
+	}
+	else
+	    secs = run_batch(a, size, n, test[0] == 'l');
+	if (best < 0 || secs < best)
+	    best = secs;
+    }
+    printf("%s,%s,%lu,%d,%.1f\n", a->name, test, (unsigned long)size, n,
+	   best * 1e9 / ops);
+    fflush(stdout);
+}
+
+/*
+ * make_sizes - fill sizes[] with the sweep, in increasing order;
+ *     returns how many there are
+ */
+static int make_sizes(size_t *sizes, int points)
+{
+    size_t s, last = 0;
+    int n = 0, k, j;
+
+    for (k = 0; ((size_t)1 << k) <= maxsize && n < MAXSIZES - points - 1; k++) {
+	for (j = 0; j < points; j++) {
+	    s = (size_t)floor(pow(2.0, k + (double)j / points) + 0.5);
+	    if (s > last && s <= maxsize)
+		sizes[n++] = last = s;
+	    if (j == 0 && s + 1 > last && s + 1 <= maxsize)
+		sizes[n++] = last = s + 1;
+	}
+    }
+    return n;
+}
+
+int main(int argc, char **argv)
+{
+    static char *batch_tests[4] = {"lifo1k", "fifo1k", "lifo100k", "fifo100k"};
+    static int batch_sizes[4] = {1000, 1000, 100000, 100000};
+    size_t sizes[MAXSIZES];
+    int which = 3, points = 4;
+    int c, i, a, t, n, nsizes;
+
+    while ((c = getopt(argc, argv, "p:m:b:a:h")) != EOF) {
+	switch (c) {
+	case 'p': /* Points per octave */
+	    points = atoi(optarg);
+	    break;
+	case 'm': /* Largest request */
+	    maxsize = strtoul(optarg, NULL, 0);
+	    break;
+	case 'b': /* Most bytes live in a batch */
+	    budget = strtoul(optarg, NULL, 0);
+	    break;
+	case 'a': /* Which allocators */
+	    if (strcmp(optarg, "mm") == 0)
+		which = 1;
+	    else if (strcmp(optarg, "libc") == 0)
+		which = 2;
+	    else if (strcmp(optarg, "all") == 0)
+		which = 3;
+	    else {
+		usage();
+		exit(1);
+	    }
+	    break;
+	case 'h':
+	    usage();
+	    exit(0);
+	default:
+	    usage();
+	    exit(1);
+	}
+    }
+    if (points < 1 || points > 64 || maxsize < 1 || budget < 1) {
+	usage();
+	exit(1);
+    }
+
+    if ((blocks = malloc(100000 * sizeof(void *))) == NULL) {
+	printf("Out of memory for the batch array\n");
+	exit(1);
+    }
+    nsizes = make_sizes(sizes, points);
+    mem_init();
+
+    printf("alloc,test,size,count,ns\n");
+    for (i = 0; i < nsizes; i++) {
+	for (a = 0; a < NALLOCS; a++) {
+	    if (!(which & (1 << a)))
+		continue;
+	    measure(&allocs[a], "pair", sizes[i], 1);
+	    for (t = 0; t < 4; t++) {
+		n = batch_sizes[t];
+		if ((size_t)n * sizes[i] > budget)
+		    n = budget / sizes[i] > 0 ? budget / sizes[i] : 1;
+		measure(&allocs[a], batch_tests[t], sizes[i], n);
+	    }
+	    if ((n = chain_length(sizes[i])) > 0)
+		measure(&allocs[a], "realloc", sizes[i], n);
+	}
+    }
+
+    mem_deinit();
+    free(blocks);
+    exit(0);
+}
+
+/*
+ * usage - Explain the command line arguments
+ */
+static void usage(void)
+{
+    fprintf(stderr, "Usage: sizebench [-h] [-p <points>] [-m <maxsize>] [-b <budget>] [-a <alloc>]\n");
+    fprintf(stderr, "Options\n");
+    fprintf(stderr, "\t-p <points>  Sizes per octave, besides each 2^k+1 (4).\n");
+    fprintf(stderr, "\t-m <maxsize> Largest request in bytes (16777216).\n");
+    fprintf(stderr, "\t-b <budget>  Most bytes live in one batch (268435456).\n");
+    fprintf(stderr, "\t-a <alloc>   Allocators to run: mm, libc or all.\n");
+    fprintf(stderr, "\t-h           Print this message.\n");
+}
@@ -0,0 +1,327 @@
+/*
+ * stream.c - chunked trace reader with double-buffered readahead
+ *
+ * The reader thread and the consumer pass the two chunk buffers back
+ * and forth: the reader fills buffer k and marks it full, then moves on
+ * to buffer k^1 as soon as the consumer has handed that one back. A
+ * zero-length chunk marks the end of the trace.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "stream.h"
+#include "trace.h"
+
+#define STREAM_RAWSIZE (1<<20)  /* bytes of packed data read at a time */
+#define MAXLINE 1024
+
+/* function prototypes */
+static void *stream_reader(void *arg);
+static int fill_text(stream_t *s, traceop_t *ops, int max);
+static int fill_binary(stream_t *s, traceop_t *ops, int max);
+static int fill_packed(stream_t *s, traceop_t *ops, int max);
+
+/*
+ * stream_open - open the trace at path, read its header and start the
+ *     reader thread. Returns -1 (with errno set) if the file can't be
+ *     read.
+ */
+int stream_open(stream_t *s, char *path)
+{
+    char magic[sizeof(TRACE_MAGIC)];
+    tracehdr_t hdr;
+    int k, err;
+
+    memset(s, 0, sizeof(stream_t));
+    if ((s->fp = fopen(path, "r")) == NULL)
+	return -1;
+
+    if (fread(magic, 1, sizeof(magic), s->fp) == sizeof(magic) &&
+	memcmp(magic, TRACE_MAGIC, sizeof(magic)) == 0) {
+	rewind(s->fp);
+	if (fread(&hdr, sizeof(hdr), 1, s->fp) != 1 ||
+	    hdr.version < 1 || hdr.version > TRACE_VERSION) {
+	    fclose(s->fp);
+	    errno = EINVAL;
+	    return -1;
+	}
+	s->sugg_heapsize = hdr.sugg_heapsize;
+	s->num_ids = hdr.num_ids;
+	s->num_ops = hdr.num_ops;
+	s->weight = hdr.weight;
+	s->version = hdr.version;
+	s->format = (hdr.flags & TRACE_VARINT) ? TRACE_PACKED : TRACE_BINARY;
+    }
+    else {
+	rewind(s->fp);
+	if (fscanf(s->fp, "%d %d %d %d", &s->sugg_heapsize, &s->num_ids,
+		   &s->num_ops, &s->weight) != 4) {
+	    fclose(s->fp);
+	    errno = EINVAL;
+	    return -1;
+	}
+	s->format = TRACE_TEXT;
+    }
+
+    memset(s->last, 0xff, sizeof(s->last));
+    if (s->format == TRACE_PACKED &&
+	(s->raw = malloc(STREAM_RAWSIZE)) == NULL)
+	goto fail;
+    for (k = 0; k < 2; k++)
+	if ((s->buf[k] = malloc(STREAM_CHUNK * sizeof(traceop_t))) == NULL)
+	    goto fail;
+
+    s->held = -1;
+    pthread_mutex_init(&s->lock, NULL);
+    pthread_cond_init(&s->cond, NULL);
+    if ((errno = pthread_create(&s->reader, NULL, stream_reader, s)) != 0) {
+	pthread_mutex_destroy(&s->lock);
+	pthread_cond_destroy(&s->cond);
+	goto fail;
+    }
+    return 0;
+
+ fail:
+    err = errno;
+    fclose(s->fp);
+    free(s->buf[0]);
+    free(s->buf[1]);
+    free(s->raw);
+    errno = err;
+    return -1;
+}
+
+/*
+ * stream_next - hand back the previous chunk and wait for the next one.
+ *     Returns NULL at the end of the trace; *n is the chunk's op count.
+ */
+traceop_t *stream_next(stream_t *s, int *n)
+{
+    traceop_t *ops;
+
+    pthread_mutex_lock(&s->lock);
+    if (s->held >= 0) {
+	s->full[s->held] = 0;
+	s->held = -1;
+	pthread_cond_broadcast(&s->cond);
+    }
+    while (!s->full[s->cur])
+	pthread_cond_wait(&s->cond, &s->lock);
+    *n = s->len[s->cur];
+    pthread_mutex_unlock(&s->lock);
+
+    if (*n == 0)
+	return NULL;
+    ops = s->buf[s->cur];
+    s->held = s->cur;
+    s->cur ^= 1;
+    return ops;
+}
+
+/*
+ * stream_close - stop the reader thread and release the stream.
+ *     Returns -1 if the trace was malformed.
+ */
+int stream_close(stream_t *s)
+{
+    pthread_mutex_lock(&s->lock);
+    s->done = 1;
+    pthread_cond_broadcast(&s->cond);
+    pthread_mutex_unlock(&s->lock);
+    pthread_join(s->reader, NULL);
+
+    pthread_mutex_destroy(&s->lock);
+    pthread_cond_destroy(&s->cond);
+    fclose(s->fp);
+    free(s->buf[0]);
+    free(s->buf[1]);
+    free(s->raw);
+    return s->error ? -1 : 0;
+}
+
+/*
+ * stream_reader - body of the readahead thread
+ */
+static void *stream_reader(void *arg)
+{
+    stream_t *s = (stream_t *)arg;
+    int k = 0;
+    int n, done;
+
+    for (;;) {
+	/* Wait until the consumer has handed buffer k back */
+	pthread_mutex_lock(&s->lock);
+	while (s->full[k] && !s->done)
+	    pthread_cond_wait(&s->cond, &s->lock);
+	done = s->done;
+	pthread_mutex_unlock(&s->lock);
+	if (done)
+	    break;
+
+	if (s->ops_read >= s->num_ops)
+	    n = 0;
+	else if (s->format == TRACE_TEXT)
+	    n = fill_text(s, s->buf[k], STREAM_CHUNK);
+	else if (s->format == TRACE_BINARY)
+	    n = fill_binary(s, s->buf[k], STREAM_CHUNK);
+	else
+	    n = fill_packed(s, s->buf[k], STREAM_CHUNK);
+	if (n <= 0 && s->ops_read < s->num_ops)
+	    s->error = 1;
+	if (n < 0)
+	    n = 0;
+	s->ops_read += n;
+
+	pthread_mutex_lock(&s->lock);
+	s->len[k] = n;
+	s->full[k] = 1;
+	pthread_cond_broadcast(&s->cond);
+	pthread_mutex_unlock(&s->lock);
+
+	if (n == 0)
+	    break;
+	k ^= 1;
+    }
+    return NULL;
+}
+
+/*
+ * fill_text - parse up to max request lines
+ */
+static int fill_text(stream_t *s, traceop_t *ops, int max)
+{
+    char type[MAXLINE];
+    unsigned index;
+    unsigned long long size, align;
+    int n, lg;
+
+    for (n = 0; n < max && s->ops_read + n < s->num_ops; n++) {
+	if (fscanf(s->fp, "%s", type) == EOF)
+	    break;
+	switch (type[0]) {
+	case 'a':
+	case 'r':
+	case 'c':
+	    if (fscanf(s->fp, "%u %llu", &index, &size) != 2)
+		return -1;
+	    ops[n].type = (type[0] == 'a') ? ALLOC :
+		(type[0] == 'r') ? REALLOC : CALLOC;
+	    ops[n].lgalign = 0;
+	    ops[n].size = size;
+	    break;
+	case 'm':
+	    if (fscanf(s->fp, "%u %llu %llu", &index, &align, &size) != 3)
+		return -1;
+	    for (lg = 0; lg < 63 && (1ULL << lg) < align; lg++)
+		;
+	    if (align != (1ULL << lg))
+		return -1;
+	    ops[n].type = MEMALIGN;
+	    ops[n].lgalign = lg;
+	    ops[n].size = size;
+	    break;
+	case 'f':
+	    if (fscanf(s->fp, "%u", &index) != 1)
+		return -1;
+	    ops[n].type = FREE;
+	    ops[n].lgalign = 0;
+	    ops[n].size = 0;
+	    break;
+	case 'b':
+	    if (type[1] == 'a') {
+		if (fscanf(s->fp, "%u %llu", &index, &size) != 2)
+		    return -1;
+		ops[n].type = BALLOC;
+		ops[n].size = size;
+	    }
+	    else if (type[1] == 'f') {
+		if (fscanf(s->fp, "%u", &index) != 1)
+		    return -1;
+		ops[n].type = BFREE;
+		ops[n].size = 0;
+	    }
+	    else
+		return -1;
+	    ops[n].lgalign = 0;
+	    break;
+	default:
+	    return -1;
+	}
+	if (index >= (unsigned)s->num_ids)
+	    return -1;
+	ops[n].index = index;
+    }
+    return n;
+}
+
+/*
+ * fill_binary - read up to max ops of a plain binary trace. Version 1
+ *     ops are smaller, so they are read into the front of the buffer
+ *     and widened from the back. Returns -1 on an op with an unknown
+ *     type or an index past num_ids, as fill_text does.
+ */
+static int fill_binary(stream_t *s, traceop_t *ops, int max)
+{
+    traceop_v1_t *v1 = (traceop_v1_t *)ops, op;
+    int want = s->num_ops - s->ops_read;
+    int n, i;
+
+    if (want > max)
+	want = max;
+    if (s->version != 1)
+	n = fread(ops, sizeof(traceop_t), want, s->fp);
+    else {
+	n = fread(v1, sizeof(traceop_v1_t), want, s->fp);
+	for (i = n - 1; i >= 0; i--) {
+	    op = v1[i];
+	    ops[i].type = op.type;
+	    ops[i].lgalign = 0;
+	    ops[i].index = op.index;
+	    ops[i].size = (unsigned)op.size;
+	}
+    }
+
+    for (i = 0; i < n; i++)
+	if (ops[i].type >= NTYPES || ops[i].lgalign > 63 ||
+	    (unsigned)ops[i].index >= (unsigned)s->num_ids)
+	    return -1;
+    return n;
+}
+
+/*
+ * fill_packed - decode up to max ops of a packed trace, refilling the
+ *     raw byte buffer as it runs dry
+ */
+static int fill_packed(stream_t *s, traceop_t *ops, int max)
+{
+    const unsigned char *p;
+    size_t got;
+    int n = 0, k;
+
+    if (max > s->num_ops - s->ops_read)
+	max = s->num_ops - s->ops_read;
+
+    while (n < max) {
+	p = s->raw;
+	k = trace_unpack(&p, s->raw + s->rawlen, s->version, s->last,
+			 s->num_ids, ops + n, max - n);
+	if (k < 0)
+	    return -1;
+	n += k;
+
+	/* Keep the undecoded tail and top the buffer up behind it */
+	s->rawlen -= p - s->raw;
+	memmove(s->raw, p, s->rawlen);
+	if (n < max) {
+	    got = fread(s->raw + s->rawlen, 1, STREAM_RAWSIZE - s->rawlen,
+			s->fp);
+	    if (got == 0)
+		break;
+	    s->rawlen += got;
+	}
+    }
+    return n;
+}
@@ -0,0 +1,573 @@
+/*
+ * trace.c - read and write malloc lab trace files
+ *
+ * read_trace() accepts either trace format described in trace.h. Text
+ * traces are parsed with fscanf as they always have been. Plain binary
+ * traces are mapped read-only and the driver replays the op array
+ * straight out of the page cache; packed binary traces are decoded
+ * into a malloc'd op array in a single pass over the mapping.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <stdint.h>
+#include <limits.h>
+
+#include "trace.h"
+
+#define MAXLINE 1024 /* max string size */
+
+extern int verbose;  /* -v option in the driver */
+
+/* function prototypes */
+static void read_text(trace_t *trace, FILE *tracefile, char *path);
+static void read_binary(trace_t *trace, int fd, char *path);
+static int decode_ops(trace_t *trace, int version, const unsigned char *p,
+		      const unsigned char *end);
+static void alloc_blocks(trace_t *trace);
+static void check_sizes(trace_t *trace, char *path);
+static void check_ops(trace_t *trace, char *path);
+static void trace_error(char *msg, char *path);
+static void trace_unix_error(char *msg, char *path);
+
+/*
+ * read_trace - read a trace file and store it in memory
+ */
+trace_t *read_trace(char *tracedir, char *filename)
+{
+    FILE *tracefile;
+    trace_t *trace;
+    char path[MAXLINE];
+    char magic[sizeof(TRACE_MAGIC)];
+
+    if (verbose > 1)
+	printf("Reading tracefile: %s\n", filename);
+
+    /* Allocate the trace record */
+    if ((trace = (trace_t *) calloc(1, sizeof(trace_t))) == NULL)
+	trace_unix_error("malloc 1 failed in read_trace", NULL);
+
+    strcpy(path, tracedir);
+    strcat(path, filename);
+    if ((tracefile = fopen(path, "r")) == NULL)
+	trace_unix_error("Could not open", path);
+
+    /* Binary traces announce themselves with TRACE_MAGIC */
+    if (fread(magic, 1, sizeof(magic), tracefile) == sizeof(magic) &&
+	memcmp(magic, TRACE_MAGIC, sizeof(magic)) == 0)
+	read_binary(trace, fileno(tracefile), path);
+    else {
+	rewind(tracefile);
+	trace->format = TRACE_TEXT;
+	read_text(trace, tracefile, path);
+    }
+    fclose(tracefile);
+
+    check_sizes(trace, path);
+    alloc_blocks(trace);
+    return trace;
+}
+
+/*
+ * free_trace - Free the trace record and the three arrays it points
+ *              to, all of which were allocated in read_trace().
+ */
+void free_trace(trace_t *trace)
+{
+    if (trace->map != NULL)   /* unmap or free the ops... */
+	munmap(trace->map, trace->maplen);
+    else
+	free(trace->ops);
+    free(trace->blocks);      /* ... the per-id arrays... */
+    free(trace->block_sizes);
+    free(trace->block_sized);
+    free(trace);              /* and the trace record itself... */
+}
+
+/*
+ * read_text - parse a text (.rep) trace
+ */
+static void read_text(trace_t *trace, FILE *tracefile, char *path)
+{
+    char type[MAXLINE];
+    unsigned index;
+    unsigned long long size, align;
+    unsigned max_index = 0;
+    unsigned op_index;
+    int lg;
+
+    /* Read the trace file header */
+    fscanf(tracefile, "%d", &(trace->sugg_heapsize)); /* not used */
+    fscanf(tracefile, "%d", &(trace->num_ids));
+    fscanf(tracefile, "%d", &(trace->num_ops));
+    fscanf(tracefile, "%d", &(trace->weight));        /* not used */
+
+    /* We'll store each request line in the trace in this array */
+    if ((trace->ops =
+	 (traceop_t *)malloc(trace->num_ops * sizeof(traceop_t))) == NULL)
+	trace_unix_error("malloc 2 failed in read_trace", NULL);
+
+    /* read every request line in the trace file */
+    index = 0;
+    op_index = 0;
+    while (fscanf(tracefile, "%s", type) != EOF) {
+	switch(type[0]) {
+	case 'a':
+	    fscanf(tracefile, "%u %llu", &index, &size);
+	    trace->ops[op_index].type = ALLOC;
+	    trace->ops[op_index].lgalign = 0;
+	    trace->ops[op_index].index = index;
+	    trace->ops[op_index].size = size;
+	    max_index = (index > max_index) ? index : max_index;
+	    break;
+	case 'c':
+	    fscanf(tracefile, "%u %llu", &index, &size);
+	    trace->ops[op_index].type = CALLOC;
+	    trace->ops[op_index].lgalign = 0;
+	    trace->ops[op_index].index = index;
+	    trace->ops[op_index].size = size;
+	    max_index = (index > max_index) ? index : max_index;
+	    break;
+	case 'r':
+	    fscanf(tracefile, "%u %llu", &index, &size);
+	    trace->ops[op_index].type = REALLOC;
+	    trace->ops[op_index].lgalign = 0;
+	    trace->ops[op_index].index = index;
+	    trace->ops[op_index].size = size;
+	    max_index = (index > max_index) ? index : max_index;
+	    break;
+	case 'm':
+	    fscanf(tracefile, "%u %llu %llu", &index, &align, &size);
+	    for (lg = 0; lg < 63 && (1ULL << lg) < align; lg++)
+		;
+	    if (align != (1ULL << lg))
+		trace_error("Alignment not a power of 2 in tracefile", path);
+	    trace->ops[op_index].type = MEMALIGN;
+	    trace->ops[op_index].lgalign = lg;
+	    trace->ops[op_index].index = index;
+	    trace->ops[op_index].size = size;
+	    max_index = (index > max_index) ? index : max_index;
+	    break;
+	case 'f':
+	    fscanf(tracefile, "%ud", &index);
+	    trace->ops[op_index].type = FREE;
+	    trace->ops[op_index].lgalign = 0;
+	    trace->ops[op_index].index = index;
+	    trace->ops[op_index].size = 0;
+	    break;
+	case 'b':
+	    if (type[1] == 'a') {
+		fscanf(tracefile, "%u %llu", &index, &size);
+		trace->ops[op_index].type = BALLOC;
+		max_index = (index > max_index) ? index : max_index;
+	    }
+	    else if (type[1] == 'f') {
+		fscanf(tracefile, "%u", &index);
+		trace->ops[op_index].type = BFREE;
+		size = 0;
+	    }
+	    else {
+		printf("Bogus type (%s) in tracefile %s\n", type, path);
+		exit(1);
+	    }
+	    trace->ops[op_index].lgalign = 0;
+	    trace->ops[op_index].index = index;
+	    trace->ops[op_index].size = size;
+	    break;
+	default:
+	    printf("Bogus type character (%c) in tracefile %s\n",
+		   type[0], path);
+	    exit(1);
+	}
+	op_index++;
+
+    }
+    assert(max_index == trace->num_ids - 1);
+    assert(trace->num_ops == op_index);
+}
+
+/*
+ * read_binary - map a binary trace. Plain traces are replayed straight
+ *     from the mapping; packed traces, and plain ones in the version 1
+ *     layout, are decoded and then unmapped. A plain version 2 trace has
+ *     the current layout (see trace.h).
+ */
+static void read_binary(trace_t *trace, int fd, char *path)
+{
+    struct stat st;
+    tracehdr_t *hdr;
+    traceop_v1_t *v1;
+    char *map;
+    int i;
+
+    if (fstat(fd, &st) < 0)
+	trace_unix_error("Could not stat", path);
+    if ((size_t)st.st_size < sizeof(tracehdr_t))
+	trace_error("Truncated header in tracefile", path);
+
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED)
+	trace_unix_error("Could not mmap", path);
+
+    hdr = (tracehdr_t *)map;
+    if (hdr->version < 1 || hdr->version > TRACE_VERSION)
+	trace_error("Unsupported binary trace version in", path);
+    if (sizeof(tracehdr_t) + hdr->oplen > (unsigned long long)st.st_size)
+	trace_error("Truncated op data in tracefile", path);
+
+    trace->sugg_heapsize = hdr->sugg_heapsize;
+    trace->num_ids = hdr->num_ids;
+    trace->num_ops = hdr->num_ops;
+    trace->weight = hdr->weight;
+
+    if (hdr->flags & TRACE_VARINT) {
+	trace->format = TRACE_PACKED;
+	if ((trace->ops = (traceop_t *)
+	     malloc(trace->num_ops * sizeof(traceop_t))) == NULL)
+	    trace_unix_error("malloc 2 failed in read_trace", NULL);
+	if (decode_ops(trace, hdr->version, (unsigned char *)(hdr + 1),
+		       (unsigned char *)(hdr + 1) + hdr->oplen) < 0)
+	    trace_error("Corrupt packed op data in tracefile", path);
+	munmap(map, st.st_size);
+    }
+    else if (hdr->version == 1) {
+	if (hdr->oplen != (unsigned long long)trace->num_ops * sizeof(traceop_v1_t))
+	    trace_error("Op count does not match op data in tracefile", path);
+	trace->format = TRACE_BINARY;
+	if ((trace->ops = (traceop_t *)
+	     malloc(trace->num_ops * sizeof(traceop_t))) == NULL)
+	    trace_unix_error("malloc 2 failed in read_trace", NULL);
+	v1 = (traceop_v1_t *)(hdr + 1);
+	for (i = 0; i < trace->num_ops; i++) {
+	    trace->ops[i].type = v1[i].type;
+	    trace->ops[i].lgalign = 0;
+	    trace->ops[i].index = v1[i].index;
+	    trace->ops[i].size = (unsigned)v1[i].size;
+	}
+	munmap(map, st.st_size);
+	check_ops(trace, path);
+    }
+    else {
+	if (hdr->oplen != (unsigned long long)trace->num_ops * sizeof(traceop_t))
+	    trace_error("Op count does not match op data in tracefile", path);
+	trace->format = TRACE_BINARY;
+	madvise(map, st.st_size, MADV_WILLNEED);
+	trace->ops = (traceop_t *)(hdr + 1);
+	trace->map = map;
+	trace->maplen = st.st_size;
+	check_ops(trace, path);
+    }
+}
+
+/*
+ * get_varint - decode one LEB128 varint at *pp, advancing *pp past it.
+ *     Returns -1 if the encoding runs past end.
+ */
+static int get_varint(const unsigned char **pp, const unsigned char *end,
+		      unsigned long long *val)
+{
+    const unsigned char *p = *pp;
+    unsigned long long v = 0;
+    int shift = 0;
+
+    do {
+	if (p == end || shift > 63)
+	    return -1;
+	v |= (unsigned long long)(*p & 0x7f) << shift;
+	shift += 7;
+    } while (*p++ & 0x80);
+
+    *pp = p;
+    *val = v;
+    return 0;
+}
+
+/*
+ * put_varint - encode v as a LEB128 varint into buf, return its length
+ */
+static int put_varint(unsigned char *buf, unsigned long long v)
+{
+    int n = 0;
+
+    while (v >= 0x80) {
+	buf[n++] = (unsigned char)(v | 0x80);
+	v >>= 7;
+    }
+    buf[n++] = (unsigned char)v;
+    return n;
+}
+
+/*
+ * trace_unpack - decode up to max packed ops from [*pp, end) into ops.
+ *     Each op is a varint holding the request type in its low three
+ *     bits (two before version 3) and the zigzag-coded difference from
+ *     the previous index of the same type above them, followed for
+ *     everything but a free by a varint size, and for memalign by a
+ *     varint log2 of the alignment. last[] carries the previous indices
+ *     from call to call. Decoding stops before an op that is cut off
+ *     by end, leaving *pp pointing at it. Returns the number of ops
+ *     decoded, or -1 if the data is corrupt.
+ */
+int trace_unpack(const unsigned char **pp, const unsigned char *end,
+		 int version, int last[NTYPES], int num_ids, traceop_t *ops,
+		 int max)
+{
+    const unsigned char *p;
+    unsigned long long v, z;
+    int tbits = (version < 3) ? 2 : 3;
+    traceop_t *op;
+    int n;
+
+    for (n = 0; n < max; n++) {
+	op = &ops[n];
+	p = *pp;
+	if (get_varint(&p, end, &v) < 0)
+	    break;
+	op->type = v & ((1 << tbits) - 1);
+	if (op->type >= NTYPES)
+	    return -1;
+	z = v >> tbits;
+	op->index = last[op->type] + (int)((z >> 1) ^ -(z & 1));
+	if (op->index < 0 || op->index >= num_ids)
+	    return -1;
+	op->size = 0;
+	op->lgalign = 0;
+	if (!IS_FREE(op->type)) {
+	    if (get_varint(&p, end, &v) < 0)
+		break;
+	    op->size = v;
+	}
+	if (op->type == MEMALIGN) {
+	    if (get_varint(&p, end, &v) < 0)
+		break;
+	    if (v > 63)
+		return -1;
+	    op->lgalign = v;
+	}
+	last[op->type] = op->index;
+	*pp = p;
+    }
+    return n;
+}
+
+/*
+ * decode_ops - expand the packed op data of a whole trace into trace->ops
+ */
+static int decode_ops(trace_t *trace, int version, const unsigned char *p,
+		      const unsigned char *end)
+{
+    int last[NTYPES];
+
+    memset(last, 0xff, sizeof(last));
+    if (trace_unpack(&p, end, version, last, trace->num_ids,
+		     trace->ops, trace->num_ops) != trace->num_ops)
+	return -1;
+    return 0;
+}
+
+/*
+ * check_sizes - make sure every request and alignment fits in a
+ *     size_t, which it may not in the 32-bit build
+ */
+static void check_sizes(trace_t *trace, char *path)
+{
+#if SIZE_MAX < ULLONG_MAX
+    int i;
+
+    for (i = 0; i < trace->num_ops; i++)
+	if (trace->ops[i].size > SIZE_MAX ||
+	    (1ULL << trace->ops[i].lgalign) > SIZE_MAX)
+	    trace_error("Request too big for a 32-bit build in tracefile", path);
+#endif
+}
+
+/*
+ * check_ops - make sure every op of a plain binary trace has a known
+ *     type and alignment and an index below num_ids, as the text and
+ *     packed readers do while parsing
+ */
+static void check_ops(trace_t *trace, char *path)
+{
+    traceop_t *op;
+    int i;
+
+    for (i = 0; i < trace->num_ops; i++) {
+	op = &trace->ops[i];
+	if (op->type >= NTYPES || op->lgalign > 63)
+	    trace_error("Bad op type in tracefile", path);
+	if (op->index < 0 || op->index >= trace->num_ids)
+	    trace_error("Op index out of range in tracefile", path);
+    }
+}
+
+/*
+ * alloc_blocks - allocate the per-id arrays the driver fills in
+ */
+static void alloc_blocks(trace_t *trace)
+{
+    /* We'll keep an array of pointers to the allocated blocks here... */
+    if ((trace->blocks =
+	 (char **)malloc(trace->num_ids * sizeof(char *))) == NULL)
+	trace_unix_error("malloc 3 failed in read_trace", NULL);
+
+    /* ... along with the corresponding byte sizes of each block */
+    if ((trace->block_sizes =
+	 (size_t *)malloc(trace->num_ids * sizeof(size_t))) == NULL)
+	trace_unix_error("malloc 4 failed in read_trace", NULL);
+
+    /* ... and whether they came from an op mm_free_sized takes (IS_SIZED) */
+    if ((trace->block_sized = (char *)malloc(trace->num_ids)) == NULL)
+	trace_unix_error("malloc 5 failed in read_trace", NULL);
+}
+
+/***************************************************
+ * The following routines write traces one op at a time
+ ***************************************************/
+
+/*
+ * write_header - write (or rewrite) the header at the current position
+ */
+static void write_header(tracewriter_t *w)
+{
+    /* A text header that will be patched later is padded to fixed width */
+    char *fmt = w->patch ? "%-11d\n" : "%d\n";
+
+    if (w->format == TRACE_TEXT) {
+	fprintf(w->fp, fmt, w->hdr.sugg_heapsize);
+	fprintf(w->fp, fmt, w->hdr.num_ids);
+	fprintf(w->fp, fmt, w->hdr.num_ops);
+	fprintf(w->fp, fmt, w->hdr.weight);
+    }
+    else
+	fwrite(&w->hdr, sizeof(tracehdr_t), 1, w->fp);
+}
+
+/*
+ * trace_wopen - create a trace file at path in the given format. Pass
+ *     num_ids or num_ops as -1 if they aren't known yet.
+ */
+int trace_wopen(tracewriter_t *w, char *path, int format,
+		int sugg_heapsize, int num_ids, int num_ops, int weight)
+{
+    memset(w, 0, sizeof(tracewriter_t));
+    if ((w->fp = fopen(path, "w")) == NULL)
+	return -1;
+
+    w->format = format;
+    w->max_index = -1;
+    memset(w->last, 0xff, sizeof(w->last));
+    memcpy(w->hdr.magic, TRACE_MAGIC, sizeof(w->hdr.magic));
+    w->hdr.version = TRACE_VERSION;
+    w->hdr.flags = (format == TRACE_PACKED) ? TRACE_VARINT : 0;
+    w->hdr.sugg_heapsize = sugg_heapsize;
+    w->hdr.num_ids = (num_ids < 0) ? 0 : num_ids;
+    w->hdr.num_ops = (num_ops < 0) ? 0 : num_ops;
+    w->hdr.weight = weight;
+
+    /* Binary headers always carry the op data length, known only at close */
+    w->patch = (format != TRACE_TEXT || num_ids < 0 || num_ops < 0);
+    write_header(w);
+    return ferror(w->fp) ? -1 : 0;
+}
+
+/*
+ * trace_wop - append one op to the trace
+ */
+void trace_wop(tracewriter_t *w, traceop_t *op)
+{
+    unsigned char buf[32];
+    long long delta;
+    int n;
+
+    if (!IS_FREE(op->type) && op->index > w->max_index)
+	w->max_index = op->index;
+    w->num_ops++;
+
+    switch (w->format) {
+    case TRACE_TEXT:
+	if (op->type == ALLOC)
+	    fprintf(w->fp, "a %d %llu\n", op->index, op->size);
+	else if (op->type == REALLOC)
+	    fprintf(w->fp, "r %d %llu\n", op->index, op->size);
+	else if (op->type == CALLOC)
+	    fprintf(w->fp, "c %d %llu\n", op->index, op->size);
+	else if (op->type == MEMALIGN)
+	    fprintf(w->fp, "m %d %llu %llu\n", op->index,
+		    1ULL << op->lgalign, op->size);
+	else if (op->type == BALLOC)
+	    fprintf(w->fp, "ba %d %llu\n", op->index, op->size);
+	else if (op->type == BFREE)
+	    fprintf(w->fp, "bf %d\n", op->index);
+	else
+	    fprintf(w->fp, "f %d\n", op->index);
+	break;
+
+    case TRACE_BINARY:
+	fwrite(op, sizeof(traceop_t), 1, w->fp);
+	w->oplen += sizeof(traceop_t);
+	break;
+
+    case TRACE_PACKED:
+	delta = (long long)op->index - w->last[op->type];
+	w->last[op->type] = op->index;
+	n = put_varint(buf, ((unsigned long long)((delta << 1) ^ (delta >> 63))
+			     << 3) | op->type);
+	if (!IS_FREE(op->type))
+	    n += put_varint(buf + n, op->size);
+	if (op->type == MEMALIGN)
+	    n += put_varint(buf + n, op->lgalign);
+	fwrite(buf, 1, n, w->fp);
+	w->oplen += n;
+	break;
+    }
+}
+
+/*
+ * trace_wclose - fill in whatever the header still lacks and close the
+ *     file. Returns -1 if any write failed.
+ */
+int trace_wclose(tracewriter_t *w)
+{
+    int err;
+
+    if (w->patch) {
+	w->hdr.num_ids = w->max_index + 1;
+	w->hdr.num_ops = w->num_ops;
+	w->hdr.oplen = w->oplen;
+	fflush(w->fp);
+	rewind(w->fp);
+	write_header(w);
+    }
+    err = ferror(w->fp);
+    if (fclose(w->fp) != 0 || err)
+	return -1;
+    return 0;
+}
+
+/*
+ * trace_error - Report a malformed trace file and exit
+ */
+static void trace_error(char *msg, char *path)
+{
+    printf("%s %s\n", msg, path);
+    exit(1);
+}
+
+/*
+ * trace_unix_error - Report a Unix-style error while reading a trace
+ *     (path may be NULL) and exit
+ */
+static void trace_unix_error(char *msg, char *path)
+{
+    if (path != NULL)
+	printf("%s %s: %s\n", msg, path, strerror(errno));
+    else
+	printf("%s: %s\n", msg, strerror(errno));
+    exit(1);
+}
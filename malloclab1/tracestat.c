@@ -0,0 +1,363 @@
+/*
+ * tracestat.c - describe the workload in a malloc lab trace
+ *
+ *     unix> tracestat [-c points] [-a engine] big.pk
+ *
+ * Reports, from one streaming pass over a trace in any format:
+ *   - request size histograms for allocs, callocs, memaligns, reallocs
+ *     and frees, and the alignments memalign asked for
+ *   - the number of blocks in each batch, for traces with batch ops
+ *   - block lifetimes in ops, from alloc to free
+ *   - the live block and live byte curve over the trace
+ *   - realloc growth ratios and the number of reallocs per block
+ *   - how the requests spread over the size classes of the allocators
+ *
+ * Memory use is 16 bytes per trace id; the ops themselves are streamed
+ * (see stream.c), so very large traces can be analyzed.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+
+#include "trace.h"
+#include "stream.h"
+
+int verbose = 0;  /* read by the trace module */
+
+#define NBUCKETS   64   /* log2 buckets: bucket k holds [2^k, 2^(k+1)) */
+#define NRATIOS    9
+#define LAB1_CLASSES    51  /* malloclab1: MAX_POWER + 1 */
+#define HANDOUT_CLASSES 16  /* handout: MAXNUMBER */
+
+typedef unsigned long long hist_t[NBUCKETS];
+
+/* Upper edges of the realloc growth ratio buckets */
+static double ratio_edges[NRATIOS - 1] = {0.5, 1, 1.0001, 1.25, 1.5, 2, 4, 16};
+static char *ratio_names[NRATIOS] = {
+    "< 0.5", "0.5 - 1", "= 1", "1 - 1.25", "1.25 - 1.5", "1.5 - 2",
+    "2 - 4", "4 - 16", ">= 16"};
+
+/* Per-id state, indexed by trace id */
+static int *birth;         /* op at which the id was allocated, -1 if dead */
+static unsigned long long *cursize; /* its current size */
+static int *nreallocs;     /* reallocs since it was allocated */
+
+/* The run of batch ops being read (see batch_run) */
+static int run_type = -1;  /* BALLOC or BFREE, -1 outside a run */
+static int run_len;        /* ops in it so far */
+static unsigned long long run_size; /* BALLOC: the size of its blocks */
+
+/* function prototypes */
+static void usage(void);
+
+/* log2_bucket - index of the highest set bit of x, 0 for x <= 1 */
+static int log2_bucket(unsigned long long x)
+{
+    return (x <= 1) ? 0 : 63 - __builtin_clzll(x);
+}
+
+/*
+ * lab1_class - free list searched first by malloclab1/mm.c for a
+ *     request of size bytes (see find_free_list_index)
+ */
+static int lab1_class(unsigned long long size)
+{
+    unsigned long long k;
+
+    if (size <= 1<<12) {
+	/* round up to a power of 2, as mm_malloc does */
+	for (k = 1; k < size; k <<= 1)
+	    ;
+	size = k;
+    }
+    k = log2_bucket(((size + 7) & ~7ULL) / 4);
+    return (k >= LAB1_CLASSES) ? LAB1_CLASSES - 1 : k;
+}
+
+/*
+ * handout_class - free list searched first by the handout mm.c for a
+ *     request of size bytes (see mm_malloc and add)
+ */
+static int handout_class(unsigned long long size)
+{
+    unsigned long long asize = (size <= 8) ? 16 : ((size + 8 + 7) & ~7ULL);
+    int k = log2_bucket(asize);
+
+    return (k >= HANDOUT_CLASSES) ? HANDOUT_CLASSES - 1 : k;
+}
+
+/*
+ * batch_run - follow the runs of batch ops, which mdriver replays as
+ *     one call each: consecutive BALLOC ops of one size, or consecutive
+ *     BFREE ops. When op type (with size) ends a run, the run's length
+ *     goes into hist[0] for allocs or hist[1] for frees.
+ */
+static void batch_run(int type, unsigned long long size, hist_t *hist)
+{
+    if (type == run_type && (type == BFREE || size == run_size)) {
+	run_len++;
+	return;
+    }
+    if (run_type >= 0)
+	hist[run_type == BFREE][log2_bucket(run_len)]++;
+    run_type = (type == BALLOC || type == BFREE) ? type : -1;
+    run_len = 1;
+    run_size = size;
+}
+
+/*
+ * print_hist - print the non-empty buckets of a log2 histogram
+ */
+static void print_hist(char *title, char *unit, hist_t h)
+{
+    unsigned long long total = 0, cum = 0;
+    int k;
+
+    for (k = 0; k < NBUCKETS; k++)
+	total += h[k];
+    printf("\n%s (%llu)\n", title, total);
+    if (total == 0)
+	return;
+    printf("%24s %14s %7s %7s\n", unit, "count", "%", "cum%");
+    for (k = 0; k < NBUCKETS; k++) {
+	if (h[k] == 0)
+	    continue;
+	cum += h[k];
+	printf("  [%9llu, %9llu) %14llu %6.2f%% %6.2f%%\n",
+	       k ? 1ull << k : 0ull, 1ull << (k + 1), h[k],
+	       100.0 * h[k] / total, 100.0 * cum / total);
+    }
+}
+
+/*
+ * print_classes - print how many requests would start their search in
+ *     each size class of an allocator
+ */
+static void print_classes(char *title, unsigned long long *c, int n)
+{
+    unsigned long long total = 0;
+    int k;
+
+    for (k = 0; k < n; k++)
+	total += c[k];
+    printf("\n%s (%llu requests)\n", title, total);
+    if (total == 0)
+	return;
+    printf("  %5s %14s %7s\n", "class", "requests", "%");
+    for (k = 0; k < n; k++)
+	if (c[k] != 0)
+	    printf("  %5d %14llu %6.2f%%\n", k, c[k], 100.0 * c[k] / total);
+}
+
+int main(int argc, char **argv)
+{
+    stream_t s;
+    traceop_t *ops;
+    int c, i, k, n, index, t = 0;
+    unsigned long long size;
+    int points = 20, every, engines = 3;
+    long long live = 0, live_bytes = 0, peak = 0, peak_bytes = 0;
+    unsigned long long count[NTYPES] = {0};
+    hist_t size_hist[NTYPES], life_hist, chain_hist, align_hist;
+    hist_t batch_hist[2];
+    unsigned long long ratios[NRATIOS];
+    unsigned long long lab1[LAB1_CLASSES], handout[HANDOUT_CLASSES];
+    unsigned long long never_freed = 0;
+    double r;
+
+    while ((c = getopt(argc, argv, "c:a:h")) != EOF) {
+	switch (c) {
+	case 'c': /* Points on the live set curve */
+	    points = atoi(optarg);
+	    break;
+	case 'a': /* Size classes of which allocator */
+	    if (strcmp(optarg, "lab1") == 0)
+		engines = 1;
+	    else if (strcmp(optarg, "handout") == 0)
+		engines = 2;
+	    else if (strcmp(optarg, "all") == 0)
+		engines = 3;
+	    else {
+		usage();
+		exit(1);
+	    }
+	    break;
+	case 'h':
+	    usage();
+	    exit(0);
+	default:
+	    usage();
+	    exit(1);
+	}
+    }
+    if (argc - optind != 1) {
+	usage();
+	exit(1);
+    }
+
+    if (stream_open(&s, argv[optind]) < 0) {
+	printf("Could not open %s: %s\n", argv[optind], strerror(errno));
+	exit(1);
+    }
+    birth = malloc(s.num_ids * sizeof(int));
+    cursize = malloc(s.num_ids * sizeof(unsigned long long));
+    nreallocs = malloc(s.num_ids * sizeof(int));
+    if (birth == NULL || cursize == NULL || nreallocs == NULL) {
+	printf("Out of memory for %d ids\n", s.num_ids);
+	exit(1);
+    }
+    memset(birth, 0xff, s.num_ids * sizeof(int));
+    memset(size_hist, 0, sizeof(size_hist));
+    memset(life_hist, 0, sizeof(life_hist));
+    memset(chain_hist, 0, sizeof(chain_hist));
+    memset(align_hist, 0, sizeof(align_hist));
+    memset(batch_hist, 0, sizeof(batch_hist));
+    memset(ratios, 0, sizeof(ratios));
+    memset(lab1, 0, sizeof(lab1));
+    memset(handout, 0, sizeof(handout));
+
+    if (points < 1)
+	points = 1;
+    every = s.num_ops / points;
+    if (every < 1)
+	every = 1;
+
+    printf("%s: %d ops, %d ids, suggested heap %d bytes\n",
+	   argv[optind], s.num_ops, s.num_ids, s.sugg_heapsize);
+    printf("\nLive set\n");
+    printf("  %12s %12s %14s\n", "op", "blocks", "bytes");
+
+    while ((ops = stream_next(&s, &n)) != NULL) {
+	for (i = 0; i < n; i++, t++) {
+	    index = ops[i].index;
+	    size = ops[i].size;
+	    count[ops[i].type]++;
+	    batch_run(ops[i].type, size, batch_hist);
+
+	    switch (ops[i].type) {
+	    case MEMALIGN:
+		align_hist[ops[i].lgalign]++;
+		/* fall through */
+	    case ALLOC:
+	    case CALLOC:
+	    case BALLOC:
+		birth[index] = t;
+		cursize[index] = size;
+		nreallocs[index] = 0;
+		live++;
+		live_bytes += size;
+		break;
+
+	    case REALLOC:
+		if (birth[index] < 0) {
+		    /* realloc of a dead id acts as a fresh alloc */
+		    birth[index] = t;
+		    cursize[index] = 0;
+		    nreallocs[index] = 0;
+		    live++;
+		}
+		if (cursize[index] > 0) {
+		    r = (double)size / cursize[index];
+		    for (k = 0; k < NRATIOS - 1 && r >= ratio_edges[k]; k++)
+			;
+		    ratios[k]++;
+		}
+		nreallocs[index]++;
+		live_bytes += (long long)(size - cursize[index]);
+		cursize[index] = size;
+		break;
+
+	    default: /* FREE, BFREE */
+		if (birth[index] < 0)
+		    break;
+		size = cursize[index];
+		life_hist[log2_bucket(t - birth[index])]++;
+		if (nreallocs[index] > 0)
+		    chain_hist[log2_bucket(nreallocs[index])]++;
+		birth[index] = -1;
+		live--;
+		live_bytes -= size;
+		break;
+	    }
+
+	    size_hist[ops[i].type][log2_bucket(size)]++;
+	    if (!IS_FREE(ops[i].type)) {
+		lab1[lab1_class(size)]++;
+		handout[handout_class(size)]++;
+	    }
+	    if (live > peak)
+		peak = live;
+	    if (live_bytes > peak_bytes)
+		peak_bytes = live_bytes;
+	    if (t % every == 0)
+		printf("  %12d %12lld %14lld\n", t, live, live_bytes);
+	}
+    }
+    batch_run(-1, 0, batch_hist);
+    printf("  %12d %12lld %14lld\n", t, live, live_bytes);
+    printf("  peak %19lld %14lld\n", peak, peak_bytes);
+
+    if (stream_close(&s) < 0) {
+	printf("%s is malformed after op %d\n", argv[optind], t);
+	exit(1);
+    }
+    for (i = 0; i < s.num_ids; i++)
+	if (birth[i] >= 0)
+	    never_freed++;
+
+    printf("\nOps: %llu allocs, %llu callocs, %llu memaligns, %llu reallocs, "
+	   "%llu frees, %llu batch allocs, %llu batch frees\n",
+	   count[ALLOC], count[CALLOC], count[MEMALIGN], count[REALLOC],
+	   count[FREE], count[BALLOC], count[BFREE]);
+    print_hist("Alloc sizes", "bytes", size_hist[ALLOC]);
+    if (count[CALLOC] > 0)
+	print_hist("Calloc sizes", "bytes", size_hist[CALLOC]);
+    if (count[MEMALIGN] > 0) {
+	print_hist("Memalign sizes", "bytes", size_hist[MEMALIGN]);
+	print_hist("Memalign alignments", "bytes", align_hist);
+    }
+    print_hist("Realloc sizes", "bytes", size_hist[REALLOC]);
+    print_hist("Sizes of freed blocks", "bytes", size_hist[FREE]);
+    if (count[BALLOC] + count[BFREE] > 0) {
+	print_hist("Batch alloc sizes", "bytes", size_hist[BALLOC]);
+	print_hist("Sizes of batch freed blocks", "bytes", size_hist[BFREE]);
+	print_hist("Blocks per alloc batch", "blocks", batch_hist[0]);
+	print_hist("Blocks per free batch", "blocks", batch_hist[1]);
+    }
+    print_hist("Lifetimes of freed blocks", "ops", life_hist);
+    printf("  %llu blocks never freed\n", never_freed);
+
+    printf("\nRealloc growth ratio, new size / old size (%llu)\n",
+	   count[REALLOC]);
+    for (k = 0; k < NRATIOS; k++)
+	if (ratios[k] != 0)
+	    printf("  %-24s %14llu %6.2f%%\n", ratio_names[k], ratios[k],
+		   100.0 * ratios[k] / count[REALLOC]);
+    print_hist("Reallocs per block (blocks that were reallocated)",
+	       "reallocs", chain_hist);
+
+    if (engines & 1)
+	print_classes("Size classes, malloclab1 seglist", lab1, LAB1_CLASSES);
+    if (engines & 2)
+	print_classes("Size classes, handout seglist", handout,
+		      HANDOUT_CLASSES);
+
+    free(birth);
+    free(cursize);
+    free(nreallocs);
+    exit(0);
+}
+
+/*
+ * usage - Explain the command line arguments
+ */
+static void usage(void)
+{
+    fprintf(stderr, "Usage: tracestat [-h] [-c <points>] [-a <engine>] <tracefile>\n");
+    fprintf(stderr, "Options\n");
+    fprintf(stderr, "\t-c <points> Print the live set at this many points (20).\n");
+    fprintf(stderr, "\t-a <engine> Size classes to report: lab1, handout or all.\n");
+    fprintf(stderr, "\t-h          Print this message.\n");
+}